@@ -2,24 +2,107 @@
 #include "motors_sensors.h"
 #include "filesystem.h"
 #include "bluetooth.h"
+#include "auto_zero.h"
+#include "calibration.h"
+#include "cup_presence.h"
+#include "trace_recorder.h"
+#include "health.h"
+#include "popularity.h"
+#include "alloc_track.h"
+#include "order_journal.h"
+
+// Line commands typed on the serial monitor.
+void poll_serial_commands() {
+    if (!Serial.available()) return;
+    String command = Serial.readStringUntil('\n');
+    command.trim();
+    if (command == "trace") {
+        trace_export_serial();
+    } else if (command == "journal") {
+        journal_export_serial();
+    } else if (command == "health") {
+        health_print_report();
+    } else if (command == "alloc") {
+        alloc_print_report();
+    } else if (command == "flash") {
+        print_flash_write_stats();
+    } else {
+        Serial.println("Unknown serial command: " + command);
+    }
+}
 
 void setup() {
     Serial.begin(115200);
-    while (!Serial)
+    while (!Serial && millis() < SERIAL_WAIT_TIMEOUT_MS)
         delay(10);
 
+    health_step_begin(Subsystem_Motors);
     setup_motors();
-    setup_weight_sensor();
+    health_step_end(Subsystem_Motors, Health_Ok);
+
     setup_data();
+
+    health_step_begin(Subsystem_Trace);
+    if (health_ok(Subsystem_Storage) && trace_begin()) {
+        health_step_end(Subsystem_Trace, Health_Ok);
+    } else {
+        health_step_end(Subsystem_Trace, Health_Degraded, "tracing disabled");
+    }
+    if (health_ok(Subsystem_Storage)) {
+        journal_begin();
+    }
+
+    setup_weight_sensor();
+#ifdef WEIGHT_SELF_CHECK
+    if (health_ok(Subsystem_Load_Cell) || subsystem_health[Subsystem_Load_Cell].state == Health_Pending) {
+        weight_self_check();
+    }
+#endif
+
+    health_step_begin(Subsystem_Display);
     setup_screen();
+    health_step_end(Subsystem_Display, Health_Ok);
+
+    health_step_begin(Subsystem_Bluetooth);
     ble_setup();
-    update_top_ordered_cocktails();
+    health_step_end(Subsystem_Bluetooth, Health_Ok);
+
+    popularity_rebuild();
+    health_mark_boot_done();
+    health_print_report();
+
+    // Boot into the health screen when something is down, so the failure
+    // is visible without a serial monitor. The machine stays usable.
+    for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+        if (subsystem_health[i].state == Health_Failed) {
+            open_health_screen();
+            break;
+        }
+    }
 }
 
 void loop() {
     ble_loop();
+    poll_serial_commands();
     check_and_handle_touch();
+    poll_weight_sensor();
+    redraw_availability_changes();
+    bool platform_in_use = order_pending || calibration_session.active
+                           || current_menu == Cancellable_Op || current_menu == Service;
+    persist_poll(!platform_in_use);
+    if (!platform_in_use && health_ok(Subsystem_Load_Cell)) {
+        auto_zero_update();
+        cup_presence_update(millis());
+    }
     if (order_pending) {
+        auto_zero_reset_window();
+        if (!health_ok(Subsystem_Load_Cell)) {
+            alert_error(subsystem_health[Subsystem_Load_Cell].state == Health_Pending
+                            ? "Scale is still taring, try again."
+                            : "Scale not responding, see service screen.");
+            order_pending = false;
+            return;
+        }
         if (isCocktailEmpty(ordered_cocktail)) {
             alert_error("Selected cocktail is empty.");
             order_pending = false;
@@ -27,12 +110,8 @@ void loop() {
         }
         Serial.print("Got valid order:");
         log_cocktail(ordered_cocktail);
-        bool cup_placed = wait_for_cup();
-        if (cup_placed) {
-            pour_drink(ordered_cocktail, chosen_cocktail_size);
-        }
+        serve_order(ordered_cocktail, chosen_cocktail_size);
         order_pending = false;
-        update_top_ordered_cocktails();
     }
     delay(100);
 }
@@ -0,0 +1,121 @@
+#include "alloc_track.h"
+#include <new>
+#include <esp_heap_caps.h>
+
+AllocCounters alloc_counters[ALLOC_SCOPE_COUNT];
+OrderAllocReport last_order_alloc;
+uint32_t alloc_orders = 0;
+uint32_t alloc_orders_allocating = 0;
+
+// Per task: BLE callbacks run on their own task while loop() pours.
+static __thread uint8_t current_scope = Alloc_Other;
+
+static multi_heap_info_t order_start_heap;
+static AllocCounters order_start_counters[ALLOC_SCOPE_COUNT];
+
+static void count_allocation(size_t size) {
+  AllocCounters& counters = alloc_counters[current_scope];
+  __atomic_fetch_add(&counters.allocations, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&counters.bytes, (uint32_t)size, __ATOMIC_RELAXED);
+}
+
+static void count_free(void* pointer) {
+  if (pointer) {
+    __atomic_fetch_add(&alloc_counters[current_scope].frees, 1, __ATOMIC_RELAXED);
+  }
+}
+
+static void* tracked_alloc(size_t size) {
+  count_allocation(size);
+  return malloc(size ? size : 1);
+}
+
+static void* tracked_alloc_or_fail(size_t size) {
+  void* pointer = tracked_alloc(size);
+  if (!pointer) {
+#if __cpp_exceptions
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
+  }
+  return pointer;
+}
+
+void* operator new(size_t size) { return tracked_alloc_or_fail(size); }
+void* operator new[](size_t size) { return tracked_alloc_or_fail(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return tracked_alloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return tracked_alloc(size); }
+void operator delete(void* pointer) noexcept { count_free(pointer); free(pointer); }
+void operator delete[](void* pointer) noexcept { count_free(pointer); free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { count_free(pointer); free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { count_free(pointer); free(pointer); }
+
+AllocScopeGuard::AllocScopeGuard(AllocScope scope) : previous((AllocScope)current_scope) {
+  if (current_scope != Alloc_Order) current_scope = scope;
+}
+
+AllocScopeGuard::~AllocScopeGuard() {
+  AllocCounters& counters = alloc_counters[current_scope];
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  if (counters.min_largest_free == 0 || largest < counters.min_largest_free) {
+    counters.min_largest_free = largest;
+  }
+  current_scope = previous;
+}
+
+void alloc_order_begin() {
+  heap_caps_get_info(&order_start_heap, MALLOC_CAP_8BIT);
+  memcpy(order_start_counters, alloc_counters, sizeof(order_start_counters));
+}
+
+void alloc_order_end() {
+  multi_heap_info_t heap;
+  heap_caps_get_info(&heap, MALLOC_CAP_8BIT);
+  OrderAllocReport& report = last_order_alloc;
+  for (int i = 0; i < ALLOC_SCOPE_COUNT; i++) {
+    report.allocations[i] = alloc_counters[i].allocations - order_start_counters[i].allocations;
+    report.bytes[i] = alloc_counters[i].bytes - order_start_counters[i].bytes;
+  }
+  report.heap_blocks_delta = (int32_t)heap.allocated_blocks - (int32_t)order_start_heap.allocated_blocks;
+  report.free_bytes_delta = (int32_t)heap.total_free_bytes - (int32_t)order_start_heap.total_free_bytes;
+  report.largest_free_block = heap.largest_free_block;
+
+  alloc_orders++;
+  Serial.printf("Order heap: %+ld blocks, %+ld bytes free, largest free block %lu\n",
+                (long)report.heap_blocks_delta, (long)report.free_bytes_delta, (unsigned long)report.largest_free_block);
+  if (report.allocations[Alloc_Order] > 0 || report.heap_blocks_delta != 0) {
+    alloc_orders_allocating++;
+  }
+  if (report.allocations[Alloc_Order] > 0) {
+    Serial.printf("WARNING: order path allocated %lu times (%lu bytes)\n",
+                  (unsigned long)report.allocations[Alloc_Order], (unsigned long)report.bytes[Alloc_Order]);
+  }
+  if (report.heap_blocks_delta != 0) {
+    Serial.printf("WARNING: order left the heap %+ld blocks different\n", (long)report.heap_blocks_delta);
+  }
+}
+
+const char* alloc_scope_name(AllocScope scope) {
+  switch (scope) {
+    case Alloc_Other: return "Other";
+    case Alloc_Order: return "Order";
+    case Alloc_Bluetooth: return "Bluetooth";
+    case Alloc_Storage: return "Storage";
+    default: return "?";
+  }
+}
+
+void alloc_print_report() {
+  Serial.printf("Heap: %lu free, largest block %lu, %lu of %lu orders allocated on the order path\n",
+                (unsigned long)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+                (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+                (unsigned long)alloc_orders_allocating, (unsigned long)alloc_orders);
+  for (int i = 0; i < ALLOC_SCOPE_COUNT; i++) {
+    const AllocCounters& counters = alloc_counters[i];
+    Serial.printf("  %-10s %7lu allocs %7lu frees %9lu bytes  min largest free %lu  last order %lu allocs\n",
+                  alloc_scope_name((AllocScope)i), (unsigned long)counters.allocations, (unsigned long)counters.frees,
+                  (unsigned long)counters.bytes, (unsigned long)counters.min_largest_free,
+                  (unsigned long)last_order_alloc.allocations[i]);
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef ALLOC_TRACK_H
+#define ALLOC_TRACK_H
+
+#include <Arduino.h>
+
+// Heap use per subsystem. Every operator new (std::string, BLE objects, file
+// handles) is counted against the scope its task is in; code outside any
+// scope counts as Other. Arduino String and printf buffers go through malloc
+// and are only visible in the heap snapshots taken around each order.
+//
+// Placing and pouring an order must not allocate: anything counted against
+// Alloc_Order, and any block still allocated that was not before, is reported
+// on serial when the order ends.
+
+enum AllocScope {
+  Alloc_Other,
+  Alloc_Order,      // order path in loop(): cup detection and pouring
+  Alloc_Bluetooth,  // BLE callbacks and notifications
+  Alloc_Storage,    // flash writes (ingredients, stats, recipes, trace)
+  ALLOC_SCOPE_COUNT
+};
+
+struct AllocCounters {
+  uint32_t allocations = 0;
+  uint32_t frees = 0;
+  uint32_t bytes = 0;               // requested, in total
+  uint32_t min_largest_free = 0;    // smallest largest-free-block seen leaving the scope, 0 if never left
+};
+
+// What happened to the heap while the last order ran.
+struct OrderAllocReport {
+  uint32_t allocations[ALLOC_SCOPE_COUNT] = {};
+  uint32_t bytes[ALLOC_SCOPE_COUNT] = {};
+  int32_t heap_blocks_delta = 0;    // allocated blocks after minus before
+  int32_t free_bytes_delta = 0;
+  uint32_t largest_free_block = 0;  // at the end of the order
+};
+
+extern AllocCounters alloc_counters[ALLOC_SCOPE_COUNT];
+extern OrderAllocReport last_order_alloc;
+// Orders so far, and how many of them allocated on the order path.
+extern uint32_t alloc_orders;
+extern uint32_t alloc_orders_allocating;
+
+/*
+Counts allocations of the calling task against `scope` while it lives.
+Scopes nest and the innermost one wins, except inside Alloc_Order: a flash
+write or notification under an order still counts against the order.
+*/
+class AllocScopeGuard {
+public:
+  explicit AllocScopeGuard(AllocScope scope);
+  ~AllocScopeGuard();
+private:
+  AllocScope previous;
+};
+
+/*
+Snapshot the heap and counters before an order and compare after it. The
+end prints a line and a warning if the order path allocated.
+*/
+void alloc_order_begin();
+void alloc_order_end();
+
+const char* alloc_scope_name(AllocScope scope);
+
+/*
+Prints the counters of every scope and the last order to serial.
+*/
+void alloc_print_report();
+
+#endif
@@ -0,0 +1,64 @@
+#include "auto_zero.h"
+
+DriftStats drift_stats;
+
+static int64_t window_sum = 0;
+static weight_mg_t window_min = 0;
+static weight_mg_t window_max = 0;
+static int window_count = 0;
+
+void auto_zero_reset_window() {
+  window_count = 0;
+  window_sum = 0;
+}
+
+void auto_zero_update() {
+  int32_t raw;
+  if (!weight_try_read_raw(raw)) {
+    return;
+  }
+  weight_mg_t sample = weight_raw_to_mg(raw);
+  if (window_count == 0) {
+    window_min = sample;
+    window_max = sample;
+  }
+  window_sum += sample;
+  window_min = min(window_min, sample);
+  window_max = max(window_max, sample);
+  if (++window_count < AUTO_ZERO_WINDOW_SAMPLES) {
+    return;
+  }
+
+  weight_mg_t mean = (weight_mg_t)(window_sum / window_count);
+  weight_mg_t spread = window_max - window_min;
+  auto_zero_reset_window();
+
+  if (spread > AUTO_ZERO_STABLE_SPREAD_MG) {
+    drift_stats.windows_unstable++;
+    return;
+  }
+  if (abs(mean) > AUTO_ZERO_CAPTURE_MG) {
+    drift_stats.windows_loaded++;
+    return;
+  }
+
+  // Booked as applied: the zero only moves in whole raw counts, often less
+  // than a mg per correction.
+  int32_t counts = weight_adjust_zero(constrain(mean / 4, -AUTO_ZERO_MAX_STEP_MG, AUTO_ZERO_MAX_STEP_MG));
+  if (counts == 0) {
+    return;
+  }
+  drift_stats.corrections++;
+  drift_stats.total_drift_counts += counts;
+  drift_stats.total_drift_mg = (weight_mg_t)((int64_t)drift_stats.total_drift_counts * 1000000 / scale_calibration.counts_per_kg);
+  drift_stats.max_abs_drift_mg = max(drift_stats.max_abs_drift_mg, (weight_mg_t)abs(drift_stats.total_drift_mg));
+  drift_stats.last_correction_ms = millis();
+}
+
+int32_t auto_zero_drift_rate_mg_per_hour() {
+  unsigned long uptime_ms = millis();
+  if (uptime_ms < 60000) {
+    return 0;
+  }
+  return (int32_t)((int64_t)drift_stats.total_drift_mg * 3600000 / uptime_ms);
+}
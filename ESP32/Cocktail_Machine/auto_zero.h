@@ -0,0 +1,46 @@
+#ifndef AUTO_ZERO_H
+#define AUTO_ZERO_H
+
+#include <Arduino.h>
+#include "weight.h"
+
+// Idle samples per decision window, taken at the idle 10 SPS rate.
+const int AUTO_ZERO_WINDOW_SAMPLES = 20;
+// The platform only counts as empty if the window mean is within this of
+// zero. It is below the cup step so a light cup is never zeroed away.
+const weight_mg_t AUTO_ZERO_CAPTURE_MG = 1000;
+// Max - min of the window; anything noisier is being touched or vibrating.
+const weight_mg_t AUTO_ZERO_STABLE_SPREAD_MG = 300;
+// Each correction removes a quarter of the error, at most this much.
+const weight_mg_t AUTO_ZERO_MAX_STEP_MG = 200;
+
+struct DriftStats {
+  int corrections = 0;
+  int windows_loaded = 0;              // skipped: something on the platform
+  int windows_unstable = 0;            // skipped: platform moving
+  int32_t total_drift_counts = 0;      // sum of all corrections since boot, as applied
+  weight_mg_t total_drift_mg = 0;      // the same in mg
+  weight_mg_t max_abs_drift_mg = 0;
+  unsigned long last_correction_ms = 0;
+};
+
+extern DriftStats drift_stats;
+
+/*
+Feeds the tracker from the idle loop. Never blocks: it only takes a sample
+when the HX711 has one ready. Only call it while nothing may be on the
+platform on purpose (no order, pour or calibration running).
+*/
+void auto_zero_update();
+
+/*
+Drops the partially collected window, e.g. when an order starts.
+*/
+void auto_zero_reset_window();
+
+/*
+Estimated drift rate since boot, in mg per hour.
+*/
+int32_t auto_zero_drift_rate_mg_per_hour();
+
+#endif
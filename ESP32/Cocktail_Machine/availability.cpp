@@ -0,0 +1,114 @@
+#include "availability.h"
+#include "makeable.h"
+
+static preset_mask_t available_mask = 0;
+static preset_mask_t changed_mask = 0;
+// Presets that need each ingredient at all.
+static preset_mask_t ingredient_users[INGREDIENT_COUNT];
+static int headroom_ml[INGREDIENT_COUNT];
+// Required millilitres per preset, size and ingredient.
+static int required_ml[PRESET_COCKTAIL_COUNT][PORTION_SIZE_COUNT][INGREDIENT_COUNT];
+static uint16_t servings[PRESET_COCKTAIL_COUNT][PORTION_SIZE_COUNT];
+
+static void update_headroom(int ingredient) {
+  // Same rule as isIngredientAvailable(): whole millilitres above the minimum.
+  headroom_ml[ingredient] = stock_ml(ingredients[ingredient]) - MINIMUM_INGREDIENT_AMOUNT_THRESHOLD;
+}
+
+// O(INGREDIENT_COUNT) per size.
+static void update_servings(int slot) {
+  uint16_t before = servings[slot][chosen_cocktail_size];
+  for (int size = 0; size < PORTION_SIZE_COUNT; size++) {
+    int fewest = -1;
+    for (int ingredient = 0; ingredient < INGREDIENT_COUNT; ingredient++) {
+      int required = required_ml[slot][size][ingredient];
+      if (required == 0) continue;
+      int possible = max(0, headroom_ml[ingredient]) / required;
+      fewest = fewest < 0 ? possible : min(fewest, possible);
+    }
+    // Nothing limits a preset without ingredients (it is rejected as empty
+    // when ordered), matching isCocktailAvailable().
+    servings[slot][size] = fewest < 0 ? SERVINGS_MAX : (uint16_t)min(fewest, (int)SERVINGS_MAX);
+  }
+  if (servings[slot][chosen_cocktail_size] != before) {
+    changed_mask |= (preset_mask_t)1 << slot;
+  }
+}
+
+static void update_mask() {
+  preset_mask_t mask = 0;
+  for (int slot = 0; slot < PRESET_COCKTAIL_COUNT; slot++) {
+    if (servings[slot][chosen_cocktail_size] > 0) {
+      mask |= (preset_mask_t)1 << slot;
+    }
+  }
+  changed_mask |= mask ^ available_mask;
+  available_mask = mask;
+}
+
+void availability_rebuild() {
+  for (int ingredient = 0; ingredient < INGREDIENT_COUNT; ingredient++) {
+    ingredient_users[ingredient] = 0;
+    update_headroom(ingredient);
+  }
+  for (int slot = 0; slot < PRESET_COCKTAIL_COUNT; slot++) {
+    for (int ingredient = 0; ingredient < INGREDIENT_COUNT; ingredient++) {
+      int amount = preset_cocktails[slot].amounts[ingredient];
+      for (int size = 0; size < PORTION_SIZE_COUNT; size++) {
+        // Rounded up, so a preset is never shown as available when it is not.
+        required_ml[slot][size][ingredient] = (amount * PORTION_PERMILLE[size] + 999) / 1000;
+      }
+      if (amount != 0) {
+        ingredient_users[ingredient] |= (preset_mask_t)1 << slot;
+      }
+    }
+    update_servings(slot);
+  }
+  update_mask();
+}
+
+void availability_ingredient_changed(int ingredient_index) {
+  update_headroom(ingredient_index);
+  preset_mask_t users = ingredient_users[ingredient_index];
+  for (int slot = 0; users != 0; slot++, users >>= 1) {
+    if (users & 1) {
+      update_servings(slot);
+    }
+  }
+  update_mask();
+  makeable_ingredient_changed(ingredient_index);
+}
+
+void availability_size_changed() {
+  // Servings are kept for every size, so only the visible counts change.
+  changed_mask = ALL_PRESETS_MASK;
+  update_mask();
+  makeable_size_changed();
+}
+
+bool preset_available(int slot) {
+  return slot >= 0 && slot < PRESET_COCKTAIL_COUNT && (available_mask >> slot) & 1;
+}
+
+bool recipe_available(recipe_id_t id) {
+  return preset_available(find_preset(id));
+}
+
+preset_mask_t preset_available_mask() {
+  return available_mask;
+}
+
+int preset_servings(int slot, CocktailSize size) {
+  if (slot < 0 || slot >= PRESET_COCKTAIL_COUNT) return 0;
+  return servings[slot][size];
+}
+
+int ingredient_headroom_ml(int ingredient_index) {
+  return headroom_ml[ingredient_index];
+}
+
+preset_mask_t availability_take_changes() {
+  preset_mask_t changes = changed_mask;
+  changed_mask = 0;
+  return changes;
+}
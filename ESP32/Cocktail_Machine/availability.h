@@ -0,0 +1,64 @@
+#ifndef AVAILABILITY_H
+#define AVAILABILITY_H
+
+#include "cocktail_data.h"
+
+// Bit i of a preset mask stands for preset_cocktails[i].
+typedef uint16_t preset_mask_t;
+static_assert(PRESET_COCKTAIL_COUNT <= 16, "preset_mask_t too small");
+const preset_mask_t ALL_PRESETS_MASK = (preset_mask_t)((1u << PRESET_COCKTAIL_COUNT) - 1);
+
+const int PORTION_SIZE_COUNT = 3;
+// Servings counts are capped here (a recipe using a few ml of a full bottle).
+const uint16_t SERVINGS_MAX = 999;
+
+/*
+Recomputes servings and availability of every preset. Call when the presets
+change (update_recipe_index() does).
+*/
+void availability_rebuild();
+
+/*
+Recomputes servings only for the presets that use this ingredient, in
+O(INGREDIENT_COUNT) each, and updates the library-wide makeable set. Call
+when its stock changes.
+*/
+void availability_ingredient_changed(int ingredient_index);
+
+/*
+Call when chosen_cocktail_size changed (set_cocktail_size() does).
+*/
+void availability_size_changed();
+
+/*
+True if preset `slot` can be poured at the chosen size. O(1).
+*/
+bool preset_available(int slot);
+
+/*
+Same, looked up by recipe ID.
+*/
+bool recipe_available(recipe_id_t id);
+
+preset_mask_t preset_available_mask();
+
+/*
+How many more servings of preset `slot` at `size` the current stock allows:
+the minimum over its ingredients of headroom / scaled amount.
+*/
+int preset_servings(int slot, CocktailSize size);
+
+/*
+Millilitres of an ingredient that can still be used before it hits the
+minimum level.
+*/
+int ingredient_headroom_ml(int ingredient_index);
+
+/*
+Returns the presets whose availability or servings count at the chosen size
+changed since the last call, and clears the set. The UI redraws just those
+tiles.
+*/
+preset_mask_t availability_take_changes();
+
+#endif
@@ -8,27 +8,75 @@
 #include "menu.h"
 #include "filesystem.h"
 #include "motors_sensors.h"
+#include "calibration.h"
+#include "auto_zero.h"
+#include "trace_recorder.h"
+#include "health.h"
+#include "availability.h"
+#include "recipe_store.h"
+#include "makeable.h"
+#include "alloc_track.h"
+#include "order_history.h"
+#include "forecast.h"
+#include "order_journal.h"
 
 #define SERVICE_UUID "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
 #define CHARACTERISTIC_UUID "beb5483e-36e1-4688-b7f5-ea07361b26a8"
 #define SERVICE_PUSH_UUID "6ba7b810-9dad-11d1-80b4-00c04fd430c8"
 #define CHARACTERISTIC_PUSH_UUID "6ba7b811-9dad-11d1-80b4-00c04fd430c8"
 #define SEND_DELAY 3000
+#define TRACE_CHUNK_INTERVAL_MS 20
+#define MAKEABLE_BLE_IDS 64
+#define HISTORY_BLE_BUCKETS 8
+
+// Document sizes for messages that list every pump or preset.
+static const size_t MENU_JSON_SIZE = json_list_size(PRESET_COCKTAIL_COUNT, 4 + INGREDIENT_COUNT, COCKTAIL_NAME_CAPACITY + 32);
+static const size_t STOCK_JSON_SIZE = json_list_size(INGREDIENT_COUNT, 4, INGREDIENT_NAME_CAPACITY + 16);
+static const size_t SERVINGS_JSON_SIZE = json_list_size(PRESET_COCKTAIL_COUNT, 6, 16);
+static const size_t STATS_JSON_SIZE = 512 + json_list_size(PRESET_COCKTAIL_COUNT, 5, 16);
+static const size_t FORECAST_JSON_SIZE = json_list_size(INGREDIENT_COUNT, 4, INGREDIENT_NAME_CAPACITY);
+static const size_t HISTORY_JSON_SIZE = json_list_size(HISTORY_BLE_BUCKETS, 4 + ORDER_OUTCOME_COUNT + INGREDIENT_COUNT, 16);
 
 enum RequestType { MENU,
                    STATS,
                    INGREDIENTS,
+                   CALIBRATION,
+                   DRIFT,
+                   TRACE,
+                   HEALTH,
+                   SERVINGS,
+                   LIBRARY,
+                   MAKEABLE,
+                   ALLOC,
+                   FORECAST,
+                   JOURNAL,
                    UNKNOWN };
 
 enum PostType {POST_MENU,
                 POST_INGREDIENTS,
                 POST_CLEAN,
+                POST_CALIBRATE,
+                POST_SAMPLE_RATE,
+                POST_PAGE,
+                POST_HISTORY,
+                POST_CLOCK,
+                POST_FORECAST,
                 POST_UNKNOWN};
 
 RequestType parseRequestType(const std::string& type) {
     if (type == "Menu") return MENU;
     if (type == "Stats") return STATS;
     if (type == "Stock") return INGREDIENTS;
+    if (type == "Calibration") return CALIBRATION;
+    if (type == "Drift") return DRIFT;
+    if (type == "Trace") return TRACE;
+    if (type == "Health") return HEALTH;
+    if (type == "Servings") return SERVINGS;
+    if (type == "Library") return LIBRARY;
+    if (type == "Makeable") return MAKEABLE;
+    if (type == "Alloc") return ALLOC;
+    if (type == "Forecast") return FORECAST;
+    if (type == "Journal") return JOURNAL;
     return UNKNOWN;
 }
 
@@ -36,6 +84,12 @@ PostType parsePostType(const std::string& type) {
     if (type == "Menu") return POST_MENU;
     if (type == "Stock") return POST_INGREDIENTS;
     if (type == "Clean") return POST_CLEAN;
+    if (type == "Calibrate") return POST_CALIBRATE;
+    if (type == "SampleRate") return POST_SAMPLE_RATE;
+    if (type == "Page") return POST_PAGE;
+    if (type == "History") return POST_HISTORY;
+    if (type == "Clock") return POST_CLOCK;
+    if (type == "Forecast") return POST_FORECAST;
     return POST_UNKNOWN;
 }
 
@@ -54,12 +108,13 @@ static void clearCocktailAmounts(Cocktail& c) {
 void send_menu_via_ble() {
     if (!deviceConnected || !pCharacteristic) return;
 
-    StaticJsonDocument<512> doc;
+    StaticJsonDocument<MENU_JSON_SIZE> doc;
     JsonArray cocktailArray = doc.to<JsonArray>();
 
     for (int i = 0; i < PRESET_COCKTAIL_COUNT; ++i) {
-        if (preset_cocktails[i].name.length() > 0) {
+        if (preset_cocktails[i].name[0] != '\0') {
             JsonObject cocktailObj = cocktailArray.createNestedObject();
+            cocktailObj["id"] = preset_cocktails[i].id;
             cocktailObj["name"] = preset_cocktails[i].name;
             JsonArray amountsArray = cocktailObj.createNestedArray("amounts");
             for (int j = 0; j < INGREDIENT_COUNT; ++j) {
@@ -80,8 +135,22 @@ static void fillCocktailAmountsFromJson(Cocktail& cocktail, JsonArray amountsJso
     }
 }
 
+// Recipes sent by the app keep their ID if it is one of ours; apps that do
+// not send IDs are matched by name so reordering keeps the stats.
+static recipe_id_t keptRecipeId(recipe_id_t sent, const char* name, const Cocktail old_presets[]) {
+    if (find_preset(sent) >= 0) {
+        return sent;
+    }
+    for (int i = 0; i < PRESET_COCKTAIL_COUNT; ++i) {
+        if (old_presets[i].id != RECIPE_ID_NONE && same_name(old_presets[i].name, name)) {
+            return old_presets[i].id;
+        }
+    }
+    return RECIPE_ID_NONE;
+}
+
 void parseIngredientsJson(const String& json) {
-    StaticJsonDocument<512> doc;
+    StaticJsonDocument<STOCK_JSON_SIZE> doc;
     DeserializationError err = deserializeJson(doc, json);
     if (err) {
         Serial.println("Failed to parse JSON");
@@ -90,24 +159,63 @@ void parseIngredientsJson(const String& json) {
 
     for (int i = 0; i < INGREDIENT_COUNT; ++i) {
         JsonObject obj = doc.as<JsonArray>()[i];
-        ingredients[i].name = obj["name"].as<String>();
-        ingredients[i].amount_left = obj["amount"].as<float>();
+        set_name(ingredients[i].name, obj["name"] | "");
+        ingredients[i].amount_left_ul = ml_to_ul(obj["amount"].as<float>());
+        // Optional, in g/ml; a missing or implausible value means water.
+        ingredients[i].density_mg_per_ml = valid_density(lroundf((obj["density"] | 1.0f) * 1000));
+        availability_ingredient_changed(i);
     }
 
-    save_ingredients(ingredients);
+    mark_ingredients_dirty();
     draw_current_menu();
 }
 
+void send_forecast_via_ble() {
+    if (!deviceConnected || !pCharacteristic) return;
+
+    // {"lead_min":10,"ingredients":[{"name":..,"ml_per_min":2.5,"eta_min":34,"warned":false}]}
+    // "eta_min" is -1 for an ingredient not in use lately.
+    StaticJsonDocument<FORECAST_JSON_SIZE> doc;
+    doc["lead_min"] = forecast_lead_minutes;
+    JsonArray ingredientArray = doc.createNestedArray("ingredients");
+    for (int i = 0; i < INGREDIENT_COUNT; ++i) {
+        JsonObject entry = ingredientArray.createNestedObject();
+        entry["name"] = ingredients[i].name;
+        entry["ml_per_min"] = forecast_rate_ml_per_min(i);
+        entry["eta_min"] = forecast_minutes_to_empty(i);
+        entry["warned"] = forecast_warned(i);
+    }
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    pCharacteristic->setValue(jsonString.c_str());
+}
+
+// {"lead_min":15}: warn this many minutes before an ingredient runs out.
+static void parseForecastJson(const String& json) {
+    StaticJsonDocument<64> doc;
+    DeserializationError err = deserializeJson(doc, json);
+    if (err) {
+        Serial.println("Failed to parse JSON");
+        return;
+    }
+
+    int lead = doc["lead_min"] | forecast_lead_minutes;
+    forecast_lead_minutes = constrain(lead, 1, 240);
+    send_forecast_via_ble();
+}
+
 void send_ingredients_via_ble() {
     if (!deviceConnected || !pCharacteristic) return;
 
-    StaticJsonDocument<512> doc;
+    StaticJsonDocument<STOCK_JSON_SIZE> doc;
     JsonArray ingredientArray = doc.to<JsonArray>();
 
     for (int i = 0; i < INGREDIENT_COUNT; ++i) {
         JsonObject ing = ingredientArray.createNestedObject();
         ing["name"] = ingredients[i].name;
-        ing["amount"] = int(ingredients[i].amount_left);
+        ing["amount"] = stock_ml(ingredients[i]);
+        ing["density"] = ingredients[i].density_mg_per_ml / 1000.0f;
     }
 
     String jsonString;
@@ -115,8 +223,15 @@ void send_ingredients_via_ble() {
     pCharacteristic->setValue(jsonString.c_str());
 }
 
+// Saving a page rewrites /recipes.bin while loop() may be reading it, so
+// onWrite only parses the posted page and ble_loop() applies and saves it,
+// like the calibration steps below.
+static Cocktail pending_presets[PRESET_COCKTAIL_COUNT];
+static int pending_preset_count = 0;
+static volatile bool presets_pending = false;
+
 static void parseCocktailJson(const String& json) {
-    StaticJsonDocument<2048> doc;
+    StaticJsonDocument<MENU_JSON_SIZE> doc;
     DeserializationError err = deserializeJson(doc, json);
     if (err) {
         Serial.println("Failed to parse JSON");
@@ -127,11 +242,9 @@ static void parseCocktailJson(const String& json) {
         Serial.println("Expected JSON array");
         return;
     }
-
-    // Backup old cocktails before overwriting
-    Cocktail old_presets[PRESET_COCKTAIL_COUNT];
-    for (int i = 0; i < PRESET_COCKTAIL_COUNT; ++i) {
-        old_presets[i] = preset_cocktails[i];
+    if (presets_pending) {
+        Serial.println("Cocktails ignored: previous page still saving");
+        return;
     }
 
     int cocktailCount = 0;
@@ -139,25 +252,343 @@ static void parseCocktailJson(const String& json) {
     for (JsonObject obj : doc.as<JsonArray>()) {
         if (cocktailCount >= PRESET_COCKTAIL_COUNT) break;
 
-        Cocktail& c = preset_cocktails[cocktailCount];
-        c.name = obj["name"].as<String>();
+        // The sent ID is checked against the page when the post is applied.
+        Cocktail& c = pending_presets[cocktailCount];
+        set_name(c.name, obj["name"] | "");
+        c.id = obj["id"] | RECIPE_ID_NONE;
         clearCocktailAmounts(c);
 
         JsonArray amountsJson = obj["amounts"].as<JsonArray>();
         fillCocktailAmountsFromJson(c, amountsJson);
         cocktailCount++;
     }
+    pending_preset_count = cocktailCount;
+    presets_pending = true;
+}
 
-    // Reset stats for replaced cocktails
-    reset_stats_if_replaced(old_presets, preset_cocktails, stats);
+// Waits for the machine to be idle: the save blocks loop() for as long as
+// the library takes to rewrite.
+static void apply_pending_presets() {
+    if (!presets_pending || order_pending) return;
+
+    // Backup old cocktails before overwriting
+    Cocktail old_presets[PRESET_COCKTAIL_COUNT];
+    for (int i = 0; i < PRESET_COCKTAIL_COUNT; ++i) {
+        old_presets[i] = preset_cocktails[i];
+    }
+
+    int cocktailCount = pending_preset_count;
+    for (int i = 0; i < cocktailCount; ++i) {
+        Cocktail& c = preset_cocktails[i];
+        c = pending_presets[i];
+        c.id = keptRecipeId(c.id, c.name, old_presets);
+    }
+    // The post replaces the whole page.
+    for (int i = cocktailCount; i < PRESET_COCKTAIL_COUNT; ++i) {
+        preset_cocktails[i] = make_cocktail("");
+    }
+
+    // New recipes get fresh IDs; known ones keep theirs and their stats.
+    assign_missing_recipe_ids();
+    update_recipe_index();
 
     Serial.println("Parsed cocktails:");
     for (int i = 0; i < cocktailCount; ++i) {
         log_cocktail(preset_cocktails[i]);
     }
 
-    save_cocktails(preset_cocktails, cocktailCount);
+    recipe_store_save_page();
     reset_menu_selection();
+    presets_pending = false;
+}
+
+void send_library_via_ble() {
+    if (!deviceConnected || !pCharacteristic) return;
+
+    StaticJsonDocument<128> doc;
+    doc["slots"] = recipe_store_count();
+    doc["pages"] = recipe_store_page_count();
+    doc["page"] = recipe_store_current_page();
+    doc["page_size"] = RECIPE_PAGE_SIZE;
+    doc["skip_unmakeable"] = skip_unmakeable_pages;
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    pCharacteristic->setValue(jsonString.c_str());
+}
+
+void send_makeable_via_ble() {
+    if (!deviceConnected || !pCharacteristic) return;
+
+    // {"count":n,"ids":[...]}: recipes of the whole library that can be
+    // poured now at the chosen size, the first MAKEABLE_BLE_IDS of them listed.
+    StaticJsonDocument<1024> doc;
+    doc["count"] = makeable_count();
+    JsonArray idArray = doc.createNestedArray("ids");
+    int listed = 0;
+    for (int position = next_makeable(0); position >= 0 && listed < MAKEABLE_BLE_IDS; position = next_makeable(position + 1)) {
+        idArray.add(recipe_store_id_at(position));
+        listed++;
+    }
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    pCharacteristic->setValue(jsonString.c_str());
+}
+
+// {"page":2} shows that page (one past the last starts a new one);
+// {"id":42} shows the page holding that recipe;
+// {"skip_unmakeable":false} makes tapping "1" visit every page in order.
+static void parsePageJson(const String& json) {
+    StaticJsonDocument<64> doc;
+    DeserializationError err = deserializeJson(doc, json);
+    if (err) {
+        Serial.println("Failed to parse JSON");
+        return;
+    }
+
+    if (doc.containsKey("skip_unmakeable")) {
+        skip_unmakeable_pages = doc["skip_unmakeable"];
+        Serial.printf("Skipping pages with nothing makeable: %s\n", skip_unmakeable_pages ? "on" : "off");
+        if (!doc.containsKey("page") && !doc.containsKey("id")) return;
+    }
+
+    int page = doc["page"] | -1;
+    recipe_id_t id = doc["id"] | RECIPE_ID_NONE;
+    if (id != RECIPE_ID_NONE) {
+        int position = recipe_store_position(id);
+        page = position >= 0 ? position / RECIPE_PAGE_SIZE : -1;
+    }
+    if (page < 0 || !recipe_store_load_page(page)) {
+        Serial.println("No such recipe page");
+        return;
+    }
+    reset_menu_selection();
+}
+
+static void send_history_via_ble(HistoryTier tier, uint32_t from, uint32_t to) {
+    if (!deviceConnected || !pCharacteristic) return;
+
+    OrderBucket buckets[HISTORY_BLE_BUCKETS];
+    uint32_t next = 0;
+    int count = history_read(tier, from, to, buckets, HISTORY_BLE_BUCKETS, next);
+
+    // {"bucket_s":300,"now":...,"clock_set":true,"next":t,"buckets":[{"t":start,
+    // "orders":[completed,cancelled,timeout,aborted],"ml":[...],"mean_pour_ms":n}]}
+    // "next" is where to continue the range, 0 when it was sent completely.
+    StaticJsonDocument<HISTORY_JSON_SIZE> doc;
+    doc["bucket_s"] = history_bucket_seconds(tier);
+    doc["now"] = history_now();
+    doc["clock_set"] = history_clock_set();
+    doc["next"] = next;
+    JsonArray bucketArray = doc.createNestedArray("buckets");
+    for (int i = 0; i < count; ++i) {
+        JsonObject entry = bucketArray.createNestedObject();
+        entry["t"] = buckets[i].start;
+        JsonArray outcomes = entry.createNestedArray("orders");
+        uint32_t orders = 0;
+        for (int outcome = 0; outcome < ORDER_OUTCOME_COUNT; ++outcome) {
+            outcomes.add(buckets[i].outcomes[outcome]);
+            orders += buckets[i].outcomes[outcome];
+        }
+        JsonArray poured = entry.createNestedArray("ml");
+        for (int j = 0; j < INGREDIENT_COUNT; ++j) {
+            poured.add(buckets[i].poured_ml[j]);
+        }
+        entry["mean_pour_ms"] = orders ? buckets[i].pour_ms / orders : 0;
+    }
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    pCharacteristic->setValue(jsonString.c_str());
+}
+
+// {"tier":"5m" or "1h","from":t,"to":t}, times in seconds since 1970. "to"
+// defaults to now; the answer is left on the characteristic.
+static void parseHistoryJson(const String& json) {
+    StaticJsonDocument<128> doc;
+    DeserializationError err = deserializeJson(doc, json);
+    if (err) {
+        Serial.println("Failed to parse JSON");
+        return;
+    }
+
+    HistoryTier tier = strcmp(doc["tier"] | "5m", "1h") == 0 ? History_Hourly : History_Fine;
+    uint32_t from = doc["from"] | 0u;
+    uint32_t to = doc["to"] | (history_now() + 1);
+    send_history_via_ble(tier, from, to);
+}
+
+void send_calibration_via_ble() {
+    if (!deviceConnected || !pCharacteristic) return;
+
+    StaticJsonDocument<256> doc;
+    doc["offset"] = scale_calibration.offset;
+    doc["counts_per_gram"] = scale_calibration.counts_per_kg / 1000.0f;
+    doc["session_active"] = calibration_session.active;
+    doc["points"] = calibration_session.point_count;
+    doc["fit_counts_per_gram"] = calibration_session.counts_per_kg / 1000.0f;
+    doc["nonlinearity_percent"] = calibration_session.nonlinearity_percent;
+    doc["valid"] = calibration_is_valid();
+    doc["status"] = calibration_session.status;
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    pCharacteristic->setValue(jsonString.c_str());
+}
+
+void send_drift_via_ble() {
+    if (!deviceConnected || !pCharacteristic) return;
+
+    StaticJsonDocument<256> doc;
+    doc["uptime_s"] = millis() / 1000;
+    doc["corrections"] = drift_stats.corrections;
+    doc["total_drift_g"] = mg_to_grams(drift_stats.total_drift_mg);
+    doc["max_abs_drift_g"] = mg_to_grams(drift_stats.max_abs_drift_mg);
+    doc["drift_rate_g_per_hour"] = mg_to_grams(auto_zero_drift_rate_mg_per_hour());
+    doc["last_correction_s"] = drift_stats.last_correction_ms / 1000;
+    doc["windows_loaded"] = drift_stats.windows_loaded;
+    doc["windows_unstable"] = drift_stats.windows_unstable;
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    pCharacteristic->setValue(jsonString.c_str());
+}
+
+void send_servings_via_ble() {
+    if (!deviceConnected || !pCharacteristic) return;
+
+    // [{"id":3,"servings":[small,medium,large]}, ...] for every named preset.
+    StaticJsonDocument<SERVINGS_JSON_SIZE> doc;
+    JsonArray presetArray = doc.to<JsonArray>();
+    for (int i = 0; i < PRESET_COCKTAIL_COUNT; ++i) {
+        if (preset_cocktails[i].name[0] == '\0') continue;
+        JsonObject entry = presetArray.createNestedObject();
+        entry["id"] = preset_cocktails[i].id;
+        JsonArray counts = entry.createNestedArray("servings");
+        for (int size = 0; size < PORTION_SIZE_COUNT; ++size) {
+            counts.add(preset_servings(i, (CocktailSize)size));
+        }
+    }
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    pCharacteristic->setValue(jsonString.c_str());
+}
+
+void send_health_via_ble() {
+    if (!deviceConnected || !pCharacteristic) return;
+
+    StaticJsonDocument<1024> doc;
+    doc["boot_ms"] = health_boot_total_ms();
+    doc["degraded"] = health_degraded();
+    JsonArray subsystems = doc.createNestedArray("subsystems");
+    for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+        JsonObject entry = subsystems.createNestedObject();
+        entry["name"] = health_subsystem_name((Subsystem)i);
+        entry["state"] = health_state_name(subsystem_health[i].state);
+        entry["boot_ms"] = subsystem_health[i].boot_ms;
+        entry["detail"] = subsystem_health[i].detail;
+    }
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    pCharacteristic->setValue(jsonString.c_str());
+}
+
+enum CalibrationStep { Calibrate_None, Calibrate_Tare, Calibrate_Point, Calibrate_Save, Calibrate_Cancel };
+
+// Tare and point steps read the scale for about two seconds, so onWrite only
+// queues the step and ble_loop() runs it, like the scale reads of loop().
+static volatile CalibrationStep pending_calibration_step = Calibrate_None;
+static weight_mg_t pending_calibration_mass_mg = 0;
+
+// Payload: {"step":"tare"}, {"step":"point","grams":100}, {"step":"save"} or {"step":"cancel"}.
+// The resulting calibration state is left on the characteristic for the app to read.
+static void parseCalibrateJson(const String& json) {
+    StaticJsonDocument<128> doc;
+    DeserializationError err = deserializeJson(doc, json);
+    if (err) {
+        Serial.println("Failed to parse JSON");
+        return;
+    }
+    if (pending_calibration_step != Calibrate_None) {
+        Serial.println("Calibration step ignored: previous step still running");
+        return;
+    }
+
+    String step = doc["step"] | "";
+    CalibrationStep parsed = Calibrate_None;
+    if (step == "tare") {
+        parsed = Calibrate_Tare;
+    } else if (step == "point") {
+        pending_calibration_mass_mg = grams_to_mg(doc["grams"] | 0.0f);
+        parsed = Calibrate_Point;
+    } else if (step == "save") {
+        parsed = Calibrate_Save;
+    } else if (step == "cancel") {
+        parsed = Calibrate_Cancel;
+    } else {
+        Serial.println("Unknown calibration step");
+        return;
+    }
+    pending_calibration_step = parsed;
+}
+
+static void run_pending_calibration_step() {
+    CalibrationStep step = pending_calibration_step;
+    if (step == Calibrate_None) return;
+
+    switch (step) {
+        case Calibrate_Tare:
+            if (!calibration_start()) {
+                Serial.println("Calibration tare refused");
+            }
+            break;
+        case Calibrate_Point:
+            if (!calibration_add_point(pending_calibration_mass_mg)) {
+                Serial.println("Calibration point rejected");
+            }
+            break;
+        case Calibrate_Save:
+            calibration_save();
+            break;
+        default:
+            calibration_cancel();
+            break;
+    }
+    pending_calibration_step = Calibrate_None;
+
+    if (current_menu == Service) {
+        draw_current_menu();
+    }
+    send_calibration_via_ble();
+}
+
+void send_alloc_via_ble() {
+    if (!deviceConnected || !pCharacteristic) return;
+
+    StaticJsonDocument<1024> doc;
+    doc["free_heap"] = ESP.getFreeHeap();
+    doc["largest_free_block"] = ESP.getMaxAllocHeap();
+    doc["orders"] = alloc_orders;
+    doc["orders_allocating"] = alloc_orders_allocating;
+    doc["last_order_heap_blocks"] = last_order_alloc.heap_blocks_delta;
+    doc["last_order_free_bytes"] = last_order_alloc.free_bytes_delta;
+    JsonArray scopes = doc.createNestedArray("scopes");
+    for (int i = 0; i < ALLOC_SCOPE_COUNT; i++) {
+        JsonObject entry = scopes.createNestedObject();
+        entry["name"] = alloc_scope_name((AllocScope)i);
+        entry["allocations"] = alloc_counters[i].allocations;
+        entry["frees"] = alloc_counters[i].frees;
+        entry["bytes"] = alloc_counters[i].bytes;
+        entry["min_largest_free"] = alloc_counters[i].min_largest_free;
+        entry["last_order_allocations"] = last_order_alloc.allocations[i];
+    }
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    pCharacteristic->setValue(jsonString.c_str());
 }
 
 class MyServerCallbacks : public BLEServerCallbacks {
@@ -172,18 +603,25 @@ class MyServerCallbacks : public BLEServerCallbacks {
 void send_stats_via_ble() {
     if (!deviceConnected || !pCharacteristic) return;
 
-    StaticJsonDocument<512> doc;
+    StaticJsonDocument<STATS_JSON_SIZE> doc;
 
     doc["orders_completed"] = stats.orders_completed;
     doc["random_drink_orders"] = stats.random_drink_orders;
     doc["preset_drink_orders"] = stats.preset_drink_orders;
     doc["orders_timed_out"] = stats.orders_timed_out;
     doc["orders_cancelled"] = stats.orders_cancelled;
+    doc["orders_aborted"] = stats.orders_aborted;
     doc["custom_drink_orders"] = stats.custom_drink_orders;
 
+    // Positional counts for older apps, plus counts keyed by recipe ID.
     JsonArray orderCountsArray = doc.createNestedArray("preset_cocktail_order_counts");
+    JsonArray recipeCountsArray = doc.createNestedArray("recipe_order_counts");
     for (int i = 0; i < PRESET_COCKTAIL_COUNT; ++i) {
-        orderCountsArray.add(stats.preset_cocktail_order_counts[i]);
+        orderCountsArray.add(stats.preset_order_counts[i].count);
+        if (stats.preset_order_counts[i].id == RECIPE_ID_NONE) continue;
+        JsonObject entry = recipeCountsArray.createNestedObject();
+        entry["id"] = stats.preset_order_counts[i].id;
+        entry["count"] = stats.preset_order_counts[i].count;
     }
 
     String jsonString;
@@ -193,6 +631,7 @@ void send_stats_via_ble() {
 
 class MyCharacteristicCallbacks : public BLECharacteristicCallbacks {
     void onWrite(BLECharacteristic* c) override {
+        AllocScopeGuard alloc_scope(Alloc_Bluetooth);
         std::string input = c->getValue();
         if (input.empty()) return;
 
@@ -217,6 +656,16 @@ class MyCharacteristicCallbacks : public BLECharacteristicCallbacks {
                 case MENU: send_menu_via_ble(); break;
                 case STATS: send_stats_via_ble(); break;
                 case INGREDIENTS: send_ingredients_via_ble(); break;
+                case CALIBRATION: send_calibration_via_ble(); break;
+                case DRIFT: send_drift_via_ble(); break;
+                case TRACE: trace_start_export(); break;  // streamed from ble_loop()
+                case HEALTH: send_health_via_ble(); break;
+                case SERVINGS: send_servings_via_ble(); break;
+                case LIBRARY: send_library_via_ble(); break;
+                case MAKEABLE: send_makeable_via_ble(); break;
+                case ALLOC: send_alloc_via_ble(); break;
+                case FORECAST: send_forecast_via_ble(); break;
+                case JOURNAL: journal_start_export(); break;  // streamed from ble_loop()
                 default:
                     char s[512], *p = "0123456789ABCDEF";
                     for (int i = 0; i < 512; i++)
@@ -252,10 +701,45 @@ class MyCharacteristicCallbacks : public BLECharacteristicCallbacks {
                 parseIngredientsJson(String(payload.c_str()));
                 break;
             case POST_CLEAN:{
-                int clean_index = payload.empty() ? -1 : payload[0] - '0';
-                pour_until_stopped(clean_index);
+                // The pump index, 0 to INGREDIENT_COUNT - 1
+                char* end = nullptr;
+                long clean_index = strtol(payload.c_str(), &end, 10);
+                if (payload.empty() || *end != '\0' || clean_index < 0 || clean_index >= INGREDIENT_COUNT) {
+                    Serial.printf("Unknown pump \"%s\" to clean\n", payload.c_str());
+                    break;
+                }
+                pour_until_stopped((int)clean_index);
                 break;
             }
+            case POST_CALIBRATE:
+                parseCalibrateJson(String(payload.c_str()));
+                break;
+            case POST_SAMPLE_RATE:
+                // "10" or "80": sample rate used while pumps run
+                if (payload == "10") {
+                    pour_sample_rate = Rate_10SPS;
+                } else if (payload == "80") {
+                    pour_sample_rate = Rate_80SPS;
+                } else {
+                    Serial.printf("Unknown sample rate \"%s\", keeping %s SPS\n", payload.c_str(),
+                                  pour_sample_rate == Rate_80SPS ? "80" : "10");
+                    break;
+                }
+                Serial.printf("Pour sample rate: %s SPS\n", pour_sample_rate == Rate_80SPS ? "80" : "10");
+                break;
+            case POST_PAGE:
+                parsePageJson(String(payload.c_str()));
+                break;
+            case POST_HISTORY:
+                parseHistoryJson(String(payload.c_str()));
+                break;
+            case POST_CLOCK:
+                // Seconds since 1970, sent by the app on connect
+                history_set_clock(strtoul(payload.c_str(), nullptr, 10));
+                break;
+            case POST_FORECAST:
+                parseForecastJson(String(payload.c_str()));
+                break;
             default:
                 Serial.println("Unknown POST type");
                 break;
@@ -267,12 +751,62 @@ class MyCharacteristicCallbacks : public BLECharacteristicCallbacks {
     }
 };
 
-void send_push_notification(int ingredientIndex) {
-    if (deviceConnected && pPushCharacteristic) {
-        Serial.println("Pushing notification");
-        String msg = String(ingredientIndex);
-        pPushCharacteristic->setValue(msg.c_str());
-        pPushCharacteristic->notify();
+bool send_push_notification(int ingredientIndex) {
+    if (!deviceConnected || !pPushCharacteristic) {
+        Serial.printf("No app connected, push for ingredient %d dropped\n", ingredientIndex);
+        return false;
+    }
+    AllocScopeGuard alloc_scope(Alloc_Bluetooth);
+    Serial.println("Pushing notification");
+    char msg[12];
+    snprintf(msg, sizeof(msg), "%d", ingredientIndex);
+    pPushCharacteristic->setValue(msg);
+    pPushCharacteristic->notify();
+    return true;
+}
+
+// Streams a pending trace export as binary notifications, one chunk per call.
+// The app needs an MTU above TRACE_BLE_CHUNK to receive whole chunks.
+void send_trace_chunk_via_ble() {
+    static unsigned long last_chunk_time = 0;
+    if (!trace_export_active()) return;
+    if (!deviceConnected || !pCharacteristic) {
+        while (trace_export_active()) {
+            uint8_t discard[TRACE_BLE_CHUNK];
+            trace_next_chunk(discard, sizeof(discard));
+        }
+        return;
+    }
+    if (millis() - last_chunk_time < TRACE_CHUNK_INTERVAL_MS) return;
+    last_chunk_time = millis();
+
+    uint8_t chunk[TRACE_BLE_CHUNK];
+    size_t length = trace_next_chunk(chunk, sizeof(chunk));
+    if (length > 0) {
+        pCharacteristic->setValue(chunk, length);
+        pCharacteristic->notify();
+    }
+}
+
+// Streams a pending journal export the same way, once no trace is streaming.
+void send_journal_chunk_via_ble() {
+    static unsigned long last_chunk_time = 0;
+    if (!journal_export_active() || trace_export_active()) return;
+    if (!deviceConnected || !pCharacteristic) {
+        while (journal_export_active()) {
+            uint8_t discard[JOURNAL_BLE_CHUNK];
+            journal_next_chunk(discard, sizeof(discard));
+        }
+        return;
+    }
+    if (millis() - last_chunk_time < TRACE_CHUNK_INTERVAL_MS) return;
+    last_chunk_time = millis();
+
+    uint8_t chunk[JOURNAL_BLE_CHUNK];
+    size_t length = journal_next_chunk(chunk, sizeof(chunk));
+    if (length > 0) {
+        pCharacteristic->setValue(chunk, length);
+        pCharacteristic->notify();
     }
 }
 
@@ -315,4 +849,8 @@ void ble_loop() {
     if (deviceConnected && !oldDeviceConnected) {
         oldDeviceConnected = deviceConnected;
     }
+    run_pending_calibration_step();
+    apply_pending_presets();
+    send_trace_chunk_via_ble();
+    send_journal_chunk_via_ble();
 }
\ No newline at end of file
@@ -10,5 +10,16 @@ void ble_loop();
 void log_cocktail(const Cocktail& cocktail);
 void send_menu_via_ble();
 void send_stats_via_ble();
-void send_push_notification(int ingredientIndex);
+void send_calibration_via_ble();
+void send_drift_via_ble();
+void send_trace_chunk_via_ble();
+void send_journal_chunk_via_ble();
+void send_health_via_ble();
+void send_servings_via_ble();
+void send_library_via_ble();
+void send_makeable_via_ble();
+void send_alloc_via_ble();
+void send_forecast_via_ble();
+// Returns false if no app is connected to receive it.
+bool send_push_notification(int ingredientIndex);
 #endif 
@@ -0,0 +1,156 @@
+#include "calibration.h"
+#include "filesystem.h"
+#include "health.h"
+
+CalibrationSession calibration_session;
+static bool has_stored_calibration = false;
+
+void calibration_load_at_boot() {
+  ScaleCalibration stored = scale_calibration;
+  if (!load_calibration(stored)) {
+    Serial.println("No stored calibration, using default factor.");
+    weight_set_calibration(scale_calibration.offset, DEFAULT_COUNTS_PER_KG);
+    return;
+  }
+  weight_set_calibration(stored.offset, stored.counts_per_kg);
+  has_stored_calibration = true;
+  Serial.printf("Loaded calibration: offset=%ld, %.3f counts/g\n",
+                (long)stored.offset, stored.counts_per_kg / 1000.0f);
+}
+
+void calibration_boot_tare() {
+  int32_t zero_raw;
+  if (!weight_read_raw_checked(10, zero_raw)) {
+    Serial.println("Boot tare skipped: load cell not responding.");
+    return;
+  }
+  weight_mg_t shift = weight_raw_to_mg(zero_raw);
+  if (has_stored_calibration && abs(shift) > CALIBRATION_MAX_BOOT_ZERO_SHIFT_MG) {
+    Serial.printf("Boot tare is %.1f g off the stored zero, keeping stored zero.\n", mg_to_grams(shift));
+    return;
+  }
+  weight_set_calibration(zero_raw, scale_calibration.counts_per_kg);
+}
+
+static void fit_calibration() {
+  CalibrationSession& s = calibration_session;
+  // Least squares line through the tared zero: counts = k * mass.
+  double sum_cm = 0;
+  double sum_mm = 0;
+  weight_mg_t max_mass = 0;
+  for (int i = 0; i < s.point_count; i++) {
+    double counts = s.point_raw[i] - s.zero_raw;
+    double mass_kg = s.point_mass_mg[i] / 1e6;
+    sum_cm += counts * mass_kg;
+    sum_mm += mass_kg * mass_kg;
+    max_mass = max(max_mass, s.point_mass_mg[i]);
+  }
+  if (sum_mm <= 0) {
+    s.counts_per_kg = 0;
+    return;
+  }
+  double k = sum_cm / sum_mm;
+
+  double worst = 0;
+  for (int i = 0; i < s.point_count; i++) {
+    double counts = s.point_raw[i] - s.zero_raw;
+    double expected = k * (s.point_mass_mg[i] / 1e6);
+    worst = max(worst, fabs(counts - expected));
+  }
+  double full_scale = k * (max_mass / 1e6);
+  s.counts_per_kg = (int32_t)lround(k);
+  s.nonlinearity_percent = full_scale > 0 ? (float)(100.0 * worst / full_scale) : 0;
+
+  Serial.printf("Calibration fit over %d points: %.3f counts/g, nonlinearity %.2f%%\n",
+                s.point_count, k / 1000.0, s.nonlinearity_percent);
+}
+
+// Refuses a calibration step with `status`, for the log and the app.
+static bool refuse(const char* status) {
+  calibration_session.status = status;
+  Serial.printf("Calibration: %s\n", status);
+  return false;
+}
+
+bool calibration_start() {
+  if (!health_ok(Subsystem_Load_Cell)) {
+    return refuse("load cell not ready");
+  }
+  int32_t zero_raw;
+  if (!weight_read_raw_checked(CALIBRATION_READ_SAMPLES, zero_raw)) {
+    return refuse("load cell not responding, no zero taken");
+  }
+  calibration_session = CalibrationSession();
+  calibration_session.zero_raw = zero_raw;
+  calibration_session.active = true;
+  Serial.printf("Calibration started, zero raw=%ld\n", (long)calibration_session.zero_raw);
+  return true;
+}
+
+bool calibration_add_point(weight_mg_t known_mass_mg) {
+  CalibrationSession& s = calibration_session;
+  if (!s.active) {
+    return refuse("no calibration running");
+  }
+  if (s.point_count >= CALIBRATION_MAX_POINTS) {
+    return refuse("no room for more points");
+  }
+  if (known_mass_mg <= 0) {
+    return refuse("reference mass missing");
+  }
+  int32_t raw;
+  if (!weight_read_raw_checked(CALIBRATION_READ_SAMPLES, raw)) {
+    return refuse("load cell not responding, point not taken");
+  }
+  if (raw < s.zero_raw + CALIBRATION_MIN_LOAD_COUNTS) {
+    Serial.printf("Calibration point rejected: reading %ld counts over zero, need %ld.\n",
+                  (long)(raw - s.zero_raw), (long)CALIBRATION_MIN_LOAD_COUNTS);
+    s.status = "reading too close to zero";
+    return false;
+  }
+  s.status = "";
+  s.point_raw[s.point_count] = raw;
+  s.point_mass_mg[s.point_count] = known_mass_mg;
+  s.point_count++;
+  Serial.printf("Calibration point %d: %.1f g -> raw %ld\n", s.point_count, mg_to_grams(known_mass_mg), (long)raw);
+  fit_calibration();
+  return true;
+}
+
+static int distinct_masses(const CalibrationSession& s) {
+  int distinct = 0;
+  for (int i = 0; i < s.point_count; i++) {
+    bool seen = false;
+    for (int j = 0; j < i && !seen; j++) {
+      seen = s.point_mass_mg[j] == s.point_mass_mg[i];
+    }
+    if (!seen) distinct++;
+  }
+  return distinct;
+}
+
+bool calibration_is_valid() {
+  const CalibrationSession& s = calibration_session;
+  return s.active && distinct_masses(s) >= CALIBRATION_MIN_DISTINCT_MASSES && s.counts_per_kg != 0
+         && s.nonlinearity_percent <= CALIBRATION_MAX_NONLINEARITY_PERCENT;
+}
+
+bool calibration_save() {
+  if (!calibration_is_valid()) {
+    Serial.printf("Calibration not saved: needs %d different masses and a linear fit.\n",
+                  CALIBRATION_MIN_DISTINCT_MASSES);
+    return false;
+  }
+  weight_set_calibration(calibration_session.zero_raw, calibration_session.counts_per_kg);
+  calibration_session.active = false;
+  if (!save_calibration(scale_calibration)) {
+    Serial.println("Calibration applied but could not be saved.");
+    return false;
+  }
+  Serial.println("Calibration saved.");
+  return true;
+}
+
+void calibration_cancel() {
+  calibration_session.active = false;
+}
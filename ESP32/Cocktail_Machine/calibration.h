@@ -0,0 +1,81 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <Arduino.h>
+#include "weight.h"
+
+const int CALIBRATION_MAX_POINTS = 5;
+const int CALIBRATION_READ_SAMPLES = 20;
+// A fit through zero matches any single point exactly, so linearity can only
+// be judged with at least this many different reference masses.
+const int CALIBRATION_MIN_DISTINCT_MASSES = 2;
+// A point must read at least this far above the tared zero (about 1.4 g at
+// the default gain), well above the noise of an averaged reading.
+const int32_t CALIBRATION_MIN_LOAD_COUNTS = 1000;
+// Largest deviation of any point from the fitted line, in percent of the
+// heaviest reference mass, before a calibration is rejected as non linear.
+const float CALIBRATION_MAX_NONLINEARITY_PERCENT = 1.0;
+// A boot tare further than this from the stored zero means something was
+// left on the platform, so the stored offset is kept instead.
+const weight_mg_t CALIBRATION_MAX_BOOT_ZERO_SHIFT_MG = 20000;
+
+struct CalibrationSession {
+  bool active = false;
+  int32_t zero_raw = 0;
+  int point_count = 0;
+  int32_t point_raw[CALIBRATION_MAX_POINTS] = {0};
+  weight_mg_t point_mass_mg[CALIBRATION_MAX_POINTS] = {0};
+  int32_t counts_per_kg = 0;        // result of the last fit, 0 if none
+  float nonlinearity_percent = 0;   // result of the last fit
+  const char* status = "";          // why the last step was refused, "" if it was not
+};
+
+extern CalibrationSession calibration_session;
+
+/*
+Loads the stored calibration (if any) and applies it to the scale.
+Must run after the filesystem is mounted and before the boot tare.
+*/
+void calibration_load_at_boot();
+
+/*
+Tares the platform at boot. If a stored zero exists and the new one is far
+from it, the platform is assumed loaded and the stored zero is kept. If the
+load cell does not answer, the zero is left as it is.
+*/
+void calibration_boot_tare();
+
+/*
+Tares the empty platform and starts a new calibration session. Returns false,
+with calibration_session.status set, if the load cell is not up or does not
+answer.
+*/
+bool calibration_start();
+
+/*
+Records the reading for a known reference mass currently on the platform and
+refits the factor over all points so far. Returns false, with
+calibration_session.status set, if no session is active, the session is
+full, the load cell does not answer, or the reading is not clearly above the
+zero.
+*/
+bool calibration_add_point(weight_mg_t known_mass_mg);
+
+/*
+Returns true if the current fit spans CALIBRATION_MIN_DISTINCT_MASSES masses
+and is linear enough.
+*/
+bool calibration_is_valid();
+
+/*
+Applies the fitted factor and the session zero, persists them and ends the
+session. Returns false if the fit is not valid or saving failed.
+*/
+bool calibration_save();
+
+/*
+Abandons the session, keeping the previous calibration.
+*/
+void calibration_cancel();
+
+#endif
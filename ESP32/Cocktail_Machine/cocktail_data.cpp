@@ -1,61 +1,174 @@
 #include "cocktail_data.h"
 #include <Arduino.h>
 #include "filesystem.h"
-#include <algorithm>
-#include <utility>
-
-const String UNSELECTED_COCKTAIL_NAME = "UNSELECTED";
-const String CUSTOM_COCKTAIL_NAME = "Custom Cocktail";
+#include "availability.h"
+#include "popularity.h"
+#include "recipe_store.h"
+#include "order_history.h"
+#include "forecast.h"
 
 Cocktail preset_cocktails[PRESET_COCKTAIL_COUNT] = {};
-Cocktail top_cocktails[TOP_COCKTAIL_COUNT] = {};
 Ingredient ingredients[INGREDIENT_COUNT] = {};
 Stats stats;
 
-Cocktail current_custom_cocktail = { CUSTOM_COCKTAIL_NAME, { 0, 0, 0, 0 } };
-Cocktail current_preset_cocktail = { UNSELECTED_COCKTAIL_NAME, { 0, 0, 0, 0 } };
-Cocktail ordered_cocktail = { UNSELECTED_COCKTAIL_NAME, { 0, 0, 0, 0 } };
+static RecipeIdIndex preset_index;
+
+Cocktail current_custom_cocktail = make_cocktail(CUSTOM_COCKTAIL_NAME, RECIPE_ID_CUSTOM);
+recipe_id_t selected_preset_id = RECIPE_ID_NONE;
+Cocktail ordered_cocktail = make_cocktail(UNSELECTED_COCKTAIL_NAME);
 CocktailSize chosen_cocktail_size = Medium;
 bool order_pending = false;
 Mode mode = Normal;
 
-void update_ingredient_amount(int ingredient_index, float amount_poured) {
-    ingredients[ingredient_index].amount_left = max(0.0f, ingredients[ingredient_index].amount_left - amount_poured);
-    save_ingredients(ingredients);
+void copy_name(char* dest, size_t capacity, const char* src) {
+    if (capacity == 0) return;
+    size_t length = strnlen(src, capacity - 1);
+    if (src[length] != '\0') {
+        // Truncating: do not keep the lead bytes of a cut multi-byte character.
+        while (length > 0 && (src[length] & 0xC0) == 0x80) {
+            length--;
+        }
+    }
+    memcpy(dest, src, length);
+    dest[length] = '\0';
+}
+
+Cocktail make_cocktail(const char* name, recipe_id_t id) {
+    Cocktail cocktail = {};
+    cocktail.id = id;
+    set_name(cocktail.name, name);
+    return cocktail;
 }
 
-bool isCocktailAvailable(Cocktail cocktail) {
-    Serial.println("#######Checking if cocktail " + cocktail.name + " is available.#######");
-    for (int ingredientIndex = 0; ingredientIndex < INGREDIENT_COUNT; ingredientIndex++) {
-        float required = cocktail.amounts[ingredientIndex];
-        if (!isIngredientAvailable(ingredients[ingredientIndex], required)) {
-            Serial.println("#######Cocktail is unavailable.#########");
-            return false;
+// Fibonacci hashing: 40503 is 2^16 divided by the golden ratio, and the top
+// `bits` of the 16-bit product spread consecutive IDs over the table.
+static int bucket_of(recipe_id_t id, int bits) {
+    return (uint16_t)(id * 40503u) >> (16 - bits);
+}
+
+void RecipeIdIndex::clear() {
+    for (int i = 0; i < BUCKETS; i++) {
+        ids[i] = RECIPE_ID_NONE;
+    }
+}
+
+void RecipeIdIndex::insert(recipe_id_t id, int slot) {
+    if (id == RECIPE_ID_NONE) return;
+    int bucket = bucket_of(id, BUCKET_BITS);
+    for (int probe = 0; probe < BUCKETS; probe++) {
+        if (ids[bucket] == RECIPE_ID_NONE || ids[bucket] == id) {
+            ids[bucket] = id;
+            slots[bucket] = slot;
+            return;
         }
+        bucket = (bucket + 1) % BUCKETS;
     }
-    Serial.println("#######Cocktail is available.#########");
-    return true;
 }
 
-bool isIngredientAvailable(Ingredient ingredient, float required) {
-    int available = ingredient.amount_left;
+int RecipeIdIndex::find(recipe_id_t id) const {
+    if (id == RECIPE_ID_NONE) return -1;
+    int bucket = bucket_of(id, BUCKET_BITS);
+    for (int probe = 0; probe < BUCKETS && ids[bucket] != RECIPE_ID_NONE; probe++) {
+        if (ids[bucket] == id) {
+            return slots[bucket];
+        }
+        bucket = (bucket + 1) % BUCKETS;
+    }
+    return -1;
+}
+
+int find_preset(recipe_id_t id) {
+    return preset_index.find(id);
+}
 
-    Serial.print("Ingredient ");
-    Serial.print(ingredient.name);
-    Serial.print(": Required = ");
-    Serial.print(required);
-    Serial.print(" ml, Available = ");
-    Serial.print(available);
-    Serial.println(" ml");
+recipe_id_t next_recipe_id() {
+    // IDs stay unique across the whole library and are never reused: a
+    // deleted recipe's stats must not pass to a new one.
+    recipe_id_t highest = RECIPE_ID_NONE;
+    for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+        if (preset_cocktails[i].id <= RECIPE_ID_MAX_PRESET) {
+            highest = max(highest, preset_cocktails[i].id);
+        }
+    }
+    return recipe_store_take_id(highest);
+}
+
+bool assign_missing_recipe_ids() {
+    bool assigned = false;
+    for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+        Cocktail& preset = preset_cocktails[i];
+        bool duplicate = false;
+        for (int j = 0; j < i && !duplicate; j++) {
+            duplicate = preset.id != RECIPE_ID_NONE && preset_cocktails[j].id == preset.id;
+        }
+        if (preset.name[0] != '\0' && (preset.id == RECIPE_ID_NONE || preset.id > RECIPE_ID_MAX_PRESET || duplicate)) {
+            preset.id = next_recipe_id();
+            if (preset.id == RECIPE_ID_NONE) {
+                Serial.printf("No recipe IDs left, dropping %s\n", preset.name);
+                preset = make_cocktail("");
+            }
+            assigned = true;
+        }
+    }
+    return assigned;
+}
+
+void update_recipe_index() {
+    // The old index still maps each ID to its previous slot, which is also
+    // where its order count lives.
+    RecipeOrderCount previous[PRESET_COCKTAIL_COUNT];
+    int old_slots[PRESET_COCKTAIL_COUNT];
+    memcpy(previous, stats.preset_order_counts, sizeof(previous));
+    for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+        recipe_id_t id = preset_cocktails[i].id;
+        int old_slot = preset_index.find(id);
+        bool carried = old_slot >= 0 && previous[old_slot].id == id;
+        old_slots[i] = carried ? old_slot : -1;
+        stats.preset_order_counts[i] = { id, carried ? previous[old_slot].count : 0 };
+    }
+
+    preset_index.clear();
+    for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+        preset_index.insert(preset_cocktails[i].id, i);
+    }
+    availability_rebuild();
+    popularity_presets_moved(old_slots);
+}
+
+void update_ingredient_amount(int ingredient_index, int32_t poured_mg) {
+    Ingredient& ingredient = ingredients[ingredient_index];
+    volume_ul_t poured_ul = mg_to_ul(ingredient, max((int32_t)0, poured_mg));
+    // A bottle holding more than counted stops at 0 rather than going negative.
+    ingredient.amount_left_ul = max((volume_ul_t)0, ingredient.amount_left_ul - poured_ul);
+    availability_ingredient_changed(ingredient_index);
+    float poured_ml = (float)poured_ul / UL_PER_ML;
+    history_add_poured(ingredient_index, poured_ml);
+    forecast_consumed(ingredient_index, poured_ml);
+    mark_ingredients_dirty();
+}
 
-    if (required != 0 && required > available - MINIMUM_INGREDIENT_AMOUNT_THRESHOLD) {
-        Serial.println(" -> Not enough available.");
-        return false;
+void set_cocktail_size(CocktailSize size) {
+    if (size == chosen_cocktail_size) return;
+    chosen_cocktail_size = size;
+    availability_size_changed();
+}
+
+// Presets use the cached availability in availability.h; this direct check
+// is for cocktails built on the fly (custom, random).
+bool isCocktailAvailable(const Cocktail& cocktail) {
+    for (int ingredientIndex = 0; ingredientIndex < INGREDIENT_COUNT; ingredientIndex++) {
+        if (!isIngredientAvailable(ingredients[ingredientIndex], cocktail.amounts[ingredientIndex])) {
+            return false;
+        }
     }
     return true;
 }
 
-bool isCocktailEmpty(Cocktail cocktail) {
+bool isIngredientAvailable(const Ingredient& ingredient, int required_ml) {
+    return required_ml == 0 || required_ml <= stock_ml(ingredient) - MINIMUM_INGREDIENT_AMOUNT_THRESHOLD;
+}
+
+bool isCocktailEmpty(const Cocktail& cocktail) {
     for (int ingredient = 0; ingredient < INGREDIENT_COUNT; ingredient++) {
         if (cocktail.amounts[ingredient] != 0) {
             return false;
@@ -79,9 +192,9 @@ void log_cocktail(const Cocktail& cocktail) {
 Cocktail get_random_cocktail() {
     Serial.println("Generating random cocktail");
     int capacity_left = MAX_COCKTAIL_DRINK_AMOUNT;
-    Cocktail random_cocktail = { RANDOM_COCKTAIL_NAME, { 0, 0, 0, 0 } };
+    Cocktail random_cocktail = make_cocktail(RANDOM_COCKTAIL_NAME, RECIPE_ID_RANDOM);
     for (int i = 0; i < INGREDIENT_COUNT - 1; i++) {
-        int curr_ingredient_amount = random(0, min((int)ingredients[i].amount_left, capacity_left));
+        int curr_ingredient_amount = random(0, min(stock_ml(ingredients[i]), capacity_left));
         Serial.print(" Ingredient ");
         Serial.print(ingredients[i].name);
         Serial.print(": ");
@@ -96,30 +209,19 @@ Cocktail get_random_cocktail() {
     Serial.print(": ");
     Serial.print(capacity_left);
     Serial.println(" ml");
-    random_cocktail.amounts[last] = min(capacity_left, (int)ingredients[last].amount_left);
+    random_cocktail.amounts[last] = min(capacity_left, stock_ml(ingredients[last]));
     return random_cocktail;
 }
 
 void deselect_preset_cocktail() {
-    current_preset_cocktail.name = UNSELECTED_COCKTAIL_NAME;
-    int zero_amounts[INGREDIENT_COUNT] = { 0 };
-    memcpy(current_preset_cocktail.amounts, zero_amounts, sizeof(zero_amounts));
-    ordered_cocktail = current_preset_cocktail;
-}
-
-void reset_stats_if_replaced(const Cocktail old_presets[], const Cocktail new_presets[], Stats& stats) {
-    for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
-        if (old_presets[i].name != new_presets[i].name) {
-            stats.preset_cocktail_order_counts[i] = 0;
-        }
-    }
+    selected_preset_id = RECIPE_ID_NONE;
+    ordered_cocktail = make_cocktail(UNSELECTED_COCKTAIL_NAME);
 }
 
-void update_stats_on_drink_order(Cocktail cocktail, OrderState state) {
-    const String& name = cocktail.name;
-    Serial.println("Updating stats for "+name);
+void update_stats_on_drink_order(const Cocktail& cocktail, OrderState state) {
+    Serial.printf("Updating stats for %s (id %u)\n", cocktail.name, cocktail.id);
 
-    if (name == UNSELECTED_COCKTAIL_NAME) {
+    if (cocktail.id == RECIPE_ID_NONE) {
         return;  // Ignore unselected
     }
 
@@ -133,14 +235,18 @@ void update_stats_on_drink_order(Cocktail cocktail, OrderState state) {
         case Timeout:
             stats.orders_timed_out++;
             break;
+        case Aborted:
+            stats.orders_aborted++;
+            break;
     }
+    mark_stats_dirty();
 
-    if (name == CUSTOM_COCKTAIL_NAME) {
+    if (cocktail.id == RECIPE_ID_CUSTOM) {
         stats.custom_drink_orders++;
         return;
     }
 
-    if (name == RANDOM_COCKTAIL_NAME) {
+    if (cocktail.id == RECIPE_ID_RANDOM) {
         stats.random_drink_orders++;
         return;
     }
@@ -148,35 +254,9 @@ void update_stats_on_drink_order(Cocktail cocktail, OrderState state) {
     // Assume anything else (except unselected/custom) is preset
     stats.preset_drink_orders++;
 
-    // Increment preset cocktail count by index
-    for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
-        if (preset_cocktails[i].name == name) {
-            stats.preset_cocktail_order_counts[i]++;
-            return;
-        }
-    }
-}
-
-
-void update_top_ordered_cocktails() {
-    // Pair each index with its order count
-    std::pair<int, int> index_count[PRESET_COCKTAIL_COUNT];
-    for (int i = 0; i < PRESET_COCKTAIL_COUNT; ++i) {
-        index_count[i] = { i, stats.preset_cocktail_order_counts[i] };
-    }
-
-    // Sort by count descending
-    std::sort(index_count, index_count + PRESET_COCKTAIL_COUNT,
-              [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
-                  return a.second > b.second;
-              });
-
-    Serial.println("Top ordered cocktails:");
-    for (int i = 0; i < 3; ++i) {
-        int idx = index_count[i].first;
-        int count = index_count[i].second;
-        top_cocktails[i] = preset_cocktails[idx];
-
-        Serial.printf("  %d. %s - %d orders\n", i + 1, preset_cocktails[idx].name.c_str(), count);
+    int slot = find_preset(cocktail.id);
+    if (slot >= 0) {
+        stats.preset_order_counts[slot].count++;
+        popularity_record_order(slot, millis());
     }
 }
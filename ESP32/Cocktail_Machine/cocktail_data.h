@@ -3,6 +3,8 @@
 
 #include <TFT_eSPI.h>
 #include <map>
+#include <type_traits>
+#include "machine_config.h"
 
 enum Mode {
   Normal,
@@ -19,27 +21,103 @@ enum CocktailSize {
 enum OrderState {
   Completed,
   Cancelled,
-  Timeout
+  Timeout,
+  Aborted     // stopped by the pour safety checks
 };
 
-const int INGREDIENT_COUNT = 4;
-const int PRESET_COCKTAIL_COUNT = 9;
+const int INGREDIENT_COUNT = Machine::pump_count;
+// Portion multipliers in thousandths, so ml * permille gives the microlitres to pour.
+const int32_t PORTION_PERMILLE[3] = {750, 1000, 1250};
+const int PRESET_COCKTAIL_COUNT = Machine::preset_slots;
 const int MAX_COCKTAIL_DRINK_AMOUNT = 100;
-const int POPULAR_DRINK_COUNT = 3;
-extern const String UNSELECTED_COCKTAIL_NAME;
-const String RANDOM_COCKTAIL_NAME = "Random Cocktail";
-const int TOP_COCKTAIL_COUNT = 3;
-const float MINIMUM_INGREDIENT_AMOUNT_THRESHOLD = 10;
+const char UNSELECTED_COCKTAIL_NAME[] = "UNSELECTED";
+const char RANDOM_COCKTAIL_NAME[] = "Random Cocktail";
+const char CUSTOM_COCKTAIL_NAME[] = "Custom Cocktail";
+// Presets carry a stable ID assigned when they are created, so stats and
+// selection survive renaming and reordering. 0 and the top values are reserved.
+typedef uint16_t recipe_id_t;
+const recipe_id_t RECIPE_ID_NONE = 0;
+const recipe_id_t RECIPE_ID_RANDOM = 0xFFFE;
+const recipe_id_t RECIPE_ID_CUSTOM = 0xFFFF;
+const recipe_id_t RECIPE_ID_MAX_PRESET = 0xFFFD;
+// Name buffers in bytes, terminator included. Longer UTF-8 names are cut at a
+// character boundary.
+const int COCKTAIL_NAME_CAPACITY = 32;
+const int INGREDIENT_NAME_CAPACITY = 24;
+const int TOP_COCKTAIL_COUNT = PRESET_COCKTAIL_COUNT < 3 ? PRESET_COCKTAIL_COUNT : 3;
+// Millilitres an ingredient must keep in its bottle.
+const int MINIMUM_INGREDIENT_AMOUNT_THRESHOLD = 10;
 
+// Stock is counted in whole microlitres. The scale reports whole milligrams,
+// which the ingredient's density turns into microlitres when a pour is
+// booked, so the stock never drifts from the sum of what was poured.
+typedef int32_t volume_ul_t;
+const volume_ul_t UL_PER_ML = 1000;
+// Density in mg per ml: 1000 for water and most spirits and mixers, about
+// 1300 for syrups, 950 for strong spirits.
+const uint16_t WATER_MG_PER_ML = 1000;
+const uint16_t MIN_DENSITY_MG_PER_ML = 500;
+const uint16_t MAX_DENSITY_MG_PER_ML = 2000;
+
+// Names are stored inline so both structs are trivially copyable: passing or
+// assigning them is a memcpy and never touches the heap.
 struct Cocktail {
-  String name;
+  recipe_id_t id;
+  char name[COCKTAIL_NAME_CAPACITY];
   int amounts[INGREDIENT_COUNT];
 };
 
 struct Ingredient {
-  String name;
+  char name[INGREDIENT_NAME_CAPACITY];
   uint16_t color;
-  float amount_left;
+  volume_ul_t amount_left_ul;
+  uint16_t density_mg_per_ml = WATER_MG_PER_ML;
+};
+
+static_assert(std::is_trivially_copyable<Cocktail>::value, "Cocktail must stay trivially copyable");
+static_assert(std::is_trivially_copyable<Ingredient>::value, "Ingredient must stay trivially copyable");
+
+/*
+Copies a NUL-terminated UTF-8 name into a buffer of `capacity` bytes,
+truncating at a character boundary if it does not fit.
+*/
+void copy_name(char* dest, size_t capacity, const char* src);
+
+template <size_t N>
+inline void set_name(char (&dest)[N], const char* src) {
+  copy_name(dest, N, src ? src : "");
+}
+
+inline bool same_name(const char* a, const char* b) {
+  return strcmp(a, b) == 0;
+}
+
+/*
+Returns a cocktail with the given name and ID and no ingredients.
+*/
+Cocktail make_cocktail(const char* name, recipe_id_t id = RECIPE_ID_NONE);
+
+/*
+Open-addressing map from recipe ID to a slot in a fixed array. Lookups are
+O(1); it is rebuilt whenever the presets change.
+*/
+class RecipeIdIndex {
+public:
+  void clear();
+  void insert(recipe_id_t id, int slot);
+  // Returns the slot of `id`, or -1.
+  int find(recipe_id_t id) const;
+private:
+  // Power of two, at least twice PRESET_COCKTAIL_COUNT.
+  static const int BUCKET_BITS = PRESET_COCKTAIL_COUNT <= 8 ? 4 : 5;
+  static const int BUCKETS = 1 << BUCKET_BITS;
+  recipe_id_t ids[BUCKETS] = {};
+  int8_t slots[BUCKETS] = {};
+};
+
+struct RecipeOrderCount {
+  recipe_id_t id;
+  int count;
 };
 
 struct Stats {
@@ -48,30 +126,88 @@ struct Stats {
   int preset_drink_orders = 0;
   int orders_timed_out = 0;
   int orders_cancelled = 0;
+  int orders_aborted = 0;
   int custom_drink_orders = 0;
-  int preset_cocktail_order_counts[PRESET_COCKTAIL_COUNT] = {0};
+  // Entry i belongs to preset_cocktails[i]; the ID keeps it attached to its
+  // recipe when the presets are reordered.
+  RecipeOrderCount preset_order_counts[PRESET_COCKTAIL_COUNT] = {};
 };
 
 extern Stats stats;
 
 extern Cocktail preset_cocktails[];
 extern Ingredient ingredients[];
-extern Cocktail top_cocktails[];
 
 extern Cocktail current_custom_cocktail;
-extern Cocktail current_preset_cocktail;
+extern recipe_id_t selected_preset_id;
 extern Cocktail ordered_cocktail;
 extern bool order_pending;
 extern CocktailSize chosen_cocktail_size; 
 
-void update_ingredient_amount(int ingredient_index, float amount_poured);
-bool isCocktailAvailable(Cocktail cocktail);
-bool isIngredientAvailable(Ingredient ingredient ,float required);
-bool isCocktailEmpty(Cocktail cocktail);
+inline volume_ul_t ml_to_ul(float ml) {
+  return ml > 0 ? (volume_ul_t)lroundf(ml * UL_PER_ML) : 0;
+}
+
+// Milligrams of `ingredient` in `ul`, and back, rounded to the nearest.
+inline int32_t ul_to_mg(const Ingredient& ingredient, int32_t ul) {
+  return (int32_t)(((int64_t)ul * ingredient.density_mg_per_ml + UL_PER_ML / 2) / UL_PER_ML);
+}
+
+inline volume_ul_t mg_to_ul(const Ingredient& ingredient, int32_t mg) {
+  int32_t density = ingredient.density_mg_per_ml;
+  return (volume_ul_t)(((int64_t)mg * UL_PER_ML + density / 2) / density);
+}
+
+inline uint16_t valid_density(long mg_per_ml) {
+  return mg_per_ml >= MIN_DENSITY_MG_PER_ML && mg_per_ml <= MAX_DENSITY_MG_PER_ML ? (uint16_t)mg_per_ml
+                                                                                   : WATER_MG_PER_ML;
+}
+
+// Whole millilitres left, rounded down.
+inline int stock_ml(const Ingredient& ingredient) {
+  return ingredient.amount_left_ul / UL_PER_ML;
+}
+
+/*
+Takes what the scale measured off the ingredient's stock, converted to ul
+with the ingredient's density. Negative readings are noise and count as
+nothing poured.
+*/
+void update_ingredient_amount(int ingredient_index, int32_t poured_mg);
+
+/*
+Changes the portion size and rechecks which presets are available.
+*/
+void set_cocktail_size(CocktailSize size);
+bool isCocktailAvailable(const Cocktail& cocktail);
+bool isIngredientAvailable(const Ingredient& ingredient, int required_ml);
+bool isCocktailEmpty(const Cocktail& cocktail);
 void log_cocktail(const Cocktail& cocktail);
 Cocktail get_random_cocktail();
 void deselect_preset_cocktail();
-void reset_stats_if_replaced(const Cocktail old_presets[], const Cocktail new_presets[], Stats& stats);
-void update_stats_on_drink_order(Cocktail cocktail, OrderState state);
-void update_top_ordered_cocktails();
+
+/*
+Slot of the preset with this ID in preset_cocktails, or -1.
+*/
+int find_preset(recipe_id_t id);
+
+/*
+A fresh recipe ID: above every recipe on the loaded page and every ID the
+library ever handed out. RECIPE_ID_NONE once all IDs are used up.
+*/
+recipe_id_t next_recipe_id();
+
+/*
+Gives every named preset without an ID (e.g. from an older cocktails.json)
+a fresh one. Returns true if any ID was assigned and the presets need saving.
+*/
+bool assign_missing_recipe_ids();
+
+/*
+Call after preset_cocktails changed: moves each recipe's order count to its
+new slot (dropping counts of removed recipes), rebuilds the ID index and
+the availability cache, and keeps popularity scores with their recipes.
+*/
+void update_recipe_index();
+void update_stats_on_drink_order(const Cocktail& cocktail, OrderState state);
 #endif
@@ -0,0 +1,136 @@
+#include "cup_detector.h"
+
+void cup_detector_reset(CupDetector& detector, weight_mg_t baseline, unsigned long sample_period_ms) {
+  detector = CupDetector();
+  detector.baseline = baseline;
+  int samples = sample_period_ms > 0 ? (int)((CUP_CONFIRM_WINDOW_MS + sample_period_ms - 1) / sample_period_ms) : CUP_WINDOW_MIN_SAMPLES;
+  detector.window_samples = constrain(samples, CUP_WINDOW_MIN_SAMPLES, CUP_WINDOW_MAX_SAMPLES);
+}
+
+static void start_idle(CupDetector& detector) {
+  detector.state = Cup_Idle;
+  detector.window_count = 0;
+  detector.window_next = 0;
+  detector.optical_overruled = false;
+  detector.still_since_ms = 0;
+}
+
+static bool window_is_steady(const CupDetector& detector, weight_mg_t& mean,
+                             weight_mg_t max_stddev = CUP_STABLE_STDDEV_MG) {
+  int64_t sum = 0;
+  for (int i = 0; i < detector.window_count; i++) {
+    sum += detector.window[i];
+  }
+  mean = (weight_mg_t)(sum / detector.window_count);
+
+  int64_t square_sum = 0;
+  for (int i = 0; i < detector.window_count; i++) {
+    int64_t diff = detector.window[i] - mean;
+    square_sum += diff * diff;
+  }
+  int64_t variance = square_sum / detector.window_count;
+  return variance <= (int64_t)max_stddev * max_stddev;
+}
+
+static bool recent_samples_agree(const CupDetector& detector, weight_mg_t& mean) {
+  weight_mg_t low = 0;
+  weight_mg_t high = 0;
+  int64_t sum = 0;
+  for (int k = 0; k < CUP_FAST_CONFIRM_SAMPLES; k++) {
+    int index = (detector.window_next - 1 - k + detector.window_samples) % detector.window_samples;
+    weight_mg_t value = detector.window[index];
+    low = k == 0 ? value : min(low, value);
+    high = k == 0 ? value : max(high, value);
+    sum += value;
+  }
+  mean = (weight_mg_t)(sum / CUP_FAST_CONFIRM_SAMPLES);
+  return high - low <= CUP_FAST_SPREAD_MG;
+}
+
+static CupDetectorState confirm(CupDetector& detector, weight_mg_t mean, unsigned long now_ms) {
+  detector.state = Cup_Confirmed;
+  detector.cup_weight = mean - detector.baseline;
+  detector.decision_latency_ms = now_ms - detector.step_time_ms;
+  return detector.state;
+}
+
+CupDetectorState cup_detector_feed(CupDetector& detector, weight_mg_t sample, unsigned long now_ms, OpticalState optical) {
+  if (detector.state == Cup_Confirmed) {
+    return detector.state;
+  }
+
+  weight_mg_t delta = sample - detector.baseline;
+
+  if (delta < CUP_STEP_THRESHOLD_MG) {
+    bool calm = detector.last_step_ms == 0 || now_ms - detector.last_step_ms >= CUP_BASELINE_CALM_MS;
+    if (detector.state == Cup_Settling) {
+      // Load went away again: a bump, a touch or a cup that was lifted.
+      detector.rejected_steps++;
+      start_idle(detector);
+    }
+    // Follow slow drift of the empty platform.
+    if (calm) {
+      detector.baseline += (delta * CUP_BASELINE_FOLLOW_WEIGHT) / 256;
+    }
+    return detector.state;
+  }
+
+  detector.last_step_ms = now_ms;
+  if (detector.state == Cup_Idle) {
+    detector.state = Cup_Settling;
+    detector.step_time_ms = now_ms;
+    detector.settle_since_ms = now_ms;
+  }
+
+  if (optical == Optical_Clear && !detector.optical_overruled) {
+    // Load on the platform but nothing over the cup position: a hand, or a
+    // clear glass. Past the timeout, weight and stillness tell them apart.
+    detector.window_count = 0;
+    detector.window_next = 0;
+    if (now_ms - detector.settle_since_ms <= CUP_SETTLE_TIMEOUT_MS) {
+      return detector.state;
+    }
+    detector.optical_overruled = true;
+    detector.settle_since_ms = now_ms;
+  }
+
+  detector.window[detector.window_next] = sample;
+  detector.window_next = (detector.window_next + 1) % detector.window_samples;
+  detector.window_count = min(detector.window_count + 1, detector.window_samples);
+
+  weight_mg_t mean;
+  if (optical == Optical_Covered && detector.window_count >= CUP_FAST_CONFIRM_SAMPLES
+      && recent_samples_agree(detector, mean)) {
+    return confirm(detector, mean, now_ms);
+  }
+
+  if (detector.window_count < detector.window_samples) {
+    return detector.state;
+  }
+
+  if (detector.optical_overruled) {
+    // Only a glass the sensor cannot see gets here; a hand never keeps this
+    // still for long.
+    bool still = window_is_steady(detector, mean, CUP_STILL_STDDEV_MG);
+    if (still && mean - detector.baseline <= CUP_MAX_WEIGHT_MG) {
+      if (detector.still_since_ms == 0) {
+        detector.still_since_ms = now_ms;
+      }
+      if (now_ms - detector.still_since_ms >= CUP_STILL_HOLD_MS) {
+        return confirm(detector, mean, now_ms);
+      }
+      return detector.state;
+    }
+    detector.still_since_ms = 0;
+  } else if (window_is_steady(detector, mean)) {
+    return confirm(detector, mean, now_ms);
+  }
+
+  if (now_ms - detector.settle_since_ms > CUP_SETTLE_TIMEOUT_MS) {
+    // Never settled: whatever is there is not a cup, adopt it as the new baseline.
+    detector.rejected_steps++;
+    detector.baseline = mean;
+    start_idle(detector);
+  }
+  return detector.state;
+}
@@ -0,0 +1,79 @@
+#ifndef CUP_DETECTOR_H
+#define CUP_DETECTOR_H
+
+#include <Arduino.h>
+#include "weight.h"
+#include "cup_presence.h"
+
+// Smallest load step that can be a cup.
+const weight_mg_t CUP_STEP_THRESHOLD_MG = 1200;
+// Largest spread (standard deviation) of the confirmation window. A resting
+// cup is far steadier than a hand or a bumped platform.
+const weight_mg_t CUP_STABLE_STDDEV_MG = 250;
+// How long the load must stay above the step and steady before a cup counts.
+const unsigned long CUP_CONFIRM_WINDOW_MS = 300;
+// After a step, how long to wait for the load to settle before giving up and
+// treating the step as a new baseline (a hand resting on the platform, etc.).
+const unsigned long CUP_SETTLE_TIMEOUT_MS = 3000;
+// A step the light sensor keeps calling clear is a hand or a clear glass,
+// which does not shade the sensor. Past the settle timeout it counts as a
+// glass only if it weighs what a cup can and stays stiller than a hand can
+// hold (physiological tremor moves a resting hand by a gram or so) for
+// CUP_STILL_HOLD_MS.
+const weight_mg_t CUP_MAX_WEIGHT_MG = 800000;
+const weight_mg_t CUP_STILL_STDDEV_MG = 150;
+const unsigned long CUP_STILL_HOLD_MS = 1000;
+const int CUP_WINDOW_MIN_SAMPLES = 3;
+// With the light sensor covered a cup is confirmed as soon as this many
+// consecutive samples agree within the spread below.
+const int CUP_FAST_CONFIRM_SAMPLES = 2;
+const weight_mg_t CUP_FAST_SPREAD_MG = 500;
+const int CUP_WINDOW_MAX_SAMPLES = 32;
+// Weight given to each idle sample when following the empty baseline, in 1/256.
+const int CUP_BASELINE_FOLLOW_WEIGHT = 32;
+// The baseline only follows once no step was seen for this long. Drift is
+// slow; a vibrating platform would otherwise drag it towards the troughs.
+const unsigned long CUP_BASELINE_CALM_MS = 500;
+
+enum CupDetectorState {
+  Cup_Idle,        // no step above the baseline
+  Cup_Settling,    // step seen, waiting for a steady window
+  Cup_Confirmed    // cup on the platform
+};
+
+struct CupDetector {
+  CupDetectorState state = Cup_Idle;
+  weight_mg_t baseline = 0;
+  int window_samples = CUP_WINDOW_MIN_SAMPLES;
+  weight_mg_t window[CUP_WINDOW_MAX_SAMPLES] = {0};
+  int window_count = 0;
+  int window_next = 0;
+  unsigned long step_time_ms = 0;      // first sample above the step
+  unsigned long settle_since_ms = 0;   // start of the current settle timeout
+  unsigned long last_step_ms = 0;      // latest sample above the step
+  unsigned long decision_latency_ms = 0;
+  int rejected_steps = 0;              // bumps, touches and removals seen
+  bool optical_overruled = false;      // a Clear veto timed out, weight and stillness decide
+  unsigned long still_since_ms = 0;    // overruled: start of the current still stretch, 0 if none
+  weight_mg_t cup_weight = 0;          // mean of the confirming window
+};
+
+/*
+Starts detection from an empty-platform baseline. `sample_period_ms` is the
+sensor's current sample period and sizes the confirmation window.
+*/
+void cup_detector_reset(CupDetector& detector, weight_mg_t baseline, unsigned long sample_period_ms);
+
+/*
+Feeds one sample and returns the new state. Once Cup_Confirmed is returned,
+decision_latency_ms holds the time from the step to the decision.
+
+`optical` fuses the light sensor under the cup position: Covered confirms a
+steady step after CUP_FAST_CONFIRM_SAMPLES, Clear holds the step back (a hand
+on the platform) for CUP_SETTLE_TIMEOUT_MS and then only lets a still load
+of cup weight through, Unknown uses the weight-only window.
+*/
+CupDetectorState cup_detector_feed(CupDetector& detector, weight_mg_t sample, unsigned long now_ms,
+                                   OpticalState optical = Optical_Unknown);
+
+#endif
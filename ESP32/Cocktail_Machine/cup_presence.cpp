@@ -0,0 +1,101 @@
+#include "cup_presence.h"
+
+static CupPresenceSensor* presence_sensor = nullptr;
+static OpticalState optical_state = Optical_Unknown;
+static int32_t open_level = 0;
+static unsigned long crossed_since_ms = 0;
+static bool crossing = false;
+static int32_t learn_sum = 0;
+static int learn_readings = 0;
+
+#ifdef ARDUINO
+static volatile bool adc_results_ready = false;
+
+static void IRAM_ATTR on_adc_results() {
+  adc_results_ready = true;
+}
+
+bool AdcCupPresenceSensor::begin() {
+  uint8_t pins[] = { pin };
+  if (!analogContinuous(pins, 1, LIGHT_SENSOR_CONVERSIONS_PER_READ, LIGHT_SENSOR_SAMPLE_HZ, &on_adc_results)) {
+    return false;
+  }
+  return analogContinuousStart();
+}
+
+bool AdcCupPresenceSensor::read_level(uint16_t& level) {
+  if (!adc_results_ready) {
+    return false;
+  }
+  adc_results_ready = false;
+  adc_continuous_result_t* result = nullptr;
+  if (!analogContinuousRead(&result, 0) || result == nullptr) {
+    return false;
+  }
+  level = (uint16_t)result[0].avg_read_raw;
+  return true;
+}
+#endif
+
+bool cup_presence_setup(CupPresenceSensor* sensor) {
+  presence_sensor = sensor;
+  optical_state = Optical_Unknown;
+  open_level = 0;
+  learn_sum = 0;
+  learn_readings = 0;
+  crossing = false;
+  if (!sensor || !sensor->begin()) {
+    presence_sensor = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void cup_presence_update(unsigned long now_ms) {
+  uint16_t level;
+  if (!presence_sensor || !presence_sensor->read_level(level)) {
+    return;
+  }
+
+  if (optical_state == Optical_Unknown) {
+    // Learn the open level, and only once the platform is bright enough to tell.
+    if (level < OPTICAL_MIN_OPEN_LEVEL) {
+      learn_sum = 0;
+      learn_readings = 0;
+      return;
+    }
+    learn_sum += level;
+    if (++learn_readings == OPTICAL_LEARN_READINGS) {
+      open_level = learn_sum / learn_readings;
+      optical_state = Optical_Clear;
+      learn_sum = 0;
+      learn_readings = 0;
+    }
+    return;
+  }
+
+  bool covered_now = level * 100 < open_level * OPTICAL_COVERED_PERCENT;
+  bool clear_now = level * 100 > open_level * OPTICAL_CLEAR_PERCENT;
+  bool wants_change = (optical_state == Optical_Clear && covered_now)
+                      || (optical_state == Optical_Covered && clear_now);
+
+  if (!wants_change) {
+    crossing = false;
+    if (optical_state == Optical_Clear) {
+      open_level += ((int32_t)level - open_level) * OPTICAL_OPEN_FOLLOW_WEIGHT / 256;
+    }
+    return;
+  }
+  if (!crossing) {
+    crossing = true;
+    crossed_since_ms = now_ms;
+  }
+  if (now_ms - crossed_since_ms >= OPTICAL_DEBOUNCE_MS) {
+    optical_state = optical_state == Optical_Clear ? Optical_Covered : Optical_Clear;
+    crossing = false;
+  }
+}
+
+OpticalState cup_presence_state() {
+  return optical_state;
+}
@@ -0,0 +1,95 @@
+#ifndef CUP_PRESENCE_H
+#define CUP_PRESENCE_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#endif
+
+// Photoresistor under the cup position, wired LDR to 3.3V and a resistor to
+// GND: a cup shading it pulls the level down.
+const int LIGHT_SENSOR_PIN = 35; // change
+const uint32_t LIGHT_SENSOR_SAMPLE_HZ = 2000;
+const uint32_t LIGHT_SENSOR_CONVERSIONS_PER_READ = 20;  // averaged, ~10 ms per result
+// Covered below this share of the learned open level, clear again above the
+// second (hysteresis).
+const int OPTICAL_COVERED_PERCENT = 60;
+const int OPTICAL_CLEAR_PERCENT = 80;
+// The level has to stay across the threshold this long to change state.
+const unsigned long OPTICAL_DEBOUNCE_MS = 20;
+// An open level darker than this is treated as a dead or missing sensor.
+const uint16_t OPTICAL_MIN_OPEN_LEVEL = 200;
+// Bright readings averaged to learn the open level, at start and after the
+// sensor went dark.
+const int OPTICAL_LEARN_READINGS = 5;
+// Weight given to each clear reading when following ambient light, in 1/256.
+const int OPTICAL_OPEN_FOLLOW_WEIGHT = 4;
+
+enum OpticalState {
+  Optical_Unknown,   // no sensor, or not enough light to tell
+  Optical_Clear,
+  Optical_Covered
+};
+
+/*
+Source of light levels (0..4095). The firmware uses the ADC implementation;
+host builds and simulations feed levels through the simulated one.
+*/
+class CupPresenceSensor {
+public:
+  virtual ~CupPresenceSensor() {}
+  virtual bool begin() = 0;
+  // Returns false if no new level is available since the last call.
+  virtual bool read_level(uint16_t& level) = 0;
+};
+
+#ifdef ARDUINO
+/*
+Samples the photoresistor with the ESP32 ADC in continuous (DMA) mode, so
+reading a level never waits on a conversion.
+*/
+class AdcCupPresenceSensor : public CupPresenceSensor {
+public:
+  explicit AdcCupPresenceSensor(uint8_t pin) : pin(pin) {}
+  bool begin() override;
+  bool read_level(uint16_t& level) override;
+private:
+  uint8_t pin;
+};
+#endif
+
+class SimulatedCupPresenceSensor : public CupPresenceSensor {
+public:
+  bool begin() override { return true; }
+  bool read_level(uint16_t& out) override {
+    if (!fresh) return false;
+    out = level;
+    fresh = false;
+    return true;
+  }
+  void set_level(uint16_t new_level) {
+    level = new_level;
+    fresh = true;
+  }
+private:
+  uint16_t level = 0;
+  bool fresh = false;
+};
+
+/*
+Starts optical presence sensing on `sensor` and returns false if it does not
+start. The state stays Optical_Unknown (cup detection uses weight only) until
+cup_presence_update() has learnt the open level from the first bright
+readings. Does not block, log or read the clock, so it runs unchanged on a host.
+*/
+bool cup_presence_setup(CupPresenceSensor* sensor);
+
+/*
+Polls the sensor and updates the debounced state. Cheap, call it often.
+*/
+void cup_presence_update(unsigned long now_ms);
+
+OpticalState cup_presence_state();
+
+#endif
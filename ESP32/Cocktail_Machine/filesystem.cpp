@@ -2,6 +2,117 @@
 #include <FS.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
+#include "health.h"
+#include "availability.h"
+#include "recipe_store.h"
+#include "makeable.h"
+#include "alloc_track.h"
+#include "order_history.h"
+#include <esp_system.h>
+
+// Document sizes for the files that list every pump or preset.
+static const size_t INGREDIENTS_JSON_SIZE = json_list_size(INGREDIENT_COUNT, 5, INGREDIENT_NAME_CAPACITY + 40);
+static const size_t COCKTAILS_JSON_SIZE = json_list_size(PRESET_COCKTAIL_COUNT, 4 + INGREDIENT_COUNT, COCKTAIL_NAME_CAPACITY + 32);
+static const size_t STATS_JSON_SIZE = 1024 + json_list_size(PRESET_COCKTAIL_COUNT, 4, 0);
+
+FlashWriteStats flash_write_stats;
+
+// Unsaved changes of one file kept by write-behind.
+struct DirtyState {
+    volatile bool dirty;
+    unsigned long dirty_since;  // first unsaved change
+    unsigned long changed_ms;   // latest change
+};
+
+static DirtyState ingredients_state = {};
+static DirtyState stats_state = {};
+
+FlashWriteTimer::FlashWriteTimer() : started_ms(millis()) {}
+
+FlashWriteTimer::~FlashWriteTimer() {
+    uint32_t elapsed = millis() - started_ms;
+    FlashWriteStats& write_stats = flash_write_stats;
+    write_stats.writes++;
+    write_stats.write_ms += elapsed;
+    if (order_pending) {
+        write_stats.order_writes++;
+        write_stats.order_write_ms += elapsed;
+        write_stats.max_order_write_ms = max(write_stats.max_order_write_ms, elapsed);
+    }
+}
+
+void print_flash_write_stats() {
+    const FlashWriteStats& write_stats = flash_write_stats;
+    uint32_t orders = max(alloc_orders, (uint32_t)1);
+    Serial.printf("Flash: %lu writes in %lu ms; during %lu orders %lu writes in %lu ms (%.1f writes, %.1f ms per order, longest %lu ms)\n",
+                  (unsigned long)write_stats.writes, (unsigned long)write_stats.write_ms, (unsigned long)alloc_orders,
+                  (unsigned long)write_stats.order_writes, (unsigned long)write_stats.order_write_ms,
+                  (float)write_stats.order_writes / orders, (float)write_stats.order_write_ms / orders,
+                  (unsigned long)write_stats.max_order_write_ms);
+}
+
+static void mark_dirty(DirtyState& state) {
+    unsigned long now = millis();
+    if (!state.dirty) {
+        state.dirty_since = now;
+    }
+    state.changed_ms = now;
+    state.dirty = true;
+}
+
+static bool save_ingredients_now() {
+    return save_ingredients(ingredients);
+}
+
+static bool save_stats_now() {
+    return save_stats(stats);
+}
+
+static bool flush_state(DirtyState& state, bool (*save)(), const char* what) {
+    if (!state.dirty) return true;
+    // Cleared first: a change made while saving marks it dirty again.
+    state.dirty = false;
+    if (!save()) {
+        Serial.printf("Saving %s failed, retrying later.\n", what);
+        state.dirty_since = millis();
+        state.dirty = true;
+        return false;
+    }
+    return true;
+}
+
+void mark_ingredients_dirty() {
+    mark_dirty(ingredients_state);
+}
+
+void mark_stats_dirty() {
+    mark_dirty(stats_state);
+}
+
+bool persist_flush() {
+    bool ingredients_saved = flush_state(ingredients_state, save_ingredients_now, "ingredients");
+    bool stats_saved = flush_state(stats_state, save_stats_now, "stats");
+    return ingredients_saved && stats_saved;
+}
+
+void persist_poll(bool idle) {
+    unsigned long now = millis();
+    if (ingredients_state.dirty) {
+        bool quiet = idle && now - ingredients_state.changed_ms >= INGREDIENT_FLUSH_IDLE_MS;
+        bool overdue = now - ingredients_state.dirty_since >= INGREDIENT_FLUSH_MAX_DELAY_MS;
+        if (quiet || overdue) {
+            flush_state(ingredients_state, save_ingredients_now, "ingredients");
+        }
+    }
+    // Stats only change when an order ends, so waiting for idle never starves them.
+    if (stats_state.dirty && idle && now - stats_state.dirty_since >= STATS_FLUSH_INTERVAL_MS) {
+        flush_state(stats_state, save_stats_now, "stats");
+    }
+}
+
+static void persist_on_shutdown() {
+    persist_flush();
+}
 
 bool fs_init() {
     // Initialize the file system
@@ -9,15 +120,8 @@ bool fs_init() {
         return false;
     }
 
-    // Check if the necessary files exist, if not, create them
-    if (!LittleFS.exists("/cocktails.json")) {
-        fs::File file = LittleFS.open("/cocktails.json", "w");
-        if (!file) return false;
-        StaticJsonDocument<2048> document;
-        serializeJson(document, file);
-        file.close();
-    }
-
+    // Check if the necessary files exist, if not, create them. Recipes live
+    // in the recipe library, created by recipe_store_begin().
     if (!LittleFS.exists("/ingredients.json")) {
         fs::File file = LittleFS.open("/ingredients.json", "w");
         if (!file) return false;
@@ -37,27 +141,10 @@ bool fs_init() {
     return true;
 }
 
-bool save_cocktails(const Cocktail cocktails[], size_t count) {
-    if (count > PRESET_COCKTAIL_COUNT) return false;
-    fs::File file = LittleFS.open("/cocktails.json", "w");
-    if (!file) return false;
-    StaticJsonDocument<2048> document;
-    JsonArray cocktailArray = document.to<JsonArray>();
-    for (size_t i = 0; i < count; ++i) {
-        JsonObject cocktailObject = cocktailArray.createNestedObject();
-        cocktailObject["name"] = cocktails[i].name;
-        JsonArray amountsArray = cocktailObject.createNestedArray("amounts");
-        for (int j = 0; j < 4; ++j) amountsArray.add(cocktails[i].amounts[j]);
-    }
-    serializeJson(document, file);
-    file.close();
-    return true;
-}
-
 bool load_cocktails(Cocktail cocktails[], size_t& count) {
     fs::File file = LittleFS.open("/cocktails.json", "r");
     if (!file) return false;
-    StaticJsonDocument<2048> document;
+    StaticJsonDocument<COCKTAILS_JSON_SIZE> document;
     DeserializationError err = deserializeJson(document, file);
     if (err) return false;
     JsonArray cocktailArray = document.as<JsonArray>();
@@ -65,24 +152,28 @@ bool load_cocktails(Cocktail cocktails[], size_t& count) {
     for (JsonObject cocktailObject : cocktailArray) {
         if (count >= PRESET_COCKTAIL_COUNT) break;
         Cocktail& cocktail = cocktails[count++];
-        cocktail.name = cocktailObject["name"].as<String>();
+        cocktail.id = cocktailObject["id"] | RECIPE_ID_NONE;  // older files have none
+        set_name(cocktail.name, cocktailObject["name"] | "");
         JsonArray amountsArray = cocktailObject["amounts"];
-        for (int j = 0; j < 4; ++j) cocktail.amounts[j] = amountsArray[j];
+        for (int j = 0; j < INGREDIENT_COUNT; ++j) cocktail.amounts[j] = amountsArray[j];
     }
     file.close();
     return true;
 }
 
 bool save_ingredients(const Ingredient ingredients[INGREDIENT_COUNT]) {
+    AllocScopeGuard alloc_scope(Alloc_Storage);
+    FlashWriteTimer write_timer;
     fs::File file = LittleFS.open("/ingredients.json", "w");
     if (!file) return false;
-    StaticJsonDocument<1024> document;
+    StaticJsonDocument<INGREDIENTS_JSON_SIZE> document;
     JsonArray ingredientArray = document.to<JsonArray>();
     for (int i = 0; i < INGREDIENT_COUNT; ++i) {
         JsonObject ingredientObject = ingredientArray.createNestedObject();
         ingredientObject["name"] = ingredients[i].name;
         ingredientObject["color"] = ingredients[i].color;
-        ingredientObject["amount_left"] = ingredients[i].amount_left;
+        ingredientObject["amount_ul"] = ingredients[i].amount_left_ul;
+        ingredientObject["density"] = ingredients[i].density_mg_per_ml;
     }
     serializeJson(document, file);
     file.close();
@@ -93,26 +184,34 @@ bool save_ingredients(const Ingredient ingredients[INGREDIENT_COUNT]) {
 bool load_ingredients(Ingredient ingredients[INGREDIENT_COUNT]) {
     fs::File file = LittleFS.open("/ingredients.json", "r");
     if (!file) return false;
-    StaticJsonDocument<1024> document;
+    StaticJsonDocument<INGREDIENTS_JSON_SIZE> document;
     DeserializationError err = deserializeJson(document, file);
     if (err) return false;
     JsonArray ingredientArray = document.as<JsonArray>();
     int i = 0;
     for (JsonObject ingredientObject : ingredientArray) {
         if (i >= INGREDIENT_COUNT) break;
-        ingredients[i].name = ingredientObject["name"].as<String>();
+        set_name(ingredients[i].name, ingredientObject["name"] | "");
         ingredients[i].color = ingredientObject["color"];
-        ingredients[i].amount_left = ingredientObject["amount_left"] | 0.0f;
+        // Files from before integer stock hold float millilitres.
+        if (ingredientObject.containsKey("amount_ul")) {
+            ingredients[i].amount_left_ul = ingredientObject["amount_ul"];
+        } else {
+            ingredients[i].amount_left_ul = ml_to_ul(ingredientObject["amount_left"] | 0.0f);
+        }
+        ingredients[i].density_mg_per_ml = valid_density(ingredientObject["density"] | (long)WATER_MG_PER_ML);
         ++i;
     }
     file.close();
     return true;
 }
 bool save_stats(const Stats& stats) {
+    AllocScopeGuard alloc_scope(Alloc_Storage);
+    FlashWriteTimer write_timer;
     fs::File file = LittleFS.open("/stats.json", "w");
     if (!file) return false;
 
-    StaticJsonDocument<2048> document;
+    StaticJsonDocument<STATS_JSON_SIZE> document;
     JsonObject rootObject = document.to<JsonObject>();
 
     // Save individual counters
@@ -121,12 +220,16 @@ bool save_stats(const Stats& stats) {
     rootObject["preset_drink_orders"] = stats.preset_drink_orders;
     rootObject["orders_timed_out"] = stats.orders_timed_out;
     rootObject["orders_cancelled"] = stats.orders_cancelled;
+    rootObject["orders_aborted"] = stats.orders_aborted;
     rootObject["custom_drink_orders"] = stats.custom_drink_orders;
 
-    // Save preset cocktail order counts as an array
-    JsonArray cocktailCounts = rootObject.createNestedArray("preset_cocktail_order_counts");
+    // Save preset order counts keyed by recipe ID
+    JsonArray recipeCounts = rootObject.createNestedArray("recipe_order_counts");
     for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
-        cocktailCounts.add(stats.preset_cocktail_order_counts[i]);
+        if (stats.preset_order_counts[i].id == RECIPE_ID_NONE) continue;
+        JsonObject entry = recipeCounts.createNestedObject();
+        entry["id"] = stats.preset_order_counts[i].id;
+        entry["count"] = stats.preset_order_counts[i].count;
     }
 
     serializeJson(document, file);
@@ -138,7 +241,7 @@ bool load_stats(Stats& stats) {
     fs::File file = LittleFS.open("/stats.json", "r");
     if (!file) return false;
 
-    StaticJsonDocument<2048> document;
+    StaticJsonDocument<STATS_JSON_SIZE> document;
     DeserializationError err = deserializeJson(document, file);
     if (err) {
         file.close();
@@ -151,15 +254,22 @@ bool load_stats(Stats& stats) {
     stats.preset_drink_orders = document["preset_drink_orders"] | 0;
     stats.orders_timed_out = document["orders_timed_out"] | 0;
     stats.orders_cancelled = document["orders_cancelled"] | 0;
+    stats.orders_aborted = document["orders_aborted"] | 0;
     stats.custom_drink_orders = document["custom_drink_orders"] | 0;
 
-    // Load preset cocktail order counts
-    JsonArray cocktailCounts = document["preset_cocktail_order_counts"];
+    // Load preset order counts, matched to the presets by recipe ID. Must run
+    // after the presets are loaded. The recipe library also keeps a count per
+    // recipe, written when the page changes; counts only grow, so the larger
+    // of the two is the more recent one.
     for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
-        if (i < cocktailCounts.size()) {
-            stats.preset_cocktail_order_counts[i] = cocktailCounts[i] | 0;
-        } else {
-            stats.preset_cocktail_order_counts[i] = 0;
+        stats.preset_order_counts[i].id = preset_cocktails[i].id;
+    }
+    JsonArray recipeCounts = document["recipe_order_counts"];
+    for (JsonObject entry : recipeCounts) {
+        int slot = find_preset(entry["id"] | RECIPE_ID_NONE);
+        if (slot >= 0) {
+            RecipeOrderCount& count = stats.preset_order_counts[slot];
+            count.count = max(count.count, entry["count"] | 0);
         }
     }
 
@@ -167,20 +277,95 @@ bool load_stats(Stats& stats) {
     return true;
 }
 
+bool save_calibration(const ScaleCalibration& calibration) {
+    AllocScopeGuard alloc_scope(Alloc_Storage);
+    FlashWriteTimer write_timer;
+    fs::File file = LittleFS.open("/calibration.json", "w");
+    if (!file) return false;
+
+    StaticJsonDocument<128> document;
+    document["offset"] = calibration.offset;
+    document["counts_per_kg"] = calibration.counts_per_kg;
+
+    serializeJson(document, file);
+    file.close();
+    return true;
+}
+
+bool load_calibration(ScaleCalibration& calibration) {
+    if (!LittleFS.exists("/calibration.json")) return false;
+    fs::File file = LittleFS.open("/calibration.json", "r");
+    if (!file) return false;
+
+    StaticJsonDocument<128> document;
+    DeserializationError err = deserializeJson(document, file);
+    file.close();
+    if (err) return false;
+
+    int32_t counts_per_kg = document["counts_per_kg"] | 0;
+    if (counts_per_kg == 0) return false;
+    calibration.offset = document["offset"] | 0;
+    calibration.counts_per_kg = counts_per_kg;
+    return true;
+}
+
 void setup_data() {
-    while (!fs_init()) {
-        Serial.println("Filesystem ran into issue.");
+    health_step_begin(Subsystem_Storage);
+    bool mounted = false;
+    for (int attempt = 1; attempt <= FS_INIT_ATTEMPTS && !mounted; attempt++) {
+        mounted = fs_init();
+        if (!mounted) {
+            Serial.printf("Filesystem ran into issue (attempt %d/%d).\n", attempt, FS_INIT_ATTEMPTS);
+        }
     }
-
+    if (!mounted) {
+        // Nothing can be loaded or saved: run with empty menus until reboot.
+        health_step_end(Subsystem_Storage, Health_Failed, "mount failed");
+        health_step_begin(Subsystem_Recipes);
+        health_step_end(Subsystem_Recipes, Health_Failed, "no storage");
+        return;
+    }
+    health_step_end(Subsystem_Storage, Health_Ok);
     Serial.println("Filesystem initialized");
-    size_t count = 0;
-    while (!load_cocktails(preset_cocktails, count)) {
-        Serial.println("Loading preset cocktails ran into issue.");
+    esp_register_shutdown_handler(persist_on_shutdown);
+
+    if (!history_begin()) {
+        Serial.println("Order history could not be opened, orders are not recorded.");
+    }
+
+    health_step_begin(Subsystem_Recipes);
+    bool cocktails_loaded = false;
+    for (int attempt = 1; attempt <= DATA_LOAD_ATTEMPTS && !cocktails_loaded; attempt++) {
+        cocktails_loaded = recipe_store_begin();
+        if (!cocktails_loaded) {
+            Serial.println("Loading recipe library ran into issue.");
+        }
+    }
+    Serial.println("Recipe library holds " + String(recipe_store_count()) + " slots");
+
+    bool ingredients_loaded = false;
+    for (int attempt = 1; attempt <= DATA_LOAD_ATTEMPTS && !ingredients_loaded; attempt++) {
+        ingredients_loaded = load_ingredients(ingredients);
+        if (!ingredients_loaded) {
+            Serial.println("Loading ingredients ran into issue.");
+        }
+    }
+    if (ingredients_loaded) {
+        Serial.println("Loaded preset ingredients");
+    }
+    availability_rebuild();
+    makeable_rebuild();
+
+    if (load_stats(stats)) {
+        Serial.printf("Loaded stats: %d orders completed\n", stats.orders_completed);
+    } else {
+        Serial.println("Stats unreadable, counting from zero.");
     }
-    Serial.println("Loaded " + String(count) + " preset cocktails");
 
-    while (!load_ingredients(ingredients)) {
-        Serial.println("Loading ingredients ran into issue.");
+    if (cocktails_loaded && ingredients_loaded) {
+        health_step_end(Subsystem_Recipes, Health_Ok);
+    } else {
+        health_step_end(Subsystem_Recipes, Health_Degraded,
+                        !cocktails_loaded ? "cocktails unreadable" : "ingredients unreadable");
     }
-    Serial.println("Loaded preset ingredients");
 }
@@ -3,25 +3,20 @@
 
 #include <Arduino.h>
 #include "cocktail_data.h"
+#include "weight.h"
 #include <map>
 
 // Setup
 // Initializes the filesystem and ensures necessary files are created.
 // Purpose: To set up the filesystem and create required files if they don't exist.
+// Gives up after a few attempts and records the outcome in the health table,
+// so a broken flash leaves the machine running with empty menus.
 void setup_data();
 
 // Cocktails
 /**
- * Saves the cocktail list to the filesystem.
- * 
- * @param cocktails Array of Cocktail objects to save.
- * @param count Number of cocktails in the array.
- * @return true if save is successful, false if an error occurs.
- */
-bool save_cocktails(const Cocktail cocktails[], size_t count);
-
-/**
- * Loads the cocktail list from the filesystem.
+ * Loads the cocktail list from cocktails.json, the format used before the
+ * recipe library (recipe_store.h). Only read once, to import it.
  * 
  * @param cocktails Array of Cocktail objects to load data into.
  * @param count A reference to a size_t that will hold the number of loaded cocktails.
@@ -46,6 +41,68 @@ bool save_ingredients(const Ingredient ingredients[INGREDIENT_COUNT]);
  */
 bool load_ingredients(Ingredient ingredients[INGREDIENT_COUNT]);
 
+// Write-behind for the ingredient stock: pours only mark it dirty, and
+// loop() writes it once the machine is idle, so the pour loop never waits on
+// flash. At most INGREDIENT_FLUSH_MAX_DELAY_MS of stock changes made outside
+// an order can be lost on power loss; during an order the flush waits for the
+// order to end, so at most that order's pours are lost. Restarts flush first.
+const unsigned long INGREDIENT_FLUSH_IDLE_MS = 2000;
+const unsigned long INGREDIENT_FLUSH_MAX_DELAY_MS = 30000;
+// Stats are checkpointed the same way, at most once per interval and only
+// while idle; a power loss costs at most the orders of the last interval.
+const unsigned long STATS_FLUSH_INTERVAL_MS = 60000;
+
+/**
+ * Marks the ingredient stock as changed; it is saved by persist_poll().
+ */
+void mark_ingredients_dirty();
+
+/**
+ * Marks the stats as changed; they are saved by persist_poll().
+ */
+void mark_stats_dirty();
+
+/**
+ * Saves dirty state when the machine has been idle for INGREDIENT_FLUSH_IDLE_MS
+ * since the last change, or once a change is INGREDIENT_FLUSH_MAX_DELAY_MS old.
+ * Dirty stats are saved while idle once STATS_FLUSH_INTERVAL_MS old.
+ * Call from loop().
+ *
+ * @param idle true while no order, calibration or service action uses the machine.
+ */
+void persist_poll(bool idle);
+
+/**
+ * Saves dirty state now (before a restart or sleep).
+ *
+ * @return true if nothing was dirty or the save succeeded.
+ */
+bool persist_flush();
+
+// Flash writes, to compare what orders cost: counted per file written.
+struct FlashWriteStats {
+  uint32_t writes = 0;
+  uint32_t write_ms = 0;
+  uint32_t order_writes = 0;       // of those, while an order was in progress
+  uint32_t order_write_ms = 0;
+  uint32_t max_order_write_ms = 0; // longest single write during an order
+};
+
+extern FlashWriteStats flash_write_stats;
+
+/**
+ * Counts the flash write in its scope into flash_write_stats.
+ */
+class FlashWriteTimer {
+public:
+  FlashWriteTimer();
+  ~FlashWriteTimer();
+private:
+  unsigned long started_ms;
+};
+
+void print_flash_write_stats();
+
 // Stats
 /**
  * Saves the stats to the filesystem.
@@ -56,12 +113,30 @@ bool load_ingredients(Ingredient ingredients[INGREDIENT_COUNT]);
 bool save_stats(const Stats& stats);
 
 /**
- * Loads the stats from the filesystem.
+ * Loads the stats from the filesystem. Preset counts are merged with the
+ * counts from the recipe library, so call after the presets are loaded;
+ * setup_data() does.
  * 
  * @param stats A reference to a Stats object to load data into.
  * @return true if load is successful, false if an error occurs.
  */
 bool load_stats(Stats& stats);
 
+// Calibration
+/**
+ * Saves the scale calibration (zero offset and counts per kg) to the filesystem.
+ * 
+ * @param calibration The calibration to save.
+ * @return true if save is successful, false if an error occurs.
+ */
+bool save_calibration(const ScaleCalibration& calibration);
+
+/**
+ * Loads the scale calibration from the filesystem.
+ * 
+ * @param calibration A reference to a ScaleCalibration to load data into.
+ * @return true if a stored calibration was loaded, false if none exists or an error occurs.
+ */
+bool load_calibration(ScaleCalibration& calibration);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "forecast.h"
+#include "availability.h"
+
+int forecast_lead_minutes = FORECAST_DEFAULT_LEAD_MIN;
+
+// Decayed sum of ml poured, as of last_update_ms.
+static float weighted_ml[INGREDIENT_COUNT] = {};
+static unsigned long last_update_ms[INGREDIENT_COUNT] = {};
+static bool warned[INGREDIENT_COUNT] = {};
+
+static void decay_to_now(int ingredient_index) {
+  unsigned long now = millis();
+  float elapsed_min = (now - last_update_ms[ingredient_index]) / 60000.0f;
+  weighted_ml[ingredient_index] *= expf(-elapsed_min / FORECAST_TIME_CONSTANT_MIN);
+  last_update_ms[ingredient_index] = now;
+}
+
+void forecast_consumed(int ingredient_index, float ml) {
+  if (ml <= 0) return;
+  decay_to_now(ingredient_index);
+  weighted_ml[ingredient_index] += ml;
+}
+
+float forecast_rate_ml_per_min(int ingredient_index) {
+  decay_to_now(ingredient_index);
+  return weighted_ml[ingredient_index] / FORECAST_TIME_CONSTANT_MIN;
+}
+
+float forecast_minutes_to_empty(int ingredient_index) {
+  float rate = forecast_rate_ml_per_min(ingredient_index);
+  if (rate < 0.01f) return FORECAST_NO_ETA;
+  return max(0, ingredient_headroom_ml(ingredient_index)) / rate;
+}
+
+bool forecast_should_warn(int ingredient_index) {
+  float eta = forecast_minutes_to_empty(ingredient_index);
+  bool soon = eta != FORECAST_NO_ETA && eta < forecast_lead_minutes;
+  if (warned[ingredient_index]) {
+    if (eta == FORECAST_NO_ETA || eta >= forecast_lead_minutes * FORECAST_REARM_FACTOR) {
+      warned[ingredient_index] = false;
+    }
+    return false;
+  }
+  return soon;
+}
+
+void forecast_mark_warned(int ingredient_index) {
+  warned[ingredient_index] = true;
+  Serial.printf("Ingredient %d runs out in %.1f min at %.1f ml/min, warned\n", ingredient_index,
+                forecast_minutes_to_empty(ingredient_index), forecast_rate_ml_per_min(ingredient_index));
+}
+
+bool forecast_warned(int ingredient_index) {
+  return warned[ingredient_index];
+}
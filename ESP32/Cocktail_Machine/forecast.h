@@ -0,0 +1,51 @@
+#ifndef FORECAST_H
+#define FORECAST_H
+
+#include "cocktail_data.h"
+
+// When each ingredient will run out at the current pace. Consumption is
+// averaged with exponentially decaying weights, so the rate follows a rush
+// within minutes and falls back when the bar goes quiet:
+//   rate = sum(ml * exp(-age / FORECAST_TIME_CONSTANT_MIN)) / FORECAST_TIME_CONSTANT_MIN
+// Time to empty is the usable stock (above the availability threshold)
+// divided by that rate.
+
+const float FORECAST_TIME_CONSTANT_MIN = 15;
+const int FORECAST_DEFAULT_LEAD_MIN = 10;
+// A warned ingredient is warned again only after its time to empty rose above
+// the lead time by this factor (refilled, or the rush is over).
+const float FORECAST_REARM_FACTOR = 1.5f;
+const float FORECAST_NO_ETA = -1;
+
+// Push a warning when an ingredient is expected to run out within this many
+// minutes. Set over BLE (POST Forecast).
+extern int forecast_lead_minutes;
+
+/*
+Records ml poured of an ingredient. update_ingredient_amount() calls this.
+*/
+void forecast_consumed(int ingredient_index, float ml);
+
+/*
+Current consumption rate in ml per minute.
+*/
+float forecast_rate_ml_per_min(int ingredient_index);
+
+/*
+Minutes until the ingredient runs out at the current rate, or FORECAST_NO_ETA
+if nothing is being used.
+*/
+float forecast_minutes_to_empty(int ingredient_index);
+
+/*
+True while the time to empty is below the lead time and no warning went out
+since the ingredient was last re-armed (see FORECAST_REARM_FACTOR). Call
+forecast_mark_warned() once the warning was actually sent, so a warning
+nobody received is tried again on the next pour.
+*/
+bool forecast_should_warn(int ingredient_index);
+void forecast_mark_warned(int ingredient_index);
+
+bool forecast_warned(int ingredient_index);
+
+#endif
@@ -0,0 +1,76 @@
+#include "health.h"
+
+SubsystemHealth subsystem_health[SUBSYSTEM_COUNT];
+
+static unsigned long step_started_ms[SUBSYSTEM_COUNT];
+static unsigned long boot_done_ms = 0;
+
+void health_step_begin(Subsystem subsystem) {
+  step_started_ms[subsystem] = millis();
+}
+
+void health_step_end(Subsystem subsystem, HealthState state, const String& detail) {
+  subsystem_health[subsystem].boot_ms = millis() - step_started_ms[subsystem];
+  health_set(subsystem, state, detail);
+}
+
+void health_set(Subsystem subsystem, HealthState state, const String& detail) {
+  SubsystemHealth& health = subsystem_health[subsystem];
+  if (health.state == state && health.detail == detail) return;
+  health.state = state;
+  health.detail = detail;
+  Serial.printf("Health: %s %s%s%s\n", health_subsystem_name(subsystem), health_state_name(state),
+                detail.length() ? " - " : "", detail.c_str());
+}
+
+bool health_ok(Subsystem subsystem) {
+  return subsystem_health[subsystem].state == Health_Ok;
+}
+
+bool health_degraded() {
+  for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+    if (subsystem_health[i].state != Health_Ok) return true;
+  }
+  return false;
+}
+
+void health_mark_boot_done() {
+  boot_done_ms = millis();
+}
+
+unsigned long health_boot_total_ms() {
+  return boot_done_ms;
+}
+
+const char* health_subsystem_name(Subsystem subsystem) {
+  switch (subsystem) {
+    case Subsystem_Motors: return "Motors";
+    case Subsystem_Storage: return "Storage";
+    case Subsystem_Recipes: return "Recipes";
+    case Subsystem_Trace: return "Trace";
+    case Subsystem_Load_Cell: return "Load cell";
+    case Subsystem_Light_Sensor: return "Light sensor";
+    case Subsystem_Display: return "Display";
+    case Subsystem_Bluetooth: return "Bluetooth";
+    default: return "?";
+  }
+}
+
+const char* health_state_name(HealthState state) {
+  switch (state) {
+    case Health_Pending: return "pending";
+    case Health_Ok: return "ok";
+    case Health_Degraded: return "degraded";
+    case Health_Failed: return "failed";
+    default: return "?";
+  }
+}
+
+void health_print_report() {
+  Serial.printf("Boot finished after %lu ms\n", health_boot_total_ms());
+  for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+    const SubsystemHealth& health = subsystem_health[i];
+    Serial.printf("  %-13s %-9s %5lu ms  %s\n", health_subsystem_name((Subsystem)i),
+                  health_state_name(health.state), health.boot_ms, health.detail.c_str());
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <Arduino.h>
+
+// Bring-up limits: a missing part must never keep the machine from reaching
+// the touch screen and BLE.
+const unsigned long SERIAL_WAIT_TIMEOUT_MS = 500;
+const int FS_INIT_ATTEMPTS = 3;
+const int DATA_LOAD_ATTEMPTS = 3;
+
+enum Subsystem {
+  Subsystem_Motors,
+  Subsystem_Storage,
+  Subsystem_Recipes,
+  Subsystem_Trace,
+  Subsystem_Load_Cell,
+  Subsystem_Light_Sensor,
+  Subsystem_Display,
+  Subsystem_Bluetooth,
+  SUBSYSTEM_COUNT
+};
+
+enum HealthState {
+  Health_Pending,   // still coming up (e.g. load cell waiting to tare)
+  Health_Ok,
+  Health_Degraded,  // works with reduced function
+  Health_Failed
+};
+
+struct SubsystemHealth {
+  HealthState state = Health_Pending;
+  unsigned long boot_ms = 0;  // time its bring-up step took
+  String detail;
+};
+
+extern SubsystemHealth subsystem_health[SUBSYSTEM_COUNT];
+
+/*
+Marks the start of a subsystem's bring-up step for timing.
+*/
+void health_step_begin(Subsystem subsystem);
+
+/*
+Ends the bring-up step started with health_step_begin() and records its state.
+*/
+void health_step_end(Subsystem subsystem, HealthState state, const String& detail = "");
+
+/*
+Changes the state of a subsystem after boot (recovery or late failure).
+*/
+void health_set(Subsystem subsystem, HealthState state, const String& detail = "");
+
+bool health_ok(Subsystem subsystem);
+
+/*
+True if any subsystem is not fully working.
+*/
+bool health_degraded();
+
+/*
+Total time from power on to the end of setup().
+*/
+unsigned long health_boot_total_ms();
+void health_mark_boot_done();
+
+const char* health_subsystem_name(Subsystem subsystem);
+const char* health_state_name(HealthState state);
+
+/*
+Prints every subsystem's state and bring-up time to serial.
+*/
+void health_print_report();
+
+#endif
@@ -0,0 +1,178 @@
+#include "hx711_async.h"
+
+void IRAM_ATTR HX711Async::on_data_ready(void* arg) {
+  HX711Async* self = (HX711Async*)arg;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(self->task, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+void HX711Async::acquisition_task(void* arg) {
+  HX711Async* self = (HX711Async*)arg;
+  for (;;) {
+    // The timeout picks up a conversion whose edge was missed, e.g. one that
+    // became ready while the previous value was still being clocked out.
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(200));
+    // DOUT also toggles while bits are shifted out, which leaves one stale
+    // edge pending: only clock when the chip really has data.
+    if (self->powered && digitalRead(self->dout_pin) == LOW) {
+      self->fetch();
+    }
+  }
+}
+
+int32_t HX711Async::shift_in() {
+  uint32_t value = 0;
+  // SCK held high for more than 60 us powers the chip down, so the burst must
+  // not be preempted. This masks interrupts on this core only.
+  portENTER_CRITICAL(&mux);
+  for (int i = 0; i < 24; i++) {
+    digitalWrite(sck_pin, HIGH);
+    delayMicroseconds(1);
+    value = (value << 1) | digitalRead(dout_pin);
+    digitalWrite(sck_pin, LOW);
+    delayMicroseconds(1);
+  }
+  // Extra pulses select channel and gain for the next conversion.
+  for (int i = 0; i < gain_pulses; i++) {
+    digitalWrite(sck_pin, HIGH);
+    delayMicroseconds(1);
+    digitalWrite(sck_pin, LOW);
+    delayMicroseconds(1);
+  }
+  portEXIT_CRITICAL(&mux);
+
+  // Sign-extend the 24-bit two's complement result.
+  if (value & 0x800000) {
+    value |= 0xFF000000;
+  }
+  return (int32_t)value;
+}
+
+void HX711Async::fetch() {
+  uint32_t start = ESP.getCycleCount();
+  int32_t value = shift_in();
+  if (uxQueueMessagesWaiting(queue) > 0) {
+    overrun_count++;
+  }
+  xQueueOverwrite(queue, &value);
+  uint32_t cycles = ESP.getCycleCount() - start;
+  fetch_cycles = conversion_count == 0 ? cycles : (fetch_cycles * 7 + cycles) / 8;
+  conversion_count++;
+}
+
+uint32_t HX711Async::average_fetch_cycles() const {
+  return fetch_cycles;
+}
+
+void HX711Async::begin(uint8_t dout, uint8_t pd_sck, uint8_t gain) {
+  dout_pin = dout;
+  sck_pin = pd_sck;
+  pinMode(sck_pin, OUTPUT);
+  pinMode(dout_pin, INPUT_PULLUP);
+  digitalWrite(sck_pin, LOW);
+  set_gain(gain);
+
+  if (!queue) {
+    queue = xQueueCreate(HX711_QUEUE_LENGTH, sizeof(int32_t));
+  }
+  if (!task) {
+    xTaskCreatePinnedToCore(acquisition_task, "hx711", HX711_TASK_STACK, this,
+                            HX711_TASK_PRIORITY, &task, HX711_TASK_CORE);
+  }
+  powered = true;
+  attachInterruptArg(digitalPinToInterrupt(dout_pin), on_data_ready, this, FALLING);
+}
+
+bool HX711Async::is_ready() {
+  return queue && uxQueueMessagesWaiting(queue) > 0;
+}
+
+void HX711Async::wait_ready(unsigned long delay_ms) {
+  int32_t value;
+  while (!queue || xQueuePeek(queue, &value, portMAX_DELAY) != pdTRUE) {
+    delay(delay_ms);
+  }
+}
+
+bool HX711Async::wait_ready_retry(int retries, unsigned long delay_ms) {
+  for (int i = 0; i < retries; i++) {
+    if (wait_ready_timeout(max(delay_ms, 1UL))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HX711Async::wait_ready_timeout(unsigned long timeout, unsigned long delay_ms) {
+  int32_t value;
+  return queue && xQueuePeek(queue, &value, pdMS_TO_TICKS(timeout)) == pdTRUE;
+}
+
+void HX711Async::set_gain(uint8_t gain) {
+  switch (gain) {
+    case 128: gain_pulses = 1; break;  // channel A
+    case 64: gain_pulses = 3; break;   // channel A
+    case 32: gain_pulses = 2; break;   // channel B
+  }
+}
+
+long HX711Async::read() {
+  if (!queue || xQueueReceive(queue, &last_value, pdMS_TO_TICKS(HX711_READ_TIMEOUT_MS)) != pdTRUE) {
+    timeout_count++;
+  }
+  return last_value;
+}
+
+long HX711Async::read_average(uint8_t times) {
+  if (times < 1) times = 1;
+  int64_t sum = 0;
+  for (uint8_t i = 0; i < times; i++) {
+    sum += read();
+  }
+  return (long)(sum / times);
+}
+
+double HX711Async::get_value(uint8_t times) {
+  return read_average(times) - offset;
+}
+
+float HX711Async::get_units(uint8_t times) {
+  return get_value(times) / scale;
+}
+
+void HX711Async::tare(uint8_t times) {
+  set_offset(read_average(times));
+}
+
+void HX711Async::set_scale(float new_scale) {
+  scale = new_scale;
+}
+
+float HX711Async::get_scale() {
+  return scale;
+}
+
+void HX711Async::set_offset(long new_offset) {
+  offset = new_offset;
+}
+
+long HX711Async::get_offset() {
+  return offset;
+}
+
+void HX711Async::power_down() {
+  powered = false;
+  digitalWrite(sck_pin, LOW);
+  digitalWrite(sck_pin, HIGH);
+}
+
+void HX711Async::power_up() {
+  digitalWrite(sck_pin, LOW);
+  if (queue) {
+    xQueueReset(queue);
+  }
+  powered = true;
+}
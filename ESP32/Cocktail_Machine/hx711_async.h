@@ -0,0 +1,83 @@
+#ifndef HX711_ASYNC_H
+#define HX711_ASYNC_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+// The acquisition task hands over conversions through a one-slot mailbox: a
+// new conversion overwrites one nobody read, so a reader always gets the
+// latest and never one from up to a queue's length ago.
+const int HX711_QUEUE_LENGTH = 1;
+// The acquisition task runs on the Arduino core, away from the BLE stack.
+const int HX711_TASK_CORE = 1;
+const int HX711_TASK_PRIORITY = 5;
+const uint32_t HX711_TASK_STACK = 2048;
+// read() gives up after this long, so an unplugged load cell cannot hang the
+// caller; the last value is returned and counted as a timeout. Callers that
+// must know (weight.cpp) wait with wait_ready_timeout() first.
+const unsigned long HX711_READ_TIMEOUT_MS = 1000;
+
+/*
+HX711 driver with the same interface as the bogde HX711 library, but
+conversions are fetched in the background: a falling edge on DOUT (data
+ready) wakes a task that clocks the 24 bits out and posts the value to a
+mailbox. read() takes the newest unread value, waiting for the next one if
+it was already taken, so callers never spin on the chip, and the short
+clocking burst masks interrupts on the Arduino core only, not on the core
+running BLE.
+*/
+class HX711Async {
+public:
+  void begin(uint8_t dout, uint8_t pd_sck, uint8_t gain = 128);
+  bool is_ready();
+  void wait_ready(unsigned long delay_ms = 0);
+  bool wait_ready_retry(int retries = 3, unsigned long delay_ms = 0);
+  bool wait_ready_timeout(unsigned long timeout = 1000, unsigned long delay_ms = 0);
+  void set_gain(uint8_t gain = 128);
+  long read();
+  long read_average(uint8_t times = 10);
+  double get_value(uint8_t times = 1);
+  float get_units(uint8_t times = 1);
+  void tare(uint8_t times = 10);
+  void set_scale(float scale = 1.f);
+  float get_scale();
+  void set_offset(long offset = 0);
+  long get_offset();
+  void power_down();
+  void power_up();
+
+  // Diagnostics: conversions fetched, conversions overwritten before anybody
+  // read them, reads that timed out, and average CPU cycles spent clocking
+  // one out.
+  uint32_t conversions() const { return conversion_count; }
+  uint32_t overruns() const { return overrun_count; }
+  uint32_t timeouts() const { return timeout_count; }
+  uint32_t average_fetch_cycles() const;
+
+private:
+  static void on_data_ready(void* arg);
+  static void acquisition_task(void* arg);
+  int32_t shift_in();
+  void fetch();
+
+  uint8_t dout_pin = 0;
+  uint8_t sck_pin = 0;
+  uint8_t gain_pulses = 1;
+  long offset = 0;
+  float scale = 1.f;
+  bool powered = false;
+  int32_t last_value = 0;
+
+  QueueHandle_t queue = nullptr;
+  TaskHandle_t task = nullptr;
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+  volatile uint32_t conversion_count = 0;
+  volatile uint32_t overrun_count = 0;
+  uint32_t timeout_count = 0;
+  volatile uint32_t fetch_cycles = 0;
+};
+
+#endif
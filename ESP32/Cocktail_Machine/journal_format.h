@@ -0,0 +1,50 @@
+#ifndef JOURNAL_FORMAT_H
+#define JOURNAL_FORMAT_H
+
+#include <stdint.h>
+
+// Binary layout of the order journal: one fixed-size record per order, made
+// of a JournalOrder followed by one JournalPour per pump. Kept free of
+// Arduino dependencies like trace_format.h, for host-side decoding.
+
+const uint32_t JOURNAL_MAGIC = 0x4E524A43;  // "CJRN"
+const uint16_t JOURNAL_VERSION = 1;
+
+enum OrderSource : uint8_t {
+  Source_Menu = 0,   // order button of the side menu
+  Source_Quick = 1   // quick dispense screen
+};
+
+// Times are milliseconds after the order was placed, 0 if the step was not
+// reached.
+struct __attribute__((packed)) JournalOrder {
+  uint32_t order_id;       // increasing, never reused
+  uint32_t placed_s;       // seconds since 1970 (see order_history.h)
+  uint16_t recipe_id;
+  uint8_t size;            // CocktailSize
+  uint8_t source;          // OrderSource
+  uint8_t outcome;         // OrderState
+  uint8_t reserved;
+  uint32_t cup_detected_ms;
+  uint32_t done_ms;
+};
+
+struct __attribute__((packed)) JournalPour {
+  uint32_t start_ms;
+  uint32_t stop_ms;
+  int32_t target_mg;
+  int32_t actual_mg;
+};
+
+// Written once at the start of every export, followed by record_count records
+// of record_size bytes each.
+struct __attribute__((packed)) JournalDumpHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint16_t pump_count;
+  uint16_t reserved;
+  uint32_t record_count;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MACHINE_CONFIG_H
+#define MACHINE_CONFIG_H
+
+#include <stddef.h>
+
+/*
+Build-time shape of the machine. Everything sized by the number of pumps,
+preset slots or stations derives from here, so another build is a matter of
+flags, e.g. -DMACHINE_PUMPS=8 -DMACHINE_MOTOR_PINS="18,19,22,27,16,17,26,21".
+*/
+template <int Pumps, int PresetSlots, int Stations>
+struct MachineTraits {
+  static const int pump_count = Pumps;
+  static const int preset_slots = PresetSlots;
+  static const int station_count = Stations;
+
+  // Presets are shown on a square grid just large enough for the slots.
+  static const int grid_dimension = PresetSlots <= 4 ? 2 : (PresetSlots <= 9 ? 3 : 4);
+  // The custom drink screen has one tile per pump.
+  static const int custom_columns = Pumps <= 4 ? 2 : (Pumps <= 9 ? 3 : 4);
+  static const int custom_rows = (Pumps + custom_columns - 1) / custom_columns;
+
+  static_assert(Pumps >= 1 && Pumps <= 16, "pump count out of range");
+  static_assert(PresetSlots >= 1 && PresetSlots <= 16, "preset slots must fit the grid and a 16-bit mask");
+  static_assert(Stations == 1, "one scale and cup sensor: a single station is supported");
+  static_assert(custom_rows <= 4, "custom drink tiles would be too small");
+};
+
+#ifndef MACHINE_PUMPS
+#define MACHINE_PUMPS 4
+#endif
+#ifndef MACHINE_PRESET_SLOTS
+#define MACHINE_PRESET_SLOTS 9
+#endif
+#ifndef MACHINE_STATIONS
+#define MACHINE_STATIONS 1
+#endif
+// Motor driver pins, one per pump in pump order.
+#ifndef MACHINE_MOTOR_PINS
+#define MACHINE_MOTOR_PINS 18, 19, 22, 27
+#endif
+
+typedef MachineTraits<MACHINE_PUMPS, MACHINE_PRESET_SLOTS, MACHINE_STATIONS> Machine;
+
+// Larger builds must still lay out.
+static_assert(MachineTraits<8, 9, 1>::custom_columns == 3 && MachineTraits<8, 9, 1>::custom_rows == 3, "8-pump layout");
+static_assert(MachineTraits<12, 16, 1>::grid_dimension == 4 && MachineTraits<12, 16, 1>::custom_rows == 3, "12-pump layout");
+static_assert(MachineTraits<2, 4, 1>::grid_dimension == 2 && MachineTraits<2, 4, 1>::custom_rows == 1, "2-pump layout");
+
+// ArduinoJson documents listing every preset or pump grow with the build: a
+// 16-byte slot per value plus copied strings, with some headroom.
+constexpr size_t json_list_size(int items, int values_per_item, int string_bytes_per_item) {
+  return 512 + items * (values_per_item * 16 + string_bytes_per_item);
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include "makeable.h"
+#include "availability.h"
+#include "recipe_store.h"
+
+static const int MAKEABLE_WORDS = (RECIPE_STORE_MAX_COUNT + 31) / 32;
+
+// Positions holding a recipe that uses at least one ingredient.
+static uint32_t has_ingredients[MAKEABLE_WORDS];
+// Per ingredient, the recipes needing more of it than the stock allows.
+static uint32_t short_of[INGREDIENT_COUNT][MAKEABLE_WORDS];
+// Largest recipe amount (as stored, medium size) each ingredient can still
+// supply at the chosen size.
+static int amount_limit[INGREDIENT_COUNT];
+static int makeable_total = 0;
+
+struct PostingUpdate {
+  int ingredient;
+  bool set_short;  // stock went down
+  bool rebuild;    // also mark the recipe as present
+};
+
+static void set_bit(uint32_t* bits, int position, bool value) {
+  uint32_t mask = 1u << (position % 32);
+  if (value) {
+    bits[position / 32] |= mask;
+  } else {
+    bits[position / 32] &= ~mask;
+  }
+}
+
+static int limit_for(int ingredient) {
+  // Inverse of the rounding-up in availability.cpp: a recipe amount fits if
+  // ceil(amount * permille / 1000) <= headroom.
+  int headroom = ingredient_headroom_ml(ingredient);
+  if (headroom <= 0) return 0;
+  return (int)((int64_t)headroom * 1000 / PORTION_PERMILLE[chosen_cocktail_size]);
+}
+
+static void apply_posting(const RecipePosting& posting, void* context) {
+  const PostingUpdate* update = (const PostingUpdate*)context;
+  if (update->rebuild) {
+    set_bit(has_ingredients, posting.position, true);
+    set_bit(short_of[update->ingredient], posting.position, posting.amount > amount_limit[update->ingredient]);
+  } else {
+    set_bit(short_of[update->ingredient], posting.position, update->set_short);
+  }
+}
+
+static uint32_t makeable_word(int word) {
+  uint32_t blocked = 0;
+  for (int ingredient = 0; ingredient < INGREDIENT_COUNT; ingredient++) {
+    blocked |= short_of[ingredient][word];
+  }
+  return has_ingredients[word] & ~blocked;
+}
+
+static void recount() {
+  int words = (recipe_store_count() + 31) / 32;
+  makeable_total = 0;
+  for (int word = 0; word < words; word++) {
+    makeable_total += __builtin_popcount(makeable_word(word));
+  }
+}
+
+void makeable_rebuild() {
+  memset(has_ingredients, 0, sizeof(has_ingredients));
+  memset(short_of, 0, sizeof(short_of));
+  for (int ingredient = 0; ingredient < INGREDIENT_COUNT; ingredient++) {
+    amount_limit[ingredient] = limit_for(ingredient);
+    PostingUpdate update = { ingredient, false, true };
+    recipe_store_visit_postings(ingredient, 0, 0xFFFF, apply_posting, &update);
+  }
+  recount();
+  Serial.printf("Makeable recipes: %d of %d\n", makeable_total, recipe_store_count());
+}
+
+void makeable_ingredient_changed(int ingredient_index) {
+  int old_limit = amount_limit[ingredient_index];
+  int new_limit = limit_for(ingredient_index);
+  if (new_limit == old_limit) return;
+  amount_limit[ingredient_index] = new_limit;
+
+  // Only recipes whose amount lies between the two limits change side.
+  PostingUpdate update = { ingredient_index, new_limit < old_limit, false };
+  recipe_store_visit_postings(ingredient_index, min(old_limit, new_limit), max(old_limit, new_limit), apply_posting, &update);
+  recount();
+}
+
+void makeable_size_changed() {
+  for (int ingredient = 0; ingredient < INGREDIENT_COUNT; ingredient++) {
+    makeable_ingredient_changed(ingredient);
+  }
+}
+
+int makeable_count() {
+  return makeable_total;
+}
+
+bool makeable_at(int position) {
+  if (position < 0 || position >= recipe_store_count()) return false;
+  return (makeable_word(position / 32) >> (position % 32)) & 1;
+}
+
+int next_makeable(int from) {
+  int count = recipe_store_count();
+  if (from < 0) from = 0;
+  for (int word = from / 32; word * 32 < count; word++) {
+    uint32_t bits = makeable_word(word);
+    if (word == from / 32) {
+      bits &= ~0u << (from % 32);
+    }
+    if (bits != 0) {
+      int position = word * 32 + __builtin_ctz(bits);
+      return position < count ? position : -1;
+    }
+  }
+  return -1;
+}
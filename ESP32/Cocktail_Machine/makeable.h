@@ -0,0 +1,48 @@
+#ifndef MAKEABLE_H
+#define MAKEABLE_H
+
+#include "cocktail_data.h"
+
+// Which recipes of the whole library can be poured with the current stock at
+// the chosen size. availability.h answers the same for the loaded page with
+// servings counts; this answers it for every recipe with one bit each.
+//
+// Per ingredient a bitset marks the recipes needing more of it than is left.
+// A stock change walks only the stretch of that ingredient's posting list
+// between the old and the new limit, and "makeable now" is the recipes with
+// ingredients and none of those bits set: a bitwise AND over the library.
+
+/*
+Rebuilds every bitset from the posting lists. Call when the library was
+rewritten and once stock is loaded.
+*/
+void makeable_rebuild();
+
+/*
+Call when an ingredient's stock changed (availability_ingredient_changed()
+does).
+*/
+void makeable_ingredient_changed(int ingredient_index);
+
+/*
+Call when chosen_cocktail_size changed (availability_size_changed() does).
+*/
+void makeable_size_changed();
+
+/*
+Number of library recipes that can be poured now.
+*/
+int makeable_count();
+
+/*
+True if the recipe at this library position can be poured now.
+*/
+bool makeable_at(int position);
+
+/*
+First position at or after `from` holding a recipe that can be poured now,
+or -1.
+*/
+int next_makeable(int from);
+
+#endif
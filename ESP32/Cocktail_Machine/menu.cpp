@@ -1,5 +1,12 @@
 #include "menu.h"
 #include "cocktail_data.h"
+#include "calibration.h"
+#include "health.h"
+#include "availability.h"
+#include "popularity.h"
+#include "recipe_store.h"
+#include "makeable.h"
+#include "order_journal.h"
 
 TFT_eSPI tft = TFT_eSPI();
 SPIClass touchscreenSPI = SPIClass(VSPI);
@@ -7,12 +14,15 @@ XPT2046_Touchscreen touchscreen(XPT2046_CS, XPT2046_IRQ);
 
 MenuState current_menu = Menu_1;
 int menu_1_selected_cocktail_tile = -1;
-String current_cancellable_op_text = "";
-String current_error_message = "";
+bool skip_unmakeable_pages = true;
+char current_cancellable_op_text[MENU_MESSAGE_CAPACITY] = "";
+char current_error_message[MENU_MESSAGE_CAPACITY] = "";
 bool is_quick = false;
+int service_reference_mass_g = SERVICE_DEFAULT_MASS_G;
+String service_status_message = "";
 
 int get_menu_1_new_tile(int x, int y) {
-    return (y / (SCREEN_HEIGHT / 3)) * 3 + (x / (MAIN_WIDTH / 3));
+    return (y / TILE_HEIGHT) * TABLE_DIMENSION + x / TILE_WIDTH;
 }
 
 bool check_long_press(TS_Point* p) {
@@ -85,55 +95,96 @@ void draw_random_button(bool highlight) {
 }
 
 
-void draw_menu_1_tile(int tile_index, bool selected, bool cocktail_available, int y_offset = 0, const Cocktail* cock_array = preset_cocktails) {
+// Maps a grid tile to the preset slot it shows, -1 for an empty tile.
+typedef int (*TileSlotFn)(int tile);
+
+static int menu_1_tile_slot(int tile) {
+    return tile < PRESET_COCKTAIL_COUNT ? tile : -1;
+}
+
+static int menu_3_tile_slot(int tile) {
+    return top_recipe_slot(tile);
+}
+
+static bool is_selected_slot(int slot) {
+    return slot >= 0 && selected_preset_id != RECIPE_ID_NONE && preset_cocktails[slot].id == selected_preset_id;
+}
+
+void draw_menu_1_tile(int tile_index, int slot, bool selected, int y_offset = 0) {
     Serial.println("draw_menu_1_tile entered");
-    const int lineH = 10;
     int i = tile_index % TABLE_DIMENSION;
     int j = tile_index / TABLE_DIMENSION;
-    int x = i * (MAIN_WIDTH / TABLE_DIMENSION);
-    int y = j * (SCREEN_HEIGHT / TABLE_DIMENSION) + y_offset;
+    int x = i * TILE_WIDTH;
+    int y = j * TILE_HEIGHT + y_offset;
+
+    tft.fillRect(x, y, TILE_WIDTH, TILE_HEIGHT, TFT_BLACK);
+    tft.drawRect(x, y, TILE_WIDTH, TILE_HEIGHT, TFT_WHITE);
 
-    tft.fillRect(x, y, MAIN_WIDTH / 3, SCREEN_HEIGHT / 3, TFT_BLACK);
-    tft.drawRect(x, y, MAIN_WIDTH / 3, SCREEN_HEIGHT / 3, TFT_WHITE);
+    if (slot < 0) {
+        return;
+    }
+    const Cocktail& cocktail = preset_cocktails[slot];
+    bool cocktail_available = preset_available(slot);
 
     Serial.println("printing cocktail on tile");
     tft.setCursor(x + 5, y + 6);
-    tft.print(cock_array[tile_index].name);
-    for (int k = 0; k < INGREDIENT_COUNT; k++) {
-        tft.setCursor(x + 5, y + 10 + (k + 1) * lineH);
-        tft.print(ingredients[k].name.substring(0, 3));
+    tft.print(cocktail.name);
+    // All ingredients when they fit, otherwise the ones the recipe uses.
+    bool used_only = INGREDIENT_COUNT > TILE_INGREDIENT_LINES;
+    int line = 0;
+    for (int k = 0; k < INGREDIENT_COUNT && line < TILE_INGREDIENT_LINES; k++) {
+        if (used_only && cocktail.amounts[k] == 0) continue;
+        line++;
+        tft.setCursor(x + 5, y + 10 + line * TILE_LINE_HEIGHT);
+        char abbreviation[4];
+        copy_name(abbreviation, sizeof(abbreviation), ingredients[k].name);
+        tft.print(abbreviation);
         tft.print(": ");
-        tft.print(cock_array[tile_index].amounts[k]);
+        tft.print(cocktail.amounts[k]);
         tft.print(" ml");
     }
 
+    // Servings left at the chosen size, so refills can be planned.
+    if (!isCocktailEmpty(cocktail)) {
+        int servings = preset_servings(slot, chosen_cocktail_size);
+        tft.setCursor(x + 5, y + TILE_SERVINGS_Y);
+        tft.setTextColor(servings <= LOW_SERVINGS_WARNING ? TFT_ORANGE : TFT_LIGHTGREY, TFT_BLACK);
+        if (servings >= SERVINGS_MAX) {
+            tft.print("many left");
+        } else {
+            tft.print(servings);
+            tft.print(" left");
+        }
+        tft.setTextColor(TFT_WHITE, TFT_BLACK);
+    }
+
     Serial.println("printing x effect");
     if (!cocktail_available) {
-        tft.drawLine(x, y, x + MAIN_WIDTH / 3, y + SCREEN_HEIGHT / 3, TFT_RED);
-        tft.drawLine(x + MAIN_WIDTH / 3, y, x, y + SCREEN_HEIGHT / 3, TFT_RED);
+        tft.drawLine(x, y, x + TILE_WIDTH, y + TILE_HEIGHT, TFT_RED);
+        tft.drawLine(x + TILE_WIDTH, y, x, y + TILE_HEIGHT, TFT_RED);
         return;
     }
 
     Serial.println("printing selection effect");
     if (selected) {
-        tft.drawRect(x + 2, y + 2, MAIN_WIDTH / 3 - 4, SCREEN_HEIGHT / 3 - 4, TFT_ORANGE);
-        tft.drawRect(x + 3, y + 3, MAIN_WIDTH / 3 - 6, SCREEN_HEIGHT / 3 - 6, TFT_ORANGE);
+        tft.drawRect(x + 2, y + 2, TILE_WIDTH - 4, TILE_HEIGHT - 4, TFT_ORANGE);
+        tft.drawRect(x + 3, y + 3, TILE_WIDTH - 6, TILE_HEIGHT - 6, TFT_ORANGE);
     }
 }
 
 void draw_menu_2_tile(int ingredient_index, bool can_add) {
-    const int tileW = MAIN_WIDTH / 2;
-    const int tileH = SCREEN_HEIGHT / 2;
-    const int button_size = 40;
-    const int spacing = 10;
+    const int tileW = CUSTOM_TILE_WIDTH;
+    const int tileH = CUSTOM_TILE_HEIGHT;
+    const int button_size = CUSTOM_BUTTON_SIZE;
+    const int spacing = CUSTOM_BUTTON_SPACING;
 
-    int i = ingredient_index % 2;
-    int j = ingredient_index / 2;
+    int i = ingredient_index % Machine::custom_columns;
+    int j = ingredient_index / Machine::custom_columns;
     int x = i * tileW;
     int y = j * tileH;
 
     tft.fillRect(x, y, tileW, tileH, ingredients[ingredient_index].color);
-    tft.setTextSize(2);
+    tft.setTextSize(CUSTOM_TILE_TEXT_SIZE);
 
     // Name
     tft.setCursor(x + 8, y + 8);
@@ -141,7 +192,7 @@ void draw_menu_2_tile(int ingredient_index, bool can_add) {
     tft.print(ingredients[ingredient_index].name);
 
     // Amount
-    tft.setCursor(x + 8, y + 28);
+    tft.setCursor(x + 8, y + 12 + 8 * CUSTOM_TILE_TEXT_SIZE);
     tft.print(current_custom_cocktail.amounts[ingredient_index]);
     tft.print(" ml");
 
@@ -150,7 +201,7 @@ void draw_menu_2_tile(int ingredient_index, bool can_add) {
     int bx = x + (tileW - button_total) / 2;
     int by = y + tileH - button_size - 5;
 
-    tft.setTextSize(3);
+    tft.setTextSize(CUSTOM_TILE_TEXT_SIZE + 1);
 
     // Draw + button
     tft.drawRect(bx, by, button_size, button_size, TFT_BLACK);
@@ -209,25 +260,40 @@ void draw_quick_screen() {
 
 void handle_touch_quick_screen(int x, int y) {
     if (x >= QUICK_ORDER_BUTTON_X && x <= (QUICK_ORDER_BUTTON_X + QUICK_ORDER_BUTTON_WIDTH) && y >= QUICK_ORDER_BUTTON_Y && y <= (QUICK_ORDER_BUTTON_Y + QUICK_ORDER_BUTTON_HEIGHT)) {
+        journal_order_placed(Source_Quick);
         order_pending = true;
     }
 }
 
-void enter_quick_mode(Cocktail cocktail) {
-    ordered_cocktail.name = cocktail.name;
-    memcpy(ordered_cocktail.amounts, cocktail.amounts, sizeof(cocktail.amounts));
+void enter_quick_mode(const Cocktail& cocktail) {
+    ordered_cocktail = cocktail;
     is_quick = true;
     current_menu = Quick;
     draw_current_menu();
 }
 
-void exit_quick_mode(Cocktail cocktail) {
-    ordered_cocktail.name = UNSELECTED_COCKTAIL_NAME;
+void exit_quick_mode(const Cocktail& cocktail) {
+    ordered_cocktail = make_cocktail(UNSELECTED_COCKTAIL_NAME);
     is_quick = false;
     current_menu = Menu_1;
     draw_current_menu();
 }
 
+// The next page with something that can be poured now, skipping pages where
+// every tile would be greyed out. Pages turn in order if nothing can be made
+// or skipping is turned off.
+static int next_page_to_show() {
+    int next = (recipe_store_current_page() + 1) % recipe_store_page_count();
+    if (!skip_unmakeable_pages) {
+        return next;
+    }
+    int position = next_makeable(next * RECIPE_PAGE_SIZE);
+    if (position < 0) {
+        position = next_makeable(0);
+    }
+    return position >= 0 ? position / RECIPE_PAGE_SIZE : next;
+}
+
 bool is_tile_menu(){
   return current_menu == 1 || current_menu == 3; 
 }
@@ -249,20 +315,31 @@ void draw_side_menu() {
         tft.print(current_button_label);
     }
     tft.setTextSize(DEFAULT_TEXT_SIZE);
+
+    // Page indicator under "1" when the library has more than one page.
+    if (recipe_store_page_count() > 1) {
+        char page_label[8];  // "456/456" at most
+        snprintf(page_label, sizeof(page_label), "%d/%d", recipe_store_current_page() + 1, recipe_store_page_count());
+        int16_t text_pos_x = MAIN_WIDTH + (SIDE_WIDTH - tft.textWidth(page_label)) / 2;
+        tft.setCursor(text_pos_x, SIDE_BUTTON_HEIGHT - SIDE_PAGE_LABEL_MARGIN);
+        tft.print(page_label);
+    }
 }
 
 void draw_menu_1() {
-    ordered_cocktail = current_preset_cocktail;
+    int selected_slot = find_preset(selected_preset_id);
+    ordered_cocktail = selected_slot >= 0 ? preset_cocktails[selected_slot] : make_cocktail(UNSELECTED_COCKTAIL_NAME);
     tft.setTextSize(DEFAULT_TEXT_SIZE);
     for (int i = 0; i < TABLE_DIMENSION * TABLE_DIMENSION; i++) {
-        bool is_selected = (preset_cocktails[i].name == current_preset_cocktail.name);
-        draw_menu_1_tile(i, is_selected, isCocktailAvailable(preset_cocktails[i]));
+        int slot = menu_1_tile_slot(i);
+        draw_menu_1_tile(i, slot, is_selected_slot(slot));
     }
+    availability_take_changes();  // everything was just drawn
 }
 
 void draw_menu_2() {
     tft.setTextSize(DEFAULT_TEXT_SIZE);
-    for (int ingredient_index = 0; ingredient_index < 4; ingredient_index++) {
+    for (int ingredient_index = 0; ingredient_index < INGREDIENT_COUNT; ingredient_index++) {
         bool is_max_amount = current_custom_cocktail.amounts[ingredient_index] >= 200;
         bool can_add = !is_max_amount && isIngredientAvailable(ingredients[ingredient_index], current_custom_cocktail.amounts[ingredient_index] + MENU_2_INGREDIENT_DELTA);
         bool can_subtract = current_custom_cocktail.amounts[ingredient_index] > 0;
@@ -286,9 +363,10 @@ void draw_menu_3() {
 
     // Draw popular drinks like in menu 1
     for (int i = 0; i < TOP_COCKTAIL_COUNT; i++) {
-        bool is_selected = (top_cocktails[i].name == current_preset_cocktail.name);
-        draw_menu_1_tile(i, is_selected, isCocktailAvailable(top_cocktails[i]), MENU3_TILE_Y_OFFSET, top_cocktails);
+        int slot = menu_3_tile_slot(i);
+        draw_menu_1_tile(i, slot, is_selected_slot(slot), MENU3_TILE_Y_OFFSET);
     }
+    availability_take_changes();  // everything was just drawn
 
     // Draw "Random Drink" button at the bottom
     draw_random_button(false);
@@ -325,6 +403,12 @@ void draw_current_menu() {
         case Quick:
             draw_quick_screen();
             break;
+        case Service:
+            draw_service_screen();
+            break;
+        case Health_Screen:
+            draw_health_screen();
+            break;
     }
 }
 
@@ -374,6 +458,16 @@ void handle_touch(TS_Point point) {
         handle_touch_quick_screen(x, y);
     }
 
+    if (current_menu == Service) {
+        handle_touch_service_screen(x, y);
+        return;
+    }
+
+    if (current_menu == Health_Screen) {
+        return_to_main_menu();
+        return;
+    }
+
     if (x >= MAIN_WIDTH) {
         handle_touch_side_menu(x, y);
         return;
@@ -421,21 +515,34 @@ void draw_error_screen() {
 void handle_touch_side_menu(int x, int y) {
     int button = y / SIDE_BUTTON_HEIGHT;
     if (button < 3) {
+        // Tapping "3" again while on menu 3 opens the service screen.
+        if (current_menu == Menu_3 && button == 2) {
+            open_service_screen();
+            return;
+        }
+        // Tapping "1" again while on menu 1 turns to the next recipe page.
+        if (current_menu == Menu_1 && button == 0 && recipe_store_page_count() > 1) {
+            recipe_store_load_page(next_page_to_show());
+            deselect_preset_cocktail();
+            draw_current_menu();
+            return;
+        }
         current_menu = static_cast<MenuState>(button + 1);
         if(is_tile_menu()) deselect_preset_cocktail();
-        chosen_cocktail_size = Medium;
+        set_cocktail_size(Medium);
         draw_current_menu();
     } else {
-        if (ordered_cocktail.name == UNSELECTED_COCKTAIL_NAME) {
+        if (ordered_cocktail.id == RECIPE_ID_NONE) {
             alert_error("No cocktail selected");
         } else {
+            journal_order_placed(Source_Menu);
             order_pending = true;
         }
     }
 }
 
-void alert_error(String msg) {
-    current_error_message = msg;
+void alert_error(const char* msg) {
+    set_name(current_error_message, msg);
     current_menu = Error_Screen;
     draw_current_menu();
 }
@@ -447,11 +554,11 @@ void handle_touch_cancellable_op(int x, int y) {
     draw_current_menu();
 }
 
-void update_selected_tile(int new_tile, int tile_count, const Cocktail* cocktails, int y_offset = 0) {
+void update_selected_tile(int new_tile, int tile_count, TileSlotFn tile_slot, int y_offset = 0) {
 
     int prev_tile = -1;
     for (int i = 0; i < tile_count; i++) {
-        if (cocktails[i].name == current_preset_cocktail.name) {
+        if (is_selected_slot(tile_slot(i))) {
             prev_tile = i;
             Serial.printf("Found prev tile %d\n", prev_tile);
             break;
@@ -460,8 +567,7 @@ void update_selected_tile(int new_tile, int tile_count, const Cocktail* cocktail
 
     if (prev_tile != -1) {
         Serial.printf("Redrawing previous tile %d\n", prev_tile);
-        bool is_prev_available = isCocktailAvailable(cocktails[prev_tile]);
-        draw_menu_1_tile(prev_tile, false, is_prev_available, y_offset, cocktails);
+        draw_menu_1_tile(prev_tile, tile_slot(prev_tile), false, y_offset);
     }
 
     if (new_tile > tile_count - 1) {
@@ -469,15 +575,17 @@ void update_selected_tile(int new_tile, int tile_count, const Cocktail* cocktail
         return;
     }
 
-    bool is_curr_available = isCocktailAvailable(cocktails[new_tile]);
-    draw_menu_1_tile(new_tile, true, is_curr_available, y_offset, cocktails);
+    draw_menu_1_tile(new_tile, tile_slot(new_tile), true, y_offset);
 }
 
-void handle_touch_tiles(int x, int y, int tile_count, const Cocktail* cocktails, int y_offset = 0) {
+void handle_touch_tiles(int x, int y, int tile_count, TileSlotFn tile_slot, int y_offset = 0) {
     Serial.println("Handle touch tiles");
     int new_tile = get_menu_1_new_tile(x, y-y_offset);
+    bool outside_grid = new_tile >= tile_count;
+    int slot = outside_grid ? -1 : tile_slot(new_tile);
 
-    bool is_curr_available = isCocktailAvailable(cocktails[new_tile]);
+    // Outside the grid counts as available so the touch deselects below.
+    bool is_curr_available = outside_grid || preset_available(slot);
 
     if (!is_curr_available) {
         return;
@@ -486,43 +594,59 @@ void handle_touch_tiles(int x, int y, int tile_count, const Cocktail* cocktails,
     Serial.printf("new tile %d \n", new_tile);
     Serial.println("Checking selected tile changed");
 
-    if (cocktails[new_tile].name != current_preset_cocktail.name) {
-        update_selected_tile(new_tile, tile_count, cocktails, y_offset);
+    if (outside_grid || !is_selected_slot(slot)) {
+        update_selected_tile(new_tile, tile_count, tile_slot, y_offset);
     }
 
-    if (new_tile > tile_count - 1) {
+    if (outside_grid) {
         // We touched outside grid and should deselect
         deselect_preset_cocktail();
         return;
     }
 
     Serial.println("Changing cocktail state");
-    current_preset_cocktail.name = cocktails[new_tile].name;
-    memcpy(current_preset_cocktail.amounts, cocktails[new_tile].amounts, sizeof(current_preset_cocktail.amounts));
-    ordered_cocktail = current_preset_cocktail;
+    selected_preset_id = preset_cocktails[slot].id;
+    ordered_cocktail = preset_cocktails[slot];
+
+    Serial.printf("New cocktail chosen: %s (id %u)\n", ordered_cocktail.name, selected_preset_id);
+}
+
+void redraw_availability_changes() {
+    preset_mask_t changed = availability_take_changes();
+    if (changed == 0) return;
+    if (current_menu != Menu_1 && current_menu != Menu_3) return;
 
-    Serial.println("New cocktail chosen:");
-    Serial.println(current_preset_cocktail.name);
+    bool top = current_menu == Menu_3;
+    int tile_count = top ? TOP_COCKTAIL_COUNT : TABLE_DIMENSION * TABLE_DIMENSION;
+    for (int i = 0; i < tile_count; i++) {
+        int slot = top ? menu_3_tile_slot(i) : menu_1_tile_slot(i);
+        if (slot >= 0 && (changed >> slot) & 1) {
+            draw_menu_1_tile(i, slot, is_selected_slot(slot), top ? MENU3_TILE_Y_OFFSET : 0);
+        }
+    }
 }
 
 void handle_touch_menu_1(int x, int y) {
-    handle_touch_tiles(x, y, PRESET_COCKTAIL_COUNT, preset_cocktails);
+    handle_touch_tiles(x, y, TABLE_DIMENSION * TABLE_DIMENSION, menu_1_tile_slot);
 }
 
-int roundDownToNearest10(float value) {
-    return (int(value) / 10) * 10;
+int roundDownToNearest10(int value) {
+    return (value / 10) * 10;
 }
 
 void handle_touch_menu_2(int x, int y) {
-    const int tileW = MAIN_WIDTH / 2;
-    const int tileH = SCREEN_HEIGHT / 2;
-    const int button_size = 40;
-    const int spacing = 10;
+    const int tileW = CUSTOM_TILE_WIDTH;
+    const int tileH = CUSTOM_TILE_HEIGHT;
+    const int button_size = CUSTOM_BUTTON_SIZE;
+    const int spacing = CUSTOM_BUTTON_SPACING;
     const int button_total = button_size * 2 + spacing;
 
     int ci = x / tileW;
     int cj = y / tileH;
-    int ingredient_index = cj * 2 + ci;
+    int ingredient_index = cj * Machine::custom_columns + ci;
+    if (ingredient_index >= INGREDIENT_COUNT) {
+        return;  // empty cell of the last row
+    }
 
     int lx = x % tileW;
     int ly = y % tileH;
@@ -532,7 +656,7 @@ void handle_touch_menu_2(int x, int y) {
 
     bool changed = false;
     if (lx >= bx && lx < bx + button_size && ly >= by && ly < by + button_size) {
-        int maximal_ingredient_available = min(MAX_COCKTAIL_DRINK_AMOUNT, roundDownToNearest10(ingredients[ingredient_index].amount_left));
+        int maximal_ingredient_available = min(MAX_COCKTAIL_DRINK_AMOUNT, roundDownToNearest10(stock_ml(ingredients[ingredient_index])));
         current_custom_cocktail.amounts[ingredient_index] = min(current_custom_cocktail.amounts[ingredient_index] + MENU_2_INGREDIENT_DELTA, maximal_ingredient_available);
         changed = true;
     }
@@ -558,17 +682,17 @@ void handle_touch_menu_2(int x, int y) {
 
 void handle_touch_menu_3(int x, int y) {
     const int TILE_Y_OFFSET = MENU3_TILE_Y_OFFSET;
-    const int TILE_W = MAIN_WIDTH / TABLE_DIMENSION;
-    const int TILE_H = SCREEN_HEIGHT / TABLE_DIMENSION;
+    const int TILE_W = TILE_WIDTH;
+    const int TILE_H = TILE_HEIGHT;
 
-    for (int i = 0; i < 3; i++) {
+    for (int i = 0; i < TOP_COCKTAIL_COUNT; i++) {
         int col = i % TABLE_DIMENSION;
         int row = i / TABLE_DIMENSION;
         int tile_x = col * TILE_W;
         int tile_y = row * TILE_H + TILE_Y_OFFSET;
 
         if (x >= tile_x && x < tile_x + TILE_W && y >= tile_y && y < tile_y + TILE_H) {
-            handle_touch_tiles(x, y, TABLE_DIMENSION, top_cocktails, TILE_Y_OFFSET);
+            handle_touch_tiles(x, y, TOP_COCKTAIL_COUNT, menu_3_tile_slot, TILE_Y_OFFSET);
             draw_random_button(false);
             return;
         }
@@ -580,7 +704,7 @@ void handle_touch_menu_3(int x, int y) {
     int button_h = SIDE_BUTTON_HEIGHT;
 
     if (x >= button_x && x < button_x + button_w && y >= button_y && y < button_y + button_h) {
-        update_selected_tile(TABLE_DIMENSION+1, TABLE_DIMENSION, top_cocktails,  TILE_Y_OFFSET);
+        update_selected_tile(TOP_COCKTAIL_COUNT + 1, TOP_COCKTAIL_COUNT, menu_3_tile_slot, TILE_Y_OFFSET);
         deselect_preset_cocktail();
         draw_random_button(true);  // highlight on press
         ordered_cocktail = get_random_cocktail();
@@ -589,9 +713,9 @@ void handle_touch_menu_3(int x, int y) {
 
 }
 
-void init_cancellable_op(String op_text) {
+void init_cancellable_op(const char* op_text) {
     current_menu = Cancellable_Op;
-    current_cancellable_op_text = op_text;
+    set_name(current_cancellable_op_text, op_text);
     draw_current_menu();
 }
 
@@ -660,11 +784,11 @@ void handle_touch_cocktail_extended_menu(int x, int y) {
 
     if (y >= btnY && y <= btnY + btnH) {
         if (x >= startX && x <= startX + btnW) {
-            chosen_cocktail_size = Small;
+            set_cocktail_size(Small);
         } else if (x >= startX + btnW + btnGap && x <= startX + 2 * btnW + btnGap) {
-            chosen_cocktail_size = Medium;
+            set_cocktail_size(Medium);
         } else if (x >= startX + 2 * (btnW + btnGap) && x <= startX + 3 * btnW + 2 * btnGap) {
-            chosen_cocktail_size = Large;
+            set_cocktail_size(Large);
         }
     }
     // Redraw only previous and current buttons if changed
@@ -688,11 +812,166 @@ void handle_touch_cocktail_extended_menu(int x, int y) {
     int xY = SCREEN_HEIGHT - xSize - 20;
 
     if (x >= xX && x <= xX + xSize && y >= xY && y <= xY + xSize) {
-        chosen_cocktail_size = Medium;
+        set_cocktail_size(Medium);
         return_to_main_menu();
     }
 }
 
+void draw_service_button(int index, const char* label, uint16_t color) {
+    int x = index * SERVICE_BUTTON_WIDTH;
+    tft.fillRect(x + 4, SERVICE_BUTTON_Y, SERVICE_BUTTON_WIDTH - 8, SERVICE_BUTTON_HEIGHT, color);
+    tft.setTextColor(TFT_WHITE, color);
+    tft.drawString(label, x + SERVICE_BUTTON_WIDTH / 2, SERVICE_BUTTON_Y + SERVICE_BUTTON_HEIGHT / 2);
+}
+
+void draw_service_screen() {
+    const CalibrationSession& session = calibration_session;
+    char line[64];
+
+    tft.fillScreen(TFT_BLACK);
+    tft.setTextDatum(MC_DATUM);
+    tft.setTextSize(2);
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+    tft.drawString("Scale Service", SCREEN_WIDTH / 2, 15);
+
+    tft.setTextSize(DEFAULT_TEXT_SIZE);
+    snprintf(line, sizeof(line), "Factor: %.2f counts/g", scale_calibration.counts_per_kg / 1000.0f);
+    tft.drawString(line, SCREEN_WIDTH / 2, 45);
+    if (health_ok(Subsystem_Load_Cell)) {
+        snprintf(line, sizeof(line), "Load: %.1f g", mg_to_grams(weight_read_mg(5)));
+    } else {
+        snprintf(line, sizeof(line), "Load: n/a (load cell %s)",
+                 health_state_name(subsystem_health[Subsystem_Load_Cell].state));
+    }
+    tft.drawString(line, SCREEN_WIDTH / 2, 62);
+    if (session.active) {
+        snprintf(line, sizeof(line), "Points: %d  Fit: %.2f c/g  Lin: %.2f%%",
+                 session.point_count, session.counts_per_kg / 1000.0f, session.nonlinearity_percent);
+    } else {
+        snprintf(line, sizeof(line), "Press Tare with an empty platform to start");
+    }
+    tft.drawString(line, SCREEN_WIDTH / 2, 79);
+    tft.setTextColor(TFT_ORANGE, TFT_BLACK);
+    tft.drawString(service_status_message, SCREEN_WIDTH / 2, 100);
+
+    // Reference mass selector
+    int minus_x = SCREEN_WIDTH / 2 - 90;
+    int plus_x = SCREEN_WIDTH / 2 + 90 - SERVICE_MASS_BUTTON_SIZE;
+    tft.setTextSize(2);
+    tft.fillRect(minus_x, SERVICE_MASS_ROW_Y, SERVICE_MASS_BUTTON_SIZE, SERVICE_MASS_BUTTON_SIZE, TFT_DARKGREY);
+    tft.fillRect(plus_x, SERVICE_MASS_ROW_Y, SERVICE_MASS_BUTTON_SIZE, SERVICE_MASS_BUTTON_SIZE, TFT_DARKGREY);
+    tft.setTextColor(TFT_WHITE, TFT_DARKGREY);
+    tft.drawString("-", minus_x + SERVICE_MASS_BUTTON_SIZE / 2, SERVICE_MASS_ROW_Y + SERVICE_MASS_BUTTON_SIZE / 2);
+    tft.drawString("+", plus_x + SERVICE_MASS_BUTTON_SIZE / 2, SERVICE_MASS_ROW_Y + SERVICE_MASS_BUTTON_SIZE / 2);
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+    snprintf(line, sizeof(line), "%d g", service_reference_mass_g);
+    tft.drawString(line, SCREEN_WIDTH / 2, SERVICE_MASS_ROW_Y + SERVICE_MASS_BUTTON_SIZE / 2);
+
+    tft.setTextSize(DEFAULT_TEXT_SIZE);
+    draw_service_button(0, "Tare", TFT_BLUE);
+    draw_service_button(1, "Add point", session.active ? TFT_BLUE : TFT_DARKGREY);
+    draw_service_button(2, "Save", calibration_is_valid() ? TFT_GREEN : TFT_DARKGREY);
+    draw_service_button(3, "Back", TFT_RED);
+
+    uint16_t health_color = health_degraded() ? TFT_ORANGE : TFT_DARKGREY;
+    tft.fillRect(SERVICE_HEALTH_BUTTON_X, SERVICE_HEALTH_BUTTON_Y, SERVICE_HEALTH_BUTTON_WIDTH, SERVICE_HEALTH_BUTTON_HEIGHT, health_color);
+    tft.setTextColor(TFT_WHITE, health_color);
+    tft.drawString("Health", SERVICE_HEALTH_BUTTON_X + SERVICE_HEALTH_BUTTON_WIDTH / 2, SERVICE_HEALTH_BUTTON_Y + SERVICE_HEALTH_BUTTON_HEIGHT / 2);
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+}
+
+void handle_touch_service_screen(int x, int y) {
+    if (x >= SERVICE_HEALTH_BUTTON_X && y < SERVICE_HEALTH_BUTTON_Y + SERVICE_HEALTH_BUTTON_HEIGHT) {
+        calibration_cancel();
+        open_health_screen();
+        return;
+    }
+    int minus_x = SCREEN_WIDTH / 2 - 90;
+    int plus_x = SCREEN_WIDTH / 2 + 90 - SERVICE_MASS_BUTTON_SIZE;
+    if (y >= SERVICE_MASS_ROW_Y && y < SERVICE_MASS_ROW_Y + SERVICE_MASS_BUTTON_SIZE) {
+        if (x >= minus_x && x < minus_x + SERVICE_MASS_BUTTON_SIZE) {
+            service_reference_mass_g = max(SERVICE_MASS_STEP_G, service_reference_mass_g - SERVICE_MASS_STEP_G);
+        } else if (x >= plus_x && x < plus_x + SERVICE_MASS_BUTTON_SIZE) {
+            service_reference_mass_g += SERVICE_MASS_STEP_G;
+        }
+        draw_service_screen();
+        return;
+    }
+
+    if (y < SERVICE_BUTTON_Y || y > SERVICE_BUTTON_Y + SERVICE_BUTTON_HEIGHT) {
+        // Any other touch refreshes the live reading.
+        draw_service_screen();
+        return;
+    }
+
+    switch (x / SERVICE_BUTTON_WIDTH) {
+        case 0:
+            service_status_message = "Taring...";
+            draw_service_screen();
+            service_status_message = calibration_start() ? "Tared. Place mass, press Add point."
+                                                         : "Load cell not ready, see Health.";
+            break;
+        case 1:
+            service_status_message = "Reading...";
+            draw_service_screen();
+            service_status_message = calibration_add_point(service_reference_mass_g * MG_PER_GRAM)
+                                         ? "Point added. Add more to check linearity."
+                                         : "Point rejected.";
+            break;
+        case 2:
+            service_status_message = calibration_save() ? "Calibration saved." : "Needs 2 masses and a linear fit.";
+            break;
+        default:
+            calibration_cancel();
+            service_status_message = "";
+            return_to_main_menu();
+            return;
+    }
+    draw_service_screen();
+}
+
+void open_service_screen() {
+    service_status_message = "";
+    current_menu = Service;
+    draw_current_menu();
+}
+
+void draw_health_screen() {
+    char line[64];
+    tft.fillScreen(TFT_BLACK);
+    tft.setTextDatum(MC_DATUM);
+    tft.setTextSize(2);
+    tft.setTextColor(health_degraded() ? TFT_ORANGE : TFT_GREEN, TFT_BLACK);
+    tft.drawString(health_degraded() ? "Degraded mode" : "All systems ok", SCREEN_WIDTH / 2, 15);
+
+    tft.setTextSize(DEFAULT_TEXT_SIZE);
+    tft.setTextDatum(ML_DATUM);
+    for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+        const SubsystemHealth& health = subsystem_health[i];
+        uint16_t color = TFT_GREEN;
+        if (health.state == Health_Failed) color = TFT_RED;
+        else if (health.state != Health_Ok) color = TFT_ORANGE;
+        int y = HEALTH_ROW_Y + i * HEALTH_ROW_HEIGHT;
+        tft.setTextColor(TFT_WHITE, TFT_BLACK);
+        tft.drawString(health_subsystem_name((Subsystem)i), 10, y);
+        tft.setTextColor(color, TFT_BLACK);
+        tft.drawString(health_state_name(health.state), 100, y);
+        tft.setTextColor(TFT_LIGHTGREY, TFT_BLACK);
+        snprintf(line, sizeof(line), "%lu ms  %s", health.boot_ms, health.detail.c_str());
+        tft.drawString(line, 170, y);
+    }
+    tft.setTextDatum(MC_DATUM);
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+    snprintf(line, sizeof(line), "Boot: %lu ms", health_boot_total_ms());
+    tft.drawString(line, SCREEN_WIDTH / 2, HEALTH_ROW_Y + SUBSYSTEM_COUNT * HEALTH_ROW_HEIGHT);
+    tft.drawString("Tap to continue", SCREEN_WIDTH / 2, SCREEN_HEIGHT - 12);
+}
+
+void open_health_screen() {
+    current_menu = Health_Screen;
+    draw_current_menu();
+}
+
 void reset_menu_selection(){
   menu_1_selected_cocktail_tile = -1;
   deselect_preset_cocktail();
@@ -2,6 +2,7 @@
 #define MENU_H
 
 #include "cocktail_data.h"
+#include "machine_config.h"
 #include <SPI.h>
 #include <TFT_eSPI.h>
 #include <XPT2046_Touchscreen.h>
@@ -24,7 +25,9 @@ static const int SIDE_BUTTON_HEIGHT = SCREEN_HEIGHT / 4;
 static const int SIDE_MENU_TEXT_SIZE = 2;
 static const int SIDE_MENU_RECT_AMOUNT = 4;
 static const int DEFAULT_TEXT_SIZE = 1;
-static const int TABLE_DIMENSION = 3;
+static const int TABLE_DIMENSION = Machine::grid_dimension;
+static const int TILE_WIDTH = MAIN_WIDTH / TABLE_DIMENSION;
+static const int TILE_HEIGHT = SCREEN_HEIGHT / TABLE_DIMENSION;
 static const int CANCELLABLE_OP_TEXT_SIZE = 3;
 static const int CANCEL_BUTTON_SIZE = 40;
 static const int CANCEL_MENU_TEXT_CENTER_X = SCREEN_WIDTH / 2;
@@ -39,6 +42,35 @@ static const int QUICK_ORDER_BUTTON_WIDTH = 120;
 static const int QUICK_ORDER_BUTTON_HEIGHT = 50;
 static const int QUICK_ORDER_BUTTON_X = (SCREEN_WIDTH - QUICK_ORDER_BUTTON_WIDTH) / 2;
 static const int QUICK_ORDER_BUTTON_Y = (SCREEN_HEIGHT - QUICK_ORDER_BUTTON_HEIGHT) / 2;
+static const int SERVICE_BUTTON_COUNT = 4;
+static const int SERVICE_BUTTON_WIDTH = SCREEN_WIDTH / SERVICE_BUTTON_COUNT;
+static const int SERVICE_BUTTON_HEIGHT = 45;
+static const int SERVICE_BUTTON_Y = SCREEN_HEIGHT - SERVICE_BUTTON_HEIGHT - 10;
+static const int SERVICE_MASS_ROW_Y = 130;
+static const int SERVICE_MASS_BUTTON_SIZE = 36;
+static const int SERVICE_MASS_STEP_G = 50;
+static const int SERVICE_DEFAULT_MASS_G = 100;
+// Cancellable operation and error texts are copied into fixed buffers, so
+// showing them during an order does not touch the heap.
+static const int MENU_MESSAGE_CAPACITY = 64;
+static const int TILE_LINE_HEIGHT = 10;
+static const int TILE_SERVINGS_Y = TILE_HEIGHT - 16;
+// Ingredient lines that fit between a tile's name and its servings line.
+static const int TILE_INGREDIENT_LINES = (TILE_SERVINGS_Y - 10) / TILE_LINE_HEIGHT - 1;
+static const int CUSTOM_TILE_WIDTH = MAIN_WIDTH / Machine::custom_columns;
+static const int CUSTOM_TILE_HEIGHT = SCREEN_HEIGHT / Machine::custom_rows;
+static const int CUSTOM_BUTTON_SPACING = 10;
+static const int CUSTOM_BUTTON_FIT = (CUSTOM_TILE_WIDTH - CUSTOM_BUTTON_SPACING - 8) / 2;
+static const int CUSTOM_BUTTON_SIZE = CUSTOM_BUTTON_FIT < 40 ? CUSTOM_BUTTON_FIT : 40;
+static const int CUSTOM_TILE_TEXT_SIZE = CUSTOM_TILE_WIDTH >= MAIN_WIDTH / 2 ? 2 : 1;
+static const int LOW_SERVINGS_WARNING = 3;
+static const int SIDE_PAGE_LABEL_MARGIN = 12;
+static const int SERVICE_HEALTH_BUTTON_WIDTH = 60;
+static const int SERVICE_HEALTH_BUTTON_HEIGHT = 26;
+static const int SERVICE_HEALTH_BUTTON_X = SCREEN_WIDTH - SERVICE_HEALTH_BUTTON_WIDTH - 4;
+static const int SERVICE_HEALTH_BUTTON_Y = 2;
+static const int HEALTH_ROW_Y = 40;
+static const int HEALTH_ROW_HEIGHT = 16;
 
 
 
@@ -49,11 +81,16 @@ enum MenuState {
   Cancellable_Op,
   Error_Screen,
   Cocktail_More,
-  Quick
+  Quick,
+  Service,
+  Health_Screen
 };
 
 extern MenuState current_menu;
 extern int menu_1_selected_cocktail_tile;
+// Tapping "1" on menu 1 skips pages where nothing can be poured now. Off,
+// pages turn in order; set over BLE ({"skip_unmakeable":false}).
+extern bool skip_unmakeable_pages;
 
 /*
 Performs setup steps for screen
@@ -78,12 +115,12 @@ void check_and_handle_touch();
 /*
 initiates cancellable operation
 */
-void init_cancellable_op(String op_text);
+void init_cancellable_op(const char* op_text);
 
 /*
 Shows error message
 */
-void alert_error(String msg);
+void alert_error(const char* msg);
 
 /*
 Shows more cocktail options and data
@@ -93,10 +130,25 @@ void open_cocktail_more();
 /*
 Enters quick dispense mode
 */
-void enter_quick_mode(Cocktail cocktail);
+void enter_quick_mode(const Cocktail& cocktail);
+
+/*
+Opens the scale service (calibration) screen
+*/
+void open_service_screen();
+
+/*
+Shows the state and boot time of every subsystem (degraded mode screen)
+*/
+void open_health_screen();
 
 void reset_menu_selection();
 
+/*
+Redraws only the preset tiles whose availability changed since the last draw
+*/
+void redraw_availability_changes();
+
 void handle_touch(int x, int y);
 TS_Point* check_touch();
 void draw_side_menu();
@@ -114,5 +166,8 @@ void draw_cocktail_more_menu();
 void handle_touch_cocktail_extended_menu(int x, int y);
 void draw_quick_screen();
 void handle_touch_quick_screen(int x, int y);
+void draw_service_screen();
+void handle_touch_service_screen(int x, int y);
+void draw_health_screen();
 
 #endif
\ No newline at end of file
@@ -2,163 +2,439 @@
 #include "menu.h"
 #include "bluetooth.h"
 #include "cocktail_data.h"
+#include "calibration.h"
+#include "cup_detector.h"
+#include "pour_safety.h"
+#include "trace_recorder.h"
+#include "health.h"
+#include "order_history.h"
+#include "forecast.h"
+#include "order_journal.h"
+#include "alloc_track.h"
+
+void stop_all_motors() {
+  for (int motor = 0; motor < INGREDIENT_COUNT; motor++) {
+    digitalWrite(MOTOR_MAP[motor], LOW);
+  }
+}
 
 void setup_motors(){
 // Initialize motor control pins
-  pinMode(MOTOR1_PIN, OUTPUT);
-  pinMode(MOTOR2_PIN, OUTPUT);
-  pinMode(MOTOR3_PIN, OUTPUT);
-  pinMode(MOTOR4_PIN, OUTPUT);
+  for (int motor = 0; motor < INGREDIENT_COUNT; motor++) {
+    pinMode(MOTOR_MAP[motor], OUTPUT);
+  }
   
   // Start motors off
-  digitalWrite(MOTOR1_PIN, LOW);
-  digitalWrite(MOTOR2_PIN, LOW);
-  digitalWrite(MOTOR3_PIN, LOW);
-  digitalWrite(MOTOR4_PIN, LOW);
+  stop_all_motors();
 }
 
+SampleRate pour_sample_rate = Rate_80SPS;
+static AdcCupPresenceSensor light_sensor(LIGHT_SENSOR_PIN);
+OvershootStats overshoot_stats[2];
+unsigned long pour_inflight_ms = POUR_INFLIGHT_DEFAULT_MS;
+static PourFault last_pour_fault = Pour_Ok;
+// What reached the cup per ingredient; booked against the stock once the pumps are done.
+static weight_mg_t order_poured_mg[INGREDIENT_COUNT];
+
+static unsigned long load_cell_next_step_ms = 0;
+
 void setup_weight_sensor() {
-  scale.begin(LOADCELL_DOUT_PIN, LOADCELL_SCK_PIN);
-  scale.set_scale(CALIBRATION_FACTOR);
+  health_step_begin(Subsystem_Load_Cell);
+  weight_begin(LOADCELL_DOUT_PIN, LOADCELL_SCK_PIN, LOADCELL_RATE_PIN);
+  calibration_load_at_boot();
 
   Serial.println("Checking if HX711 is ready...");
-  while (!scale.is_ready()) {
+  if (scale.wait_ready_timeout(LOAD_CELL_READY_TIMEOUT_MS)) {
+    Serial.println("HX711 found. Taring shortly, remove any weight.");
+    load_cell_next_step_ms = millis() + LOAD_CELL_TARE_DELAY_MS;
+    health_step_end(Subsystem_Load_Cell, Health_Pending, "waiting to tare");
+  } else {
     Serial.println("HX711 not found.");
-    delay(1000);
+    load_cell_next_step_ms = millis() + LOAD_CELL_RETRY_MS;
+    health_step_end(Subsystem_Load_Cell, Health_Failed, "HX711 not responding");
   }
-  Serial.println("HX711 found.");
 
-  Serial.println("Taring... remove any weight.");
-  delay(3000);
-  scale.tare();  // Zero the scale
-  Serial.println("Tare complete.");
+  health_step_begin(Subsystem_Light_Sensor);
+  if (!cup_presence_setup(&light_sensor)) {
+    Serial.println("Light sensor unavailable, cup detection uses weight only.");
+    health_step_end(Subsystem_Light_Sensor, Health_Degraded, "weight-only cup detection");
+  } else {
+    health_step_end(Subsystem_Light_Sensor, Health_Ok);
+  }
 }
 
-bool wait_for_cup() {
-  const int stable_reads_required = 10;
-  const int delay_ms = 100;
-  const float delta_threshold = CUP_WEIGHT_THRESHOLD;
-  int stable_reads = 0;
+void poll_weight_sensor() {
+  unsigned long now = millis();
+  cup_presence_update(now);  // learns and follows the open light level
+  if ((long)(now - load_cell_next_step_ms) < 0) {
+    return;
+  }
+  switch (subsystem_health[Subsystem_Load_Cell].state) {
+    case Health_Pending:
+      calibration_boot_tare();  // Zero the scale
+      Serial.println("Tare complete.");
+      health_set(Subsystem_Load_Cell, Health_Ok);
+      break;
+    case Health_Failed:
+      load_cell_next_step_ms = now + LOAD_CELL_RETRY_MS;
+      if (scale.is_ready()) {
+        Serial.println("HX711 found. Taring shortly, remove any weight.");
+        load_cell_next_step_ms = now + LOAD_CELL_TARE_DELAY_MS;
+        health_set(Subsystem_Load_Cell, Health_Pending, "waiting to tare");
+      }
+      break;
+    default:
+      break;
+  }
+}
 
+static bool scale_lost_while_waiting() {
+  weight_set_sample_rate(Rate_10SPS);
+  alert_error("Scale not responding, see service screen.");
+  return false;
+}
+
+bool wait_for_cup() {
   init_cancellable_op("Please insert a cup.");
-  float baseline = scale.get_units(10);  // do NOT tare, just read average
+  unsigned long start_time = millis();
 
-  while (stable_reads < stable_reads_required) {
+  CupDetector detector;
+  // With the light sensor working, a fast rate lets the fused check
+  // confirm within a few samples; weight alone is steadier at 10 SPS.
+  bool has_optical = cup_presence_state() != Optical_Unknown;
+  weight_set_sample_rate(has_optical ? pour_sample_rate : Rate_10SPS);
+  weight_mg_t baseline;
+  if (!weight_read_mg_checked(weight_samples_for(POUR_BASELINE_WINDOW_MS), baseline)) {
+    return scale_lost_while_waiting();
+  }
+  cup_detector_reset(detector, baseline, weight_sample_period_ms());
+
+  while (true) {
     check_and_handle_touch();
     if (current_menu != Cancellable_Op) {
       Serial.println("CANCELLED");
+      weight_set_sample_rate(Rate_10SPS);
       return false;
     }
 
-    float weight = scale.get_units(10);
-    float delta = weight - baseline;
-
-    Serial.print("Insert cup, Δ: ");
-    Serial.println(delta);
-
-    if (delta >= delta_threshold) {
-      stable_reads++;
-    } else {
-      stable_reads = 0;
+    // One fresh conversion per iteration; the read blocks until it is ready.
+    weight_mg_t weight;
+    if (!weight_read_mg_checked(1, weight)) {
+      return scale_lost_while_waiting();
+    }
+    unsigned long now = millis();
+    cup_presence_update(now);
+    if (cup_detector_feed(detector, weight, now, cup_presence_state()) == Cup_Confirmed) {
+      break;
     }
-
-    delay(delay_ms);
   }
+  journal_cup_detected();
 
-  Serial.println("CUP DETECTED");
+  Serial.printf("CUP DETECTED: %.1f g, decision latency %lu ms, %lu ms since prompt, %d rejected steps, optical %s\n",
+                mg_to_grams(detector.cup_weight), detector.decision_latency_ms,
+                millis() - start_time, detector.rejected_steps, has_optical ? "on" : "off");
+  weight_set_sample_rate(Rate_10SPS);
   return true;
 }
 
 void notifyOnMissing(int ingredientIndex){
-  if (ingredients[ingredientIndex].amount_left <= 2*MINIMUM_INGREDIENT_AMOUNT_THRESHOLD){
-    send_push_notification(ingredientIndex);
+  // Warn while there is still time to swap the bottle at the current pace,
+  // and in any case once it is nearly empty. A forecast warning that reached
+  // no app is tried again after the next pour.
+  bool running_out = forecast_should_warn(ingredientIndex);
+  if (running_out || stock_ml(ingredients[ingredientIndex]) <= 2*MINIMUM_INGREDIENT_AMOUNT_THRESHOLD){
+    if (send_push_notification(ingredientIndex) && running_out) {
+      forecast_mark_warned(ingredientIndex);
+    }
   }
 }
 
 void pour_drink(Cocktail cocktail, CocktailSize size) {
   init_cancellable_op("Pouring cocktail...");
   delay(500);
-  Serial.printf("Starting to pour cocktail: '%s'\n", cocktail.name.c_str());
-  Serial.printf("Cocktail amount modified by: '%.3f'\n", PORTION_MAP[size]);
-  for(int ingredient = 0; ingredient < INGREDIENT_COUNT; ingredient++){
-    if (cocktail.amounts[ingredient] == 0 ){
-      continue;
+  Serial.printf("Starting to pour cocktail: '%s'\n", cocktail.name);
+  Serial.printf("Cocktail amount modified by: '%.3f'\n", PORTION_PERMILLE[size] / 1000.0f);
+  trace_order_start();
+  unsigned long pour_started = millis();
+  OrderState order_state = Completed;
+  bool attempted[INGREDIENT_COUNT] = {};
+  {
+    // Nothing below may allocate. Stock, history and pushes wait until every
+    // pump is done; the trace goes to the file trace_order_start() opened.
+    AllocScopeGuard order_scope(Alloc_Order);
+    for(int ingredient = 0; ingredient < INGREDIENT_COUNT && order_state == Completed; ingredient++){
+      if (cocktail.amounts[ingredient] == 0 ){
+        continue;
+      }
+
+      // Recipes are in ml; the scale weighs, so a syrup needs more mg per ml.
+      weight_mg_t curr_amount = ul_to_mg(ingredients[ingredient], cocktail.amounts[ingredient] * PORTION_PERMILLE[size]);
+      order_state = pour_ingredient(ingredient, curr_amount);
+      attempted[ingredient] = true;
+      weight_set_sample_rate(Rate_10SPS);
+      trace_flush();  // pumps are off until the next ingredient
     }
-    
-    float curr_amount = cocktail.amounts[ingredient] * PORTION_MAP[size];
-    OrderState op_state = pour_ingredient(ingredient, curr_amount);
+  }
+  for (int ingredient = 0; ingredient < INGREDIENT_COUNT; ingredient++) {
+    if (!attempted[ingredient]) continue;
+    update_ingredient_amount(ingredient, order_poured_mg[ingredient]);
     notifyOnMissing(ingredient);
-    switch (op_state) {
-    case Completed:
-      Serial.print("Ingredient poured succcessfully");
-      break;
-    case Cancelled:
-      Serial.println("CANCELLED");
-      update_stats_on_drink_order(cocktail, op_state);
-      return_to_main_menu();
-      return;
-    case Timeout:
-      Serial.println("Timeout Reached");
-      update_stats_on_drink_order(cocktail, op_state);
-      alert_error("Operation failed: pour timeout reached");
-      return;
-    }
   }
-  update_stats_on_drink_order(cocktail, Completed);
-  Serial.printf("Cocktail poured successfully");
-  return_to_main_menu();
+  trace_order_end(order_state);
+  journal_order_end(order_state);
+  history_record_order(order_state, millis() - pour_started);
+  update_stats_on_drink_order(cocktail, order_state);
+
+  switch (order_state) {
+  case Completed:
+    Serial.printf("Cocktail poured successfully");
+    return_to_main_menu();
+    break;
+  case Cancelled:
+    Serial.println("CANCELLED");
+    return_to_main_menu();
+    break;
+  case Timeout:
+    Serial.println("Timeout Reached");
+    alert_error("Operation failed: pour timeout reached");
+    break;
+  case Aborted: {
+    char message[64];
+    snprintf(message, sizeof(message), "Pour stopped: %s", pour_fault_name(last_pour_fault));
+    alert_error(message);
+    break;
+  }
+  }
 }
 
-static OrderState pour_ingredient(int motor_num, float target_weight){ 
+void serve_order(const Cocktail& cocktail, CocktailSize size) {
+  alloc_order_begin();
+  journal_order_start(cocktail, size);
+  bool cup_placed;
+  {
+    AllocScopeGuard order_scope(Alloc_Order);
+    cup_placed = wait_for_cup();
+  }
+  if (cup_placed) {
+    pour_drink(cocktail, size);
+  } else {
+    journal_order_end(Cancelled);
+  }
+  alloc_order_end();
+}
+
+static void log_overshoot(weight_mg_t overshoot) {
+  OvershootStats& rate_stats = overshoot_stats[pour_sample_rate];
+  rate_stats.pours++;
+  rate_stats.total_abs_overshoot_mg += abs(overshoot);
+  rate_stats.max_abs_overshoot_mg = max(rate_stats.max_abs_overshoot_mg, (weight_mg_t)abs(overshoot));
+  Serial.printf("Overshoot %.2f g at %d SPS (mean |%.2f| g, max %.2f g over %d pours)\n",
+                mg_to_grams(overshoot), pour_sample_rate == Rate_80SPS ? 80 : 10,
+                mg_to_grams(rate_stats.total_abs_overshoot_mg / rate_stats.pours),
+                mg_to_grams(rate_stats.max_abs_overshoot_mg), rate_stats.pours);
+}
+
+// Moves the in-flight estimate half way towards what this pour showed.
+static void learn_inflight(weight_mg_t overshoot, int32_t flow_at_stop) {
+  if (flow_at_stop < POUR_INFLIGHT_MIN_FLOW_MG_PER_S) {
+    return;
+  }
+  long observed_ms = (long)pour_inflight_ms + (long)((int64_t)overshoot * 1000 / flow_at_stop);
+  long learnt_ms = ((long)pour_inflight_ms + constrain(observed_ms, 0L, (long)POUR_INFLIGHT_MAX_MS)) / 2;
+  pour_inflight_ms = (unsigned long)learnt_ms;
+  Serial.printf("In-flight estimate: %lu ms\n", pour_inflight_ms);
+}
+
+struct PourFilter {
+  weight_mg_t window[POUR_FILTER_MAX_SAMPLES];
+  int64_t sum;
+  int length;
+  int next;
+};
+
+static weight_mg_t pour_filter_begin(PourFilter& filter, weight_mg_t first_sample, int length) {
+  filter.length = length;
+  filter.next = 0;
+  filter.sum = (int64_t)first_sample * length;
+  for (int i = 0; i < length; i++) {
+    filter.window[i] = first_sample;
+  }
+  return first_sample;
+}
+
+static weight_mg_t pour_filter_add(PourFilter& filter, weight_mg_t sample) {
+  filter.sum += sample - filter.window[filter.next];
+  filter.window[filter.next] = sample;
+  filter.next = (filter.next + 1) % filter.length;
+  return (weight_mg_t)(filter.sum / filter.length);
+}
+
+// Reads one raw sample, checks it and, if it passes, adds it to the filter.
+static PourFault read_checked_sample(PourSafety& safety, PourFilter& filter, weight_mg_t& filtered,
+                                     weight_mg_t& sample, unsigned long& sample_time) {
+  int32_t raw;
+  if (!weight_read_raw_checked(1, raw)) {
+    sample = filtered;
+    sample_time = millis();
+    return Pour_Sensor_Lost;
+  }
+  sample = weight_raw_to_mg(raw);
+  sample_time = millis();
+  trace_sample(raw);
+  PourFault fault = pour_safety_check(safety, sample, filtered, sample_time);
+  if (fault == Pour_Ok) {
+    filtered = pour_filter_add(filter, sample);
+  }
+  return fault;
+}
+
+// Stops every pump on a safety fault and books what reached the cup.
+static OrderState abort_pour(int motor_num, const PourSafety& safety, PourFault fault,
+                             weight_mg_t sample, weight_mg_t filtered, unsigned long sample_time) {
+  stop_all_motors();
+  last_pour_fault = fault;
+  unsigned long abort_latency = millis() - pour_safety_fault_since(safety, fault, sample_time);
+  trace_event(Trace_Abort, filtered, fault);
+  trace_event(Trace_Motor_Off, 0, motor_num);
+  Serial.printf("POUR ABORTED: %s (sample %.2f g, filtered %.2f g, base %.2f g), motors off %lu ms after the first bad sample\n",
+                pour_fault_name(fault), mg_to_grams(sample), mg_to_grams(filtered),
+                mg_to_grams(safety.base_weight), abort_latency);
+  // Account only for what was in the cup before the fault.
+  weight_mg_t poured = max((weight_mg_t)0, filtered - safety.base_weight);
+  trace_event(Trace_Pour_End, poured, Aborted);
+  journal_pour_stop(motor_num, poured);
+  order_poured_mg[motor_num] = poured;
+  return Aborted;
+}
+
+static OrderState pour_ingredient(int motor_num, weight_mg_t target_weight){ 
 
   //Logging base weight & starting motor
-  Serial.printf("Starting motor number: %d for target weight: %.2f\n", motor_num, target_weight);
-  float base_weight = scale.get_units(10);
-  Serial.printf("Base weight: %.2f\n", base_weight);
+  Serial.printf("Starting motor number: %d for target weight: %.2f\n", motor_num, mg_to_grams(target_weight));
+  weight_set_sample_rate(Rate_10SPS);  // low-noise baseline
+  weight_mg_t base_weight = 0;
+  bool base_ok = weight_read_mg_checked(weight_samples_for(POUR_BASELINE_WINDOW_MS), base_weight);
+  Serial.printf("Base weight: %.2f\n", mg_to_grams(base_weight));
+  trace_event(Trace_Pour_Start, target_weight, motor_num);
+  journal_pour_start(motor_num, target_weight);
+
+  // Filter length and stop lead follow the pour sample rate: the filtered
+  // weight lags by about half a filter window plus one sample, and what is
+  // in the hose still lands after the pump stops.
+  weight_set_sample_rate(pour_sample_rate);
+  const unsigned long sample_period_ms = weight_sample_period_ms();
+  const int filter_samples = min(weight_samples_for(POUR_FILTER_WINDOW_MS), POUR_FILTER_MAX_SAMPLES);
+  const unsigned long stop_lead_ms = sample_period_ms * (filter_samples + 2) / 2 + pour_inflight_ms;
+
+  PourSafety safety;
+  pour_safety_begin(safety, base_weight, target_weight);
+  weight_mg_t first_sample = base_weight;
+  if (!base_ok || !weight_read_mg_checked(1, first_sample)) {
+    return abort_pour(motor_num, safety, Pour_Sensor_Lost, base_weight, base_weight, millis());
+  }
+
+  // Moving average over the last filter_samples raw samples.
+  PourFilter filter;
+  weight_mg_t curr_weight = pour_filter_begin(filter, first_sample, filter_samples);
   digitalWrite(MOTOR_MAP[motor_num], HIGH);
+  trace_event(Trace_Motor_On, 0, motor_num);
 
+  unsigned long last_progress_time = millis();
+  weight_mg_t last_progress_weight = curr_weight;
+  int32_t flow_mg_per_s = 0;
+  int sample_count = 0;
+  //While target (minus what is already in flight) not reached
+  while (curr_weight + flow_mg_per_s * (int32_t)stop_lead_ms / 1000 < base_weight + target_weight) {
+    //Safety check on every raw sample
+    weight_mg_t prev_weight = curr_weight;
+    weight_mg_t sample;
+    unsigned long sample_time;
+    PourFault fault = read_checked_sample(safety, filter, curr_weight, sample, sample_time);
+    if (fault != Pour_Ok) {
+      return abort_pour(motor_num, safety, fault, sample, curr_weight, sample_time);
+    }
+    int32_t instant_flow = (int32_t)((int64_t)(curr_weight - prev_weight) * 1000 / (int32_t)sample_period_ms);
+    flow_mg_per_s = max((int32_t)0, (flow_mg_per_s * 7 + instant_flow) / 8);
 
-  float prev_weight = base_weight;
-  int times_unchanged = 0;
-  float curr_weight = scale.get_units(5);
-  //While target not reached
-  while (curr_weight < base_weight + target_weight) {
-    Serial.printf("Current overall weight: %.2f\n", scale.get_units(5));
+    if (++sample_count % filter_samples == 0) {
+      Serial.printf("Current overall weight: %.2f\n", mg_to_grams(curr_weight));
+    }
 
     //Check if cancelled
     check_and_handle_touch();
     if (current_menu != Cancellable_Op){
       digitalWrite(MOTOR_MAP[motor_num], LOW);
-      update_ingredient_amount(motor_num, curr_weight - base_weight);
+      trace_event(Trace_Motor_Off, 0, motor_num);
+      trace_event(Trace_Pour_End, curr_weight - base_weight, Cancelled);
+      journal_pour_stop(motor_num, curr_weight - base_weight);
+      order_poured_mg[motor_num] = curr_weight - base_weight;
       Serial.println("Cancelled in pour_ingredient");
       return Cancelled;
     }
 
-    //Timeout check
-    bool is_weight_changed = (abs(curr_weight - prev_weight) < WEIGHT_CHANGE_DETECTION_THRESHOLD);
-    Serial.printf("Weight change check: prev=%.2f, curr=%.2f, times_unchanged=%d\n", prev_weight, curr_weight, times_unchanged);
-    times_unchanged =  is_weight_changed ? times_unchanged + 1 : 0;
-    if (times_unchanged >= TIMES_UNCHANGED_FOR_TIMEOUT) {
+    //Timeout check: the weight has to keep rising
+    if (curr_weight - last_progress_weight >= WEIGHT_CHANGE_DETECTION_THRESHOLD_MG) {
+      last_progress_weight = curr_weight;
+      last_progress_time = sample_time;
+    } else if (sample_time - last_progress_time >= POUR_STALL_TIMEOUT_MS) {
+      Serial.printf("No progress for %lu ms at %.2f g\n", sample_time - last_progress_time, mg_to_grams(curr_weight));
       digitalWrite(MOTOR_MAP[motor_num], LOW);
-      update_ingredient_amount(motor_num, curr_weight - base_weight);
+      trace_event(Trace_Motor_Off, 0, motor_num);
+      trace_event(Trace_Pour_End, curr_weight - base_weight, Timeout);
+      journal_pour_stop(motor_num, curr_weight - base_weight);
+      order_poured_mg[motor_num] = curr_weight - base_weight;
       return Timeout;
     }
-    
-    prev_weight = curr_weight;//is_weight_changed ? curr_weight : prev_weight;
-    delay(100);
-    curr_weight = scale.get_units(5);
   }
 
   //target reached
   digitalWrite(MOTOR_MAP[motor_num], LOW);
+  trace_event(Trace_Stop_Decision, curr_weight, (int16_t)(flow_mg_per_s / MG_PER_GRAM));
+  trace_event(Trace_Motor_Off, 0, motor_num);
   Serial.println("Target reached. Motor stopped.");
-  update_ingredient_amount(motor_num, scale.get_units(5) - base_weight);
+
+  // The checks keep running while the hose drains and the weight settles, at
+  // the pour rate: a pump that does not stop (stuck driver, siphoning bottle)
+  // never settles and soon runs past the limit.
+  unsigned long drain_end = millis() + pour_inflight_ms + POUR_FILTER_WINDOW_MS;
+  weight_mg_t sample;
+  unsigned long sample_time;
+  while ((long)(millis() - drain_end) < 0) {
+    PourFault fault = read_checked_sample(safety, filter, curr_weight, sample, sample_time);
+    if (fault != Pour_Ok) {
+      return abort_pour(motor_num, safety, fault, sample, curr_weight, sample_time);
+    }
+  }
+
+  // Settled once two baseline windows in a row agree.
+  const int settle_samples = weight_samples_for(POUR_BASELINE_WINDOW_MS);
+  const unsigned long settle_start = millis();
+  weight_mg_t settled = curr_weight;
+  bool is_settled = false;
+  for (int window = 0; !is_settled && millis() - settle_start < POUR_SETTLE_TIMEOUT_MS; window++) {
+    int64_t settle_sum = 0;
+    for (int i = 0; i < settle_samples; i++) {
+      PourFault fault = read_checked_sample(safety, filter, curr_weight, sample, sample_time);
+      if (fault != Pour_Ok) {
+        return abort_pour(motor_num, safety, fault, sample, curr_weight, sample_time);
+      }
+      settle_sum += sample;
+    }
+    weight_mg_t window_weight = (weight_mg_t)(settle_sum / settle_samples);
+    is_settled = window > 0 && abs(window_weight - settled) < WEIGHT_CHANGE_DETECTION_THRESHOLD_MG;
+    settled = window_weight;
+  }
+  weight_mg_t poured = settled - base_weight;
+  log_overshoot(poured - target_weight);
+  learn_inflight(poured - target_weight, flow_mg_per_s);
+  trace_event(Trace_Pour_End, poured, Completed);
+  journal_pour_stop(motor_num, poured);
+  order_poured_mg[motor_num] = poured;
   return Completed;
 }
 
-
 void pour_until_stopped(int motor_num){
-  if(motor_num == -1){
+  if(motor_num < 0 || motor_num >= INGREDIENT_COUNT){
     Serial.println("pour_until_stopped index not valid");
     return;
   }
@@ -1,39 +1,85 @@
 #ifndef MOTORS_SENSORS_H
 #define MOTORS_SENSORS_H
 
-#include "HX711.h"
 #include "cocktail_data.h"
+#include "weight.h"
 #include "menu.h"
 
-//MOTORs
-const int MOTOR1_PIN = 18; // change
-const int MOTOR2_PIN = 19; // change
-const int MOTOR3_PIN = 22; // change
-const int MOTOR4_PIN = 27; 
-const int MOTOR_MAP[4] = {MOTOR1_PIN, MOTOR2_PIN, MOTOR3_PIN, MOTOR4_PIN};
-const float PORTION_MAP[3] = {0.75, 1, 1.25};
+//MOTORs, one per pump (MACHINE_MOTOR_PINS in machine_config.h)
+const int MOTOR_MAP[] = {MACHINE_MOTOR_PINS};
+static_assert(sizeof(MOTOR_MAP) / sizeof(MOTOR_MAP[0]) == INGREDIENT_COUNT, "need one motor pin per pump");
 // HX711 circuit wiring
 const int LOADCELL_DOUT_PIN = 4;
 const int LOADCELL_SCK_PIN = 5;
+const int LOADCELL_RATE_PIN = 23; // change
 
-const float CUP_WEIGHT_THRESHOLD = 1.2;
-const float BASE_WEIGHT_POSSIBLE_ERROR = 2;
-const float TIMES_UNCHANGED_FOR_TIMEOUT = 45;
-const float WEIGHT_CHANGE_DETECTION_THRESHOLD = 0.8;
+// Load cell bring-up: how long to wait for a first conversion, how long to
+// leave for emptying the platform before the boot tare, and how often to look
+// for a load cell that was missing at boot.
+const unsigned long LOAD_CELL_READY_TIMEOUT_MS = 1000;
+const unsigned long LOAD_CELL_TARE_DELAY_MS = 3000;
+const unsigned long LOAD_CELL_RETRY_MS = 5000;
 
-const float CALIBRATION_FACTOR = 93000/132;
+const weight_mg_t BASE_WEIGHT_POSSIBLE_ERROR_MG = 2000;
+const unsigned long POUR_STALL_TIMEOUT_MS = 20000;
+const weight_mg_t WEIGHT_CHANGE_DETECTION_THRESHOLD_MG = 800;
+// Averaging windows, converted to sample counts at the active rate.
+const unsigned long POUR_BASELINE_WINDOW_MS = 300;
+const unsigned long POUR_FILTER_WINDOW_MS = 100;
+const int POUR_FILTER_MAX_SAMPLES = 16;
+// Longest wait for the weight to settle after a pump stops.
+const unsigned long POUR_SETTLE_TIMEOUT_MS = 3000;
+// Liquid still in the hose or falling when a pump stops, as time at the
+// current flow. Starts at a typical hose and is learnt from the settled
+// overshoot of each completed pour; slow pours tell too little to learn from.
+const unsigned long POUR_INFLIGHT_DEFAULT_MS = 150;
+const unsigned long POUR_INFLIGHT_MAX_MS = 1000;
+const int32_t POUR_INFLIGHT_MIN_FLOW_MG_PER_S = 2000;
 
-static HX711 scale;
+struct OvershootStats {
+  int pours = 0;
+  weight_mg_t total_abs_overshoot_mg = 0;
+  weight_mg_t max_abs_overshoot_mg = 0;
+};
+
+// Rate used while a pump runs; idle, cup detection and baselines use 10 SPS.
+extern SampleRate pour_sample_rate;
+// Indexed by SampleRate, to compare pours at both rates.
+extern OvershootStats overshoot_stats[2];
+extern unsigned long pour_inflight_ms;
 
 void setup_motors();
 
+/*
+Turns every pump off at once (used on safety aborts).
+*/
+void stop_all_motors();
+
+/*
+Starts the load cell and light sensor without blocking on either: the boot
+tare runs later from poll_weight_sensor(), and a missing load cell is
+reported in the health table instead of stopping the boot.
+*/
 void setup_weight_sensor();
 
+/*
+Finishes load cell bring-up (deferred tare), retries a missing load cell and
+polls the light sensor. Call from loop().
+*/
+void poll_weight_sensor();
+
 bool wait_for_cup();
 
 void pour_drink(Cocktail cocktail, CocktailSize size);
 
-static OrderState pour_ingredient(int motor_num, float weight);
+/*
+Runs a placed order: waits for the cup, pours and books it. Only cup
+detection and pumping count against Alloc_Order; the flash and BLE work
+around them runs outside it.
+*/
+void serve_order(const Cocktail& cocktail, CocktailSize size);
+
+static OrderState pour_ingredient(int motor_num, weight_mg_t target_weight);
 
 void pour_until_stopped(int motor_num);
 
@@ -0,0 +1,251 @@
+#include "order_history.h"
+#include <FS.h>
+#include <LittleFS.h>
+#include <stddef.h>
+#include "alloc_track.h"
+#include "filesystem.h"
+
+static const uint32_t HISTORY_MAGIC = 0x31485348;  // "HSH1"
+static const uint16_t HISTORY_VERSION = 1;
+// The clock is moved forward well before millis() wraps.
+static const unsigned long CLOCK_REBASE_MS = 24UL * 60 * 60 * 1000;
+// Without any history and no clock from the app, time starts one hour after
+// 1970 so no bucket starts at 0, which marks an empty slot.
+static const uint32_t UNSET_CLOCK_START_S = HISTORY_HOURLY_BUCKET_S;
+
+struct __attribute__((packed)) HistoryFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t ingredient_count;
+  uint8_t bucket_size;
+  uint32_t bucket_seconds;
+  uint32_t capacity;
+  uint32_t latest;  // time of the newest write, to resume the clock after a reboot
+};
+
+struct TierState {
+  const char* path;
+  uint32_t bucket_seconds;
+  uint32_t capacity;
+  bool ready;
+  bool dirty;        // open bucket changed since it was last written
+  OrderBucket open;  // the bucket orders currently go to
+};
+
+static TierState tiers[HISTORY_TIER_COUNT] = {
+  { "/history_5m.bin", HISTORY_FINE_BUCKET_S, HISTORY_FINE_BUCKETS, false, false, {} },
+  { "/history_1h.bin", HISTORY_HOURLY_BUCKET_S, HISTORY_HOURLY_BUCKETS, false, false, {} },
+};
+
+static uint32_t clock_base_s = UNSET_CLOCK_START_S;
+static unsigned long clock_base_ms = 0;
+static bool clock_was_set = false;
+
+uint32_t history_now() {
+  unsigned long elapsed = millis() - clock_base_ms;
+  if (elapsed >= CLOCK_REBASE_MS) {
+    clock_base_s += elapsed / 1000;
+    clock_base_ms += elapsed / 1000 * 1000;
+    elapsed %= 1000;
+  }
+  return clock_base_s + elapsed / 1000;
+}
+
+bool history_clock_set() {
+  return clock_was_set;
+}
+
+void history_set_clock(uint32_t epoch_s) {
+  if (epoch_s < UNSET_CLOCK_START_S) return;
+  Serial.printf("Clock set: %lu (was %lu)\n", (unsigned long)epoch_s, (unsigned long)history_now());
+  clock_base_s = epoch_s;
+  clock_base_ms = millis();
+  clock_was_set = true;
+}
+
+uint32_t history_bucket_seconds(HistoryTier tier) {
+  return tiers[tier].bucket_seconds;
+}
+
+static HistoryFileHeader expected_header(const TierState& tier) {
+  HistoryFileHeader header = {};
+  header.magic = HISTORY_MAGIC;
+  header.version = HISTORY_VERSION;
+  header.ingredient_count = INGREDIENT_COUNT;
+  header.bucket_size = sizeof(OrderBucket);
+  header.bucket_seconds = tier.bucket_seconds;
+  header.capacity = tier.capacity;
+  return header;
+}
+
+static size_t slot_offset(const TierState& tier, uint32_t start) {
+  return sizeof(HistoryFileHeader) + (size_t)((start / tier.bucket_seconds) % tier.capacity) * sizeof(OrderBucket);
+}
+
+// Returns the newest time written to the file, 0 for a new file.
+static uint32_t open_tier(TierState& tier) {
+  HistoryFileHeader expected = expected_header(tier);
+  if (LittleFS.exists(tier.path)) {
+    fs::File file = LittleFS.open(tier.path, "r");
+    HistoryFileHeader stored;
+    bool valid = file && file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored)
+                 && stored.magic == expected.magic && stored.version == expected.version
+                 && stored.ingredient_count == expected.ingredient_count && stored.bucket_size == expected.bucket_size
+                 && stored.bucket_seconds == expected.bucket_seconds && stored.capacity == expected.capacity
+                 && file.size() == sizeof(stored) + (size_t)tier.capacity * sizeof(OrderBucket);
+    if (file) file.close();
+    if (valid) {
+      tier.ready = true;
+      return stored.latest;
+    }
+    Serial.printf("History file %s does not match this build, starting over.\n", tier.path);
+  }
+
+  fs::File file = LittleFS.open(tier.path, "w");
+  if (!file) return 0;
+  bool written = file.write((const uint8_t*)&expected, sizeof(expected)) == sizeof(expected);
+  OrderBucket empty[16] = {};
+  for (uint32_t slot = 0; slot < tier.capacity && written; slot += 16) {
+    size_t count = min((uint32_t)16, tier.capacity - slot);
+    written = file.write((const uint8_t*)empty, count * sizeof(OrderBucket)) == count * sizeof(OrderBucket);
+  }
+  file.close();
+  tier.ready = written;
+  return 0;
+}
+
+static void write_back(TierState& tier) {
+  FlashWriteTimer write_timer;
+  fs::File file = LittleFS.open(tier.path, "r+");
+  if (!file) {
+    Serial.printf("History write to %s failed.\n", tier.path);
+    return;
+  }
+  uint32_t latest = history_now();
+  file.seek(slot_offset(tier, tier.open.start), SeekSet);
+  file.write((const uint8_t*)&tier.open, sizeof(tier.open));
+  file.seek(offsetof(HistoryFileHeader, latest), SeekSet);
+  file.write((const uint8_t*)&latest, sizeof(latest));
+  file.close();
+  tier.dirty = false;
+}
+
+// Makes `start` the open bucket, continuing it if its slot already holds it
+// (e.g. after a reboot within the bucket). What the outgoing bucket gained
+// since its last write (ml of a pour that crossed the boundary) is written
+// back first.
+static void open_bucket(TierState& tier, uint32_t start) {
+  if (tier.open.start == start) return;
+  AllocScopeGuard alloc_scope(Alloc_Storage);
+  if (tier.dirty) write_back(tier);
+  memset(&tier.open, 0, sizeof(tier.open));
+  fs::File file = LittleFS.open(tier.path, "r");
+  if (file) {
+    OrderBucket stored;
+    if (file.seek(slot_offset(tier, start), SeekSet) && file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored)
+        && stored.start == start) {
+      tier.open = stored;
+    }
+    file.close();
+  }
+  tier.open.start = start;
+}
+
+static OrderBucket& current_bucket(TierState& tier) {
+  uint32_t now = history_now();
+  open_bucket(tier, now - now % tier.bucket_seconds);
+  return tier.open;
+}
+
+// Orders or poured ml: a bucket can hold the start of a pour whose order
+// ended in the next one.
+static bool has_data(const OrderBucket& bucket) {
+  for (int i = 0; i < ORDER_OUTCOME_COUNT; i++) {
+    if (bucket.outcomes[i] != 0) return true;
+  }
+  for (int i = 0; i < INGREDIENT_COUNT; i++) {
+    if (bucket.poured_ml[i] != 0) return true;
+  }
+  return false;
+}
+
+static uint16_t add_saturating(uint16_t counter, uint32_t amount) {
+  return (uint16_t)min((uint32_t)0xFFFF, counter + amount);
+}
+
+bool history_begin() {
+  uint32_t latest = 0;
+  bool ready = true;
+  for (int i = 0; i < HISTORY_TIER_COUNT; i++) {
+    latest = max(latest, open_tier(tiers[i]));
+    ready = ready && tiers[i].ready;
+  }
+  if (!clock_was_set && latest > clock_base_s) {
+    clock_base_s = latest;
+    clock_base_ms = millis();
+  }
+  for (int i = 0; i < HISTORY_TIER_COUNT; i++) {
+    if (tiers[i].ready) current_bucket(tiers[i]);
+  }
+  Serial.printf("Order history ready, clock at %lu (%s)\n", (unsigned long)history_now(),
+                clock_was_set ? "set" : "estimated");
+  return ready;
+}
+
+void history_add_poured(int ingredient_index, float ml) {
+  uint32_t amount = ml > 0 ? (uint32_t)lroundf(ml) : 0;
+  if (amount == 0) return;
+  for (int i = 0; i < HISTORY_TIER_COUNT; i++) {
+    if (!tiers[i].ready) continue;
+    OrderBucket& bucket = current_bucket(tiers[i]);
+    bucket.poured_ml[ingredient_index] = add_saturating(bucket.poured_ml[ingredient_index], amount);
+    tiers[i].dirty = true;
+  }
+}
+
+void history_record_order(OrderState state, unsigned long pour_ms) {
+  AllocScopeGuard alloc_scope(Alloc_Storage);
+  for (int i = 0; i < HISTORY_TIER_COUNT; i++) {
+    if (!tiers[i].ready) continue;
+    OrderBucket& bucket = current_bucket(tiers[i]);
+    bucket.outcomes[state] = add_saturating(bucket.outcomes[state], 1);
+    bucket.pour_ms += pour_ms;
+    write_back(tiers[i]);
+  }
+}
+
+int history_read(HistoryTier tier_id, uint32_t from, uint32_t to, OrderBucket out[], int max_buckets, uint32_t& next) {
+  next = 0;
+  TierState& tier = tiers[tier_id];
+  if (!tier.ready || max_buckets <= 0 || from >= to) return 0;
+
+  // Only the last `capacity` buckets can still be in the ring.
+  uint32_t seconds = tier.bucket_seconds;
+  uint32_t now = history_now();
+  uint64_t newest = now - now % seconds;
+  uint64_t oldest = newest >= (uint64_t)(tier.capacity - 1) * seconds ? newest - (uint64_t)(tier.capacity - 1) * seconds : 0;
+  uint64_t start = ((uint64_t)from + seconds - 1) / seconds * seconds;
+  if (start < oldest) start = oldest;
+
+  fs::File file = LittleFS.open(tier.path, "r");
+  if (!file) return 0;
+  int count = 0;
+  for (uint32_t steps = 0; start < to && steps < tier.capacity; start += seconds, steps++) {
+    if (count == max_buckets) {
+      next = (uint32_t)start;
+      break;
+    }
+    if (start == tier.open.start) {
+      // Poured amounts of an order still running are not on flash yet.
+      out[count] = tier.open;
+    } else if (!file.seek(slot_offset(tier, (uint32_t)start), SeekSet)
+               || file.read((uint8_t*)&out[count], sizeof(OrderBucket)) != sizeof(OrderBucket)) {
+      break;
+    }
+    if (out[count].start == start && has_data(out[count])) {
+      count++;
+    }
+  }
+  file.close();
+  return count;
+}
@@ -0,0 +1,70 @@
+#ifndef ORDER_HISTORY_H
+#define ORDER_HISTORY_H
+
+#include "cocktail_data.h"
+
+// Orders over time, for staffing and restocking: per time bucket the orders
+// by outcome, the ml poured of each ingredient and the time spent pouring.
+// Stats keeps the lifetime totals; this keeps when they happened.
+//
+// Each tier is a ring file of fixed-size buckets addressed by time: the slot
+// of a bucket is (start / bucket length) % capacity, and a slot only counts
+// for a bucket if its start matches. Only the open bucket of each tier is in
+// RAM; it is written back to its slot after every order.
+
+enum HistoryTier {
+  History_Fine,    // 5-minute buckets for 48 hours
+  History_Hourly,  // hourly buckets for 60 days
+  HISTORY_TIER_COUNT
+};
+
+const uint32_t HISTORY_FINE_BUCKET_S = 5 * 60;
+const int HISTORY_FINE_BUCKETS = 48 * 12;
+const uint32_t HISTORY_HOURLY_BUCKET_S = 60 * 60;
+const int HISTORY_HOURLY_BUCKETS = 60 * 24;
+
+const int ORDER_OUTCOME_COUNT = Aborted + 1;  // indexed by OrderState
+
+struct __attribute__((packed)) OrderBucket {
+  uint32_t start;                           // seconds since 1970, 0 for an empty slot
+  uint16_t outcomes[ORDER_OUTCOME_COUNT];
+  uint16_t poured_ml[INGREDIENT_COUNT];
+  uint32_t pour_ms;                         // summed over the orders, for the mean
+};
+
+/*
+Opens or creates the ring files and resumes the open buckets. Returns false
+if they cannot be created; orders are then not recorded.
+*/
+bool history_begin();
+
+/*
+Seconds since 1970. Set by the app with history_set_clock(); until then it
+continues from the newest bucket on flash, so a reboot without the app
+shifts the buckets by the time the machine was off.
+*/
+uint32_t history_now();
+bool history_clock_set();
+void history_set_clock(uint32_t epoch_s);
+
+/*
+Adds poured ml of an ingredient to the open buckets.
+update_ingredient_amount() calls this.
+*/
+void history_add_poured(int ingredient_index, float ml);
+
+/*
+Counts a finished order and writes the open buckets back to flash.
+*/
+void history_record_order(OrderState state, unsigned long pour_ms);
+
+uint32_t history_bucket_seconds(HistoryTier tier);
+
+/*
+Copies the non-empty buckets of `tier` starting in [from, to) into `out`,
+oldest first, at most `max_buckets`. `next` is set to where a following
+read should continue, or 0 if the range was exhausted.
+*/
+int history_read(HistoryTier tier, uint32_t from, uint32_t to, OrderBucket out[], int max_buckets, uint32_t& next);
+
+#endif
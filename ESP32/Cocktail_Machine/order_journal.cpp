@@ -0,0 +1,196 @@
+#include "order_journal.h"
+#include <FS.h>
+#include <LittleFS.h>
+#include "order_history.h"
+#include "alloc_track.h"
+#include "filesystem.h"
+
+static const char* JOURNAL_PATH = "/journal.bin";
+
+struct __attribute__((packed)) JournalFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t capacity;
+  uint32_t total_written;  // records ever written; slot = index % capacity
+};
+
+static JournalFileHeader file_header;
+static bool journal_ready = false;
+
+static JournalRecord current;
+static unsigned long placed_ms = 0;
+static OrderSource placed_source = Source_Menu;
+static uint32_t placed_s = 0;
+
+// Export cursor
+static bool exporting = false;
+static bool export_header_sent = false;
+static uint32_t export_next = 0;
+static uint32_t export_end = 0;
+
+static void reset_header() {
+  memset(&file_header, 0, sizeof(file_header));
+  file_header.magic = JOURNAL_MAGIC;
+  file_header.version = JOURNAL_VERSION;
+  file_header.record_size = sizeof(JournalRecord);
+  file_header.capacity = JOURNAL_FILE_RECORDS;
+}
+
+static size_t record_position(uint32_t index) {
+  return sizeof(JournalFileHeader) + (size_t)(index % file_header.capacity) * sizeof(JournalRecord);
+}
+
+bool journal_begin() {
+  reset_header();
+  if (LittleFS.exists(JOURNAL_PATH)) {
+    fs::File file = LittleFS.open(JOURNAL_PATH, "r");
+    JournalFileHeader stored;
+    bool valid = file && file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored)
+                 && stored.magic == JOURNAL_MAGIC && stored.version == JOURNAL_VERSION
+                 && stored.record_size == sizeof(JournalRecord) && stored.capacity == JOURNAL_FILE_RECORDS;
+    if (file) file.close();
+    if (valid) {
+      file_header = stored;
+      journal_ready = true;
+      Serial.printf("Order journal: %lu orders\n", (unsigned long)stored.total_written);
+      return true;
+    }
+  }
+
+  fs::File file = LittleFS.open(JOURNAL_PATH, "w");
+  if (!file) {
+    Serial.println("Order journal could not be created, journal disabled.");
+    return false;
+  }
+  file.write((const uint8_t*)&file_header, sizeof(file_header));
+  file.close();
+  journal_ready = true;
+  return true;
+}
+
+static uint32_t since_placed() {
+  // Never 0, which marks a step that was not reached.
+  return max(1UL, millis() - placed_ms);
+}
+
+void journal_order_placed(OrderSource source) {
+  placed_ms = millis();
+  placed_s = history_now();
+  placed_source = source;
+}
+
+void journal_order_start(const Cocktail& cocktail, CocktailSize size) {
+  memset(&current, 0, sizeof(current));
+  current.order.order_id = file_header.total_written + 1;
+  current.order.placed_s = placed_s;
+  current.order.recipe_id = cocktail.id;
+  current.order.size = size;
+  current.order.source = placed_source;
+}
+
+void journal_cup_detected() {
+  current.order.cup_detected_ms = since_placed();
+}
+
+void journal_pour_start(int ingredient_index, int32_t target_mg) {
+  current.pours[ingredient_index].start_ms = since_placed();
+  current.pours[ingredient_index].target_mg = target_mg;
+}
+
+void journal_pour_stop(int ingredient_index, int32_t actual_mg) {
+  current.pours[ingredient_index].stop_ms = since_placed();
+  current.pours[ingredient_index].actual_mg = actual_mg;
+}
+
+void journal_order_end(OrderState state) {
+  current.order.outcome = state;
+  current.order.done_ms = since_placed();
+  Serial.printf("Order %lu: cup after %lu ms, done after %lu ms\n", (unsigned long)current.order.order_id,
+                (unsigned long)current.order.cup_detected_ms, (unsigned long)current.order.done_ms);
+  if (!journal_ready) return;
+
+  AllocScopeGuard alloc_scope(Alloc_Storage);
+  FlashWriteTimer write_timer;
+  fs::File file = LittleFS.open(JOURNAL_PATH, "r+");
+  if (!file) {
+    Serial.println("Journal write failed.");
+    return;
+  }
+  file.seek(record_position(file_header.total_written), SeekSet);
+  file.write((const uint8_t*)&current, sizeof(current));
+  file_header.total_written++;
+  file.seek(0, SeekSet);
+  file.write((const uint8_t*)&file_header, sizeof(file_header));
+  file.close();
+}
+
+static uint32_t oldest_retained() {
+  uint32_t total = file_header.total_written;
+  return total > file_header.capacity ? total - file_header.capacity : 0;
+}
+
+void journal_start_export() {
+  if (!journal_ready) return;
+  exporting = true;
+  export_header_sent = false;
+  export_next = oldest_retained();
+  export_end = file_header.total_written;
+}
+
+bool journal_export_active() {
+  return exporting;
+}
+
+size_t journal_next_chunk(uint8_t* out, size_t max_length) {
+  if (!exporting) return 0;
+  size_t length = 0;
+  if (!export_header_sent) {
+    JournalDumpHeader header = {};
+    header.magic = JOURNAL_MAGIC;
+    header.version = JOURNAL_VERSION;
+    header.record_size = sizeof(JournalRecord);
+    header.pump_count = INGREDIENT_COUNT;
+    header.record_count = export_end - export_next;
+    memcpy(out, &header, sizeof(header));
+    length = sizeof(header);
+    export_header_sent = true;
+  }
+
+  fs::File file = LittleFS.open(JOURNAL_PATH, "r");
+  if (!file) {
+    exporting = false;
+    return length;
+  }
+  while (export_next < export_end && length + sizeof(JournalRecord) <= max_length) {
+    file.seek(record_position(export_next), SeekSet);
+    if (file.read(out + length, sizeof(JournalRecord)) != sizeof(JournalRecord)) {
+      export_next = export_end;
+      break;
+    }
+    length += sizeof(JournalRecord);
+    export_next++;
+  }
+  file.close();
+  if (export_next >= export_end) {
+    exporting = false;
+  }
+  return length;
+}
+
+void journal_export_serial() {
+  uint8_t chunk[JOURNAL_BLE_CHUNK];
+  char hex[3];
+  journal_start_export();
+  Serial.printf("JOURNAL BEGIN %lu\n", (unsigned long)(export_end - export_next));
+  while (journal_export_active()) {
+    size_t length = journal_next_chunk(chunk, sizeof(chunk));
+    Serial.print("J:");
+    for (size_t i = 0; i < length; i++) {
+      snprintf(hex, sizeof(hex), "%02x", chunk[i]);
+      Serial.print(hex);
+    }
+    Serial.println();
+  }
+  Serial.println("JOURNAL END");
+}
@@ -0,0 +1,59 @@
+#ifndef ORDER_JOURNAL_H
+#define ORDER_JOURNAL_H
+
+#include <Arduino.h>
+#include "journal_format.h"
+#include "cocktail_data.h"
+
+// One record per order with the time each step took and what each pump
+// poured against its target. The record is filled in RAM while the order
+// runs and written once when it ends, into a circular file on LittleFS.
+const uint32_t JOURNAL_FILE_RECORDS = 512;
+
+struct __attribute__((packed)) JournalRecord {
+  JournalOrder order;
+  JournalPour pours[INGREDIENT_COUNT];
+};
+
+// Bytes of dump per BLE notification; records are not split, so the first
+// chunk must hold the dump header and a record.
+const size_t JOURNAL_BLE_CHUNK = sizeof(JournalDumpHeader) + sizeof(JournalRecord) > 180
+                                     ? sizeof(JournalDumpHeader) + sizeof(JournalRecord) : 180;
+
+/*
+Opens (or creates) the journal file. Call after the filesystem is mounted.
+Returns false if the journal is disabled.
+*/
+bool journal_begin();
+
+/*
+Call when an order is placed (order_pending set); its times count from here.
+*/
+void journal_order_placed(OrderSource source);
+
+/*
+Call when the placed order is taken up for pouring.
+*/
+void journal_order_start(const Cocktail& cocktail, CocktailSize size);
+void journal_cup_detected();
+void journal_pour_start(int ingredient_index, int32_t target_mg);
+void journal_pour_stop(int ingredient_index, int32_t actual_mg);
+
+/*
+Completes the record and appends it to the file.
+*/
+void journal_order_end(OrderState state);
+
+/*
+Prints the retained records as "J:<hex>" lines between JOURNAL BEGIN/END.
+*/
+void journal_export_serial();
+
+/*
+Starts a BLE export; journal_next_chunk() then yields the dump piece by piece.
+*/
+void journal_start_export();
+bool journal_export_active();
+size_t journal_next_chunk(uint8_t* buffer, size_t max_length);
+
+#endif
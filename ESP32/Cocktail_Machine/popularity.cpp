@@ -0,0 +1,197 @@
+#include "popularity.h"
+
+// Forward-decayed scores: an order at time t adds 2^((t - landmark) / half
+// life). Older orders never need updating, and scores of different recipes
+// stay comparable, so only the ordered recipe can change rank.
+static float scores[PRESET_COCKTAIL_COUNT];
+// Recipe of each slot as the scores know it, and slots whose score is still
+// to be seeded from the order count.
+static recipe_id_t slot_ids[PRESET_COCKTAIL_COUNT];
+static bool unseeded[PRESET_COCKTAIL_COUNT];
+static unsigned long landmark_ms = 0;
+// Weight of an order made before boot: stored order counts are taken as if
+// every order happened at boot, which keeps them comparable after a rescale.
+static float seed_weight = 1;
+
+struct KeptScore {
+  recipe_id_t id;  // RECIPE_ID_NONE for a free entry
+  float score;
+};
+static KeptScore kept[POPULARITY_KEPT_SCORES];
+// Recipe IDs, most popular first.
+static recipe_id_t top_ids[TOP_COCKTAIL_COUNT];
+static int top_count = 0;
+
+static float score_of(recipe_id_t id) {
+  int slot = find_preset(id);
+  return slot >= 0 ? scores[slot] : 0;
+}
+
+static float order_weight(unsigned long now_ms) {
+  if (POPULARITY_HALF_LIFE_MS == 0) return 1;
+  float weight = exp2f((float)(now_ms - landmark_ms) / POPULARITY_HALF_LIFE_MS);
+  if (weight > POPULARITY_RESCALE_WEIGHT) {
+    // Scaling every score by the same factor keeps the ranking.
+    for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+      scores[i] /= weight;
+    }
+    for (int i = 0; i < POPULARITY_KEPT_SCORES; i++) {
+      kept[i].score /= weight;
+    }
+    seed_weight /= weight;
+    landmark_ms = now_ms;
+    weight = 1;
+  }
+  return weight;
+}
+
+// Moves preset `slot` into or up the top list after its score grew. Returns
+// true if the list changed.
+static bool update_top(int slot) {
+  recipe_id_t id = preset_cocktails[slot].id;
+  if (id == RECIPE_ID_NONE) return false;
+
+  int pos = -1;
+  bool entered = false;
+  for (int i = 0; i < top_count; i++) {
+    if (top_ids[i] == id) {
+      pos = i;
+      break;
+    }
+  }
+  if (pos < 0) {
+    if (top_count < TOP_COCKTAIL_COUNT) {
+      pos = top_count++;
+    } else if (scores[slot] > score_of(top_ids[TOP_COCKTAIL_COUNT - 1])) {
+      pos = TOP_COCKTAIL_COUNT - 1;
+    } else {
+      return false;
+    }
+    top_ids[pos] = id;
+    entered = true;
+  }
+
+  bool moved = false;
+  while (pos > 0 && scores[slot] > score_of(top_ids[pos - 1])) {
+    top_ids[pos] = top_ids[pos - 1];
+    top_ids[pos - 1] = id;
+    pos--;
+    moved = true;
+  }
+  return moved || entered;
+}
+
+static void seed(int slot) {
+  scores[slot] = stats.preset_order_counts[slot].count * seed_weight;
+  unseeded[slot] = false;
+}
+
+// Remembers the score of a recipe leaving the page. When the table is full
+// the lowest score makes room.
+static void keep_score(recipe_id_t id, float score) {
+  if (id == RECIPE_ID_NONE) return;
+  int entry = -1;
+  for (int i = 0; i < POPULARITY_KEPT_SCORES && entry < 0; i++) {
+    if (kept[i].id == id) entry = i;
+  }
+  for (int i = 0; i < POPULARITY_KEPT_SCORES && entry < 0; i++) {
+    if (kept[i].id == RECIPE_ID_NONE) entry = i;
+  }
+  if (entry < 0) {
+    entry = 0;
+    for (int i = 1; i < POPULARITY_KEPT_SCORES; i++) {
+      if (kept[i].score < kept[entry].score) entry = i;
+    }
+    if (kept[entry].score >= score) return;
+  }
+  kept[entry] = { id, score };
+}
+
+static bool take_kept_score(recipe_id_t id, float& score) {
+  if (id == RECIPE_ID_NONE) return false;
+  for (int i = 0; i < POPULARITY_KEPT_SCORES; i++) {
+    if (kept[i].id == id) {
+      score = kept[i].score;
+      kept[i].id = RECIPE_ID_NONE;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void rebuild_top() {
+  top_count = 0;
+  for (int slot = 0; slot < PRESET_COCKTAIL_COUNT; slot++) {
+    update_top(slot);
+  }
+}
+
+static void log_top() {
+  Serial.println("Top ordered cocktails:");
+  for (int i = 0; i < top_count; i++) {
+    int slot = find_preset(top_ids[i]);
+    Serial.printf("  %d. %s - score %.2f\n", i + 1, preset_cocktails[slot].name, scores[slot]);
+  }
+}
+
+void popularity_rebuild() {
+  landmark_ms = millis();
+  seed_weight = 1;
+  for (int i = 0; i < POPULARITY_KEPT_SCORES; i++) {
+    kept[i].id = RECIPE_ID_NONE;
+  }
+  for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+    slot_ids[i] = preset_cocktails[i].id;
+    seed(i);
+  }
+  rebuild_top();
+  log_top();
+}
+
+void popularity_page_loaded() {
+  for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+    if (unseeded[i]) seed(i);
+  }
+  rebuild_top();
+  log_top();
+}
+
+void popularity_record_order(int slot, unsigned long now_ms) {
+  if (slot < 0 || slot >= PRESET_COCKTAIL_COUNT) return;
+  if (unseeded[slot]) seed(slot);
+  scores[slot] += order_weight(now_ms);
+  if (update_top(slot)) {
+    log_top();
+  }
+}
+
+void popularity_presets_moved(const int old_slots[PRESET_COCKTAIL_COUNT]) {
+  float previous[PRESET_COCKTAIL_COUNT];
+  bool previous_unseeded[PRESET_COCKTAIL_COUNT];
+  bool stays[PRESET_COCKTAIL_COUNT] = {};
+  memcpy(previous, scores, sizeof(previous));
+  memcpy(previous_unseeded, unseeded, sizeof(previous_unseeded));
+  for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+    if (old_slots[i] >= 0) stays[old_slots[i]] = true;
+  }
+  // Recipes leaving the page take their scores along.
+  for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+    if (!stays[i] && !previous_unseeded[i]) keep_score(slot_ids[i], previous[i]);
+  }
+  for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+    slot_ids[i] = preset_cocktails[i].id;
+    if (old_slots[i] >= 0) {
+      scores[i] = previous[old_slots[i]];
+      unseeded[i] = previous_unseeded[old_slots[i]];
+    } else {
+      unseeded[i] = !take_kept_score(slot_ids[i], scores[i]);
+      if (unseeded[i]) scores[i] = 0;
+    }
+  }
+  rebuild_top();
+}
+
+int top_recipe_slot(int rank) {
+  if (rank < 0 || rank >= top_count) return -1;
+  return find_preset(top_ids[rank]);
+}
@@ -0,0 +1,47 @@
+#ifndef POPULARITY_H
+#define POPULARITY_H
+
+#include "cocktail_data.h"
+
+// Orders count double after this long, so menu 3 follows tonight's demand
+// rather than all-time totals. 0 ranks by plain order counts.
+const unsigned long POPULARITY_HALF_LIFE_MS = 2UL * 60 * 60 * 1000;
+// Scores are rescaled before order weights grow past this.
+const float POPULARITY_RESCALE_WEIGHT = 1048576.0f;
+// Scores of recipes on other pages kept in RAM, by recipe ID. A recipe
+// pushed out of here is seeded from its order count again when its page is
+// next loaded, losing only the decay since boot.
+const int POPULARITY_KEPT_SCORES = 4 * PRESET_COCKTAIL_COUNT;
+
+/*
+Seeds every preset's score from its order count and rebuilds the top list.
+Call once at boot, when the presets and stats are loaded.
+*/
+void popularity_rebuild();
+
+/*
+Call after a library page was loaded and its order counts are in stats:
+recipes seen earlier get back their decayed scores, the others are seeded
+from their order counts. The top list ranks the loaded page.
+*/
+void popularity_page_loaded();
+
+/*
+Adds an order of preset `slot` at `now_ms` and moves it up the top list.
+O(TOP_COCKTAIL_COUNT).
+*/
+void popularity_record_order(int slot, unsigned long now_ms);
+
+/*
+Call when the presets changed: `old_slots[i]` is the slot preset i had
+before, or -1 for a recipe new to the page. Scores follow their recipes,
+also to and from other pages.
+*/
+void popularity_presets_moved(const int old_slots[PRESET_COCKTAIL_COUNT]);
+
+/*
+Preset slot at `rank` (0 = most popular), or -1 if fewer recipes exist.
+*/
+int top_recipe_slot(int rank);
+
+#endif
@@ -0,0 +1,47 @@
+#include "pour_safety.h"
+
+void pour_safety_begin(PourSafety& safety, weight_mg_t base_weight, weight_mg_t target_weight) {
+  safety.base_weight = base_weight;
+  safety.runaway_limit = base_weight + target_weight + max(POUR_RUNAWAY_MARGIN_MG, target_weight / 5);
+  safety.over_limit_samples = 0;
+  safety.over_limit_since_ms = 0;
+}
+
+PourFault pour_safety_check(PourSafety& safety, weight_mg_t sample, weight_mg_t filtered, unsigned long now_ms) {
+  if (sample <= safety.runaway_limit) {
+    safety.over_limit_samples = 0;
+  } else if (safety.over_limit_samples++ == 0) {
+    safety.over_limit_since_ms = now_ms;
+  }
+  if (sample < safety.base_weight - POUR_REMOVAL_DROP_MG) {
+    return Pour_Cup_Removed;
+  }
+  if (sample < filtered - POUR_SPILL_DROP_MG) {
+    return Pour_Spill;
+  }
+  if (sample > filtered + POUR_SURGE_MG) {
+    return Pour_Surge;
+  }
+  if (safety.over_limit_samples >= POUR_RUNAWAY_SAMPLES) {
+    return Pour_Runaway;
+  }
+  return Pour_Ok;
+}
+
+unsigned long pour_safety_fault_since(const PourSafety& safety, PourFault fault, unsigned long sample_ms) {
+  if (fault == Pour_Runaway) {
+    return safety.over_limit_since_ms;
+  }
+  return sample_ms;
+}
+
+const char* pour_fault_name(PourFault fault) {
+  switch (fault) {
+    case Pour_Cup_Removed: return "cup removed";
+    case Pour_Spill: return "cup lifted or spilled";
+    case Pour_Surge: return "platform pressed";
+    case Pour_Runaway: return "pour running away";
+    case Pour_Sensor_Lost: return "scale not responding";
+    default: return "ok";
+  }
+}
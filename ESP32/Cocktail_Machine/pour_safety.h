@@ -0,0 +1,59 @@
+#ifndef POUR_SAFETY_H
+#define POUR_SAFETY_H
+
+#include <Arduino.h>
+#include "weight.h"
+
+// A raw sample this far under the cup-only baseline means the cup is gone.
+const weight_mg_t POUR_REMOVAL_DROP_MG = 1000;
+// A raw sample this far under the filtered weight means the cup was lifted
+// (or tipped) with liquid already in it.
+const weight_mg_t POUR_SPILL_DROP_MG = 5000;
+// A raw sample this far over the filtered weight is a hand on the cup, not liquid.
+const weight_mg_t POUR_SURGE_MG = 15000;
+// Over-target margin before a pour counts as running away (pump not stopping,
+// cup overflowing). At least this much or a fifth of the target.
+const weight_mg_t POUR_RUNAWAY_MARGIN_MG = 5000;
+// Consecutive raw samples over the runaway limit that abort: the second one
+// confirms the first was not a noise spike, one sample period later.
+const int POUR_RUNAWAY_SAMPLES = 2;
+
+enum PourFault {
+  Pour_Ok,
+  Pour_Cup_Removed,
+  Pour_Spill,
+  Pour_Surge,
+  Pour_Runaway,
+  Pour_Sensor_Lost  // the HX711 stopped delivering conversions
+};
+
+struct PourSafety {
+  weight_mg_t base_weight;
+  weight_mg_t runaway_limit;
+  // Raw samples in a row over runaway_limit, and the time of the first of them.
+  int over_limit_samples;
+  unsigned long over_limit_since_ms;
+};
+
+/*
+Prepares the checks for one ingredient poured on top of `base_weight`.
+*/
+void pour_safety_begin(PourSafety& safety, weight_mg_t base_weight, weight_mg_t target_weight);
+
+/*
+Checks one raw (unfiltered) sample, taken at `now_ms`, against the filtered
+weight so far. Runs on every sample, including while the hose drains after
+the pump is switched off, so a fault is caught within one sample period.
+A runaway is POUR_RUNAWAY_SAMPLES raw samples in a row over the limit.
+*/
+PourFault pour_safety_check(PourSafety& safety, weight_mg_t sample, weight_mg_t filtered, unsigned long now_ms);
+
+/*
+When the condition behind `fault` was first seen: the first raw sample over
+the limit for a runaway, otherwise the faulting sample itself.
+*/
+unsigned long pour_safety_fault_since(const PourSafety& safety, PourFault fault, unsigned long sample_ms);
+
+const char* pour_fault_name(PourFault fault);
+
+#endif
@@ -0,0 +1,506 @@
+#include "recipe_store.h"
+#include <FS.h>
+#include <LittleFS.h>
+#include <stddef.h>
+#include <algorithm>
+#include <new>
+#include "filesystem.h"
+#include "popularity.h"
+#include "makeable.h"
+#include "alloc_track.h"
+
+static const char RECIPE_STORE_PATH[] = "/recipes.bin";
+static const char RECIPE_STORE_TEMP_PATH[] = "/recipes.tmp";
+static const char RECIPE_STORE_SET_ASIDE_PATH[] = "/recipes.old";
+static const uint32_t RECIPE_STORE_MAGIC = 0x31504352;  // "RCP1"
+static const uint16_t RECIPE_STORE_VERSION = 1;
+static const uint16_t NO_NAME = 0xFFFF;
+// Name offsets count 2-byte units and names are padded to an even length, so
+// 16 bits reach the last name of a full library.
+static const uint32_t NAME_UNIT = 2;
+static_assert((RECIPE_STORE_MAX_COUNT - 1) * (uint32_t)COCKTAIL_NAME_CAPACITY / NAME_UNIT < NO_NAME,
+              "a full library's name offsets must fit in 16 bits");
+// Postings read per flash access when walking a posting list.
+static const int POSTING_READ_CHUNK = 32;
+
+// File layout: the header, one fixed-size record per position in display
+// order, the ID table sorted by ID (empty positions have no entry), the
+// posting lists, then the NUL-terminated names padded to an even length. A
+// page is one contiguous run of records, and a name is one seek away from its
+// record. A file of another version or pump count is not read: the library
+// is set aside and imported again.
+// The posting lists start with their lengths, one per ingredient, followed by
+// each ingredient's list of recipes using it, sorted by amount.
+struct StoreHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;       // positions
+    uint16_t id_count;    // entries in the ID table
+    uint16_t ingredient_count;  // amounts per record
+    uint32_t ids_offset;
+    uint32_t names_offset;
+    // IDs are handed out from here and never reused, so a deleted recipe's
+    // stats and scores cannot pass to a new one.
+    uint16_t next_id;
+    uint16_t reserved;
+};
+
+struct StoreRecord {
+    recipe_id_t id;        // RECIPE_ID_NONE for an empty slot
+    uint16_t name_offset;  // into the name block, NO_NAME for an empty slot
+    uint16_t amounts[INGREDIENT_COUNT];
+    uint32_t orders;
+};
+
+struct StoreIdEntry {
+    recipe_id_t id;
+    uint16_t position;
+};
+
+static StoreHeader header = {};
+static int current_page = 0;
+static recipe_id_t max_id = RECIPE_ID_NONE;
+static recipe_id_t next_id = 1;
+// Order counts of the loaded page as stored, so paging only writes back the
+// ones that changed.
+static uint32_t stored_orders[RECIPE_PAGE_SIZE] = {};
+static uint16_t posting_counts[INGREDIENT_COUNT] = {};
+static uint32_t posting_offsets[INGREDIENT_COUNT] = {};
+
+static uint32_t record_offset(int position) {
+    return sizeof(StoreHeader) + (uint32_t)position * sizeof(StoreRecord);
+}
+
+// Bytes `name` takes in the name block: terminator and padding included.
+static size_t stored_name_length(const char* name) {
+    return (strlen(name) + NAME_UNIT) / NAME_UNIT * NAME_UNIT;
+}
+
+static bool read_at(fs::File& file, uint32_t offset, void* data, size_t length) {
+    return file.seek(offset) && file.read((uint8_t*)data, length) == length;
+}
+
+static bool write_all(fs::File& file, const void* data, size_t length) {
+    return file.write((const uint8_t*)data, length) == length;
+}
+
+static bool read_header(fs::File& file, StoreHeader& out) {
+    out = {};
+    bool valid = read_at(file, 0, &out, sizeof(out))
+        && out.magic == RECIPE_STORE_MAGIC
+        && out.version == RECIPE_STORE_VERSION
+        && out.count <= RECIPE_STORE_MAX_COUNT
+        && out.id_count <= out.count
+        && out.ingredient_count == INGREDIENT_COUNT
+        && out.ids_offset == record_offset(out.count);
+    if (!valid) return false;
+
+    uint32_t postings_offset = out.ids_offset + out.id_count * sizeof(StoreIdEntry);
+    for (int i = 0; i < INGREDIENT_COUNT; i++) {
+        posting_counts[i] = 0;
+    }
+    if (!read_at(file, postings_offset, posting_counts, sizeof(posting_counts))) return false;
+    uint32_t offset = postings_offset + sizeof(posting_counts);
+    for (int i = 0; i < INGREDIENT_COUNT; i++) {
+        posting_offsets[i] = offset;
+        offset += posting_counts[i] * sizeof(RecipePosting);
+    }
+    return out.names_offset == offset;
+}
+
+// `name` holds COCKTAIL_NAME_CAPACITY bytes.
+static void read_name(fs::File& file, const StoreRecord& record, char* name) {
+    size_t length = 0;
+    if (record.name_offset != NO_NAME && file.seek(header.names_offset + record.name_offset * NAME_UNIT)) {
+        length = file.read((uint8_t*)name, COCKTAIL_NAME_CAPACITY - 1);
+    }
+    name[length] = '\0';  // stored names are NUL-terminated and already fit
+}
+
+static Cocktail to_cocktail(fs::File& file, const StoreRecord& record) {
+    Cocktail cocktail = {};
+    if (record.id == RECIPE_ID_NONE) return cocktail;
+    cocktail.id = record.id;
+    read_name(file, record, cocktail.name);
+    for (int i = 0; i < INGREDIENT_COUNT; i++) {
+        cocktail.amounts[i] = record.amounts[i];
+    }
+    return cocktail;
+}
+
+int recipe_store_count() {
+    return header.count;
+}
+
+int recipe_store_page_count() {
+    return max(1, (header.count + RECIPE_PAGE_SIZE - 1) / RECIPE_PAGE_SIZE);
+}
+
+int recipe_store_current_page() {
+    return current_page;
+}
+
+recipe_id_t recipe_store_take_id(recipe_id_t above) {
+    if (above >= next_id) next_id = above + 1;
+    if (next_id > RECIPE_ID_MAX_PRESET) return RECIPE_ID_NONE;
+    return next_id++;
+}
+
+static void write_back_orders() {
+    int first = current_page * RECIPE_PAGE_SIZE;
+    if (first >= header.count) return;
+    AllocScopeGuard alloc_scope(Alloc_Storage);
+    FlashWriteTimer write_timer;
+    fs::File file;
+    for (int i = 0; i < RECIPE_PAGE_SIZE && first + i < header.count; i++) {
+        const RecipeOrderCount& entry = stats.preset_order_counts[i];
+        uint32_t orders = entry.count;
+        if (entry.id == RECIPE_ID_NONE || orders == stored_orders[i]) continue;
+        if (!file) {
+            file = LittleFS.open(RECIPE_STORE_PATH, "r+");
+            if (!file) return;
+        }
+        // Counts are patched in place; the record does not move.
+        if (file.seek(record_offset(first + i) + offsetof(StoreRecord, orders)) && write_all(file, &orders, sizeof(orders))) {
+            stored_orders[i] = orders;
+        }
+    }
+    if (file) file.close();
+}
+
+bool recipe_store_load_page(int page) {
+    // One page past the end is an empty page for adding recipes.
+    if (page < 0 || page * RECIPE_PAGE_SIZE > header.count) return false;
+
+    // Before reading, so no other handle is open on the file meanwhile.
+    write_back_orders();
+
+    StoreRecord records[RECIPE_PAGE_SIZE] = {};
+    int first = page * RECIPE_PAGE_SIZE;
+    int loaded = min(RECIPE_PAGE_SIZE, header.count - first);
+    fs::File file;
+    if (loaded > 0) {
+        file = LittleFS.open(RECIPE_STORE_PATH, "r");
+        if (!file || !read_at(file, record_offset(first), records, loaded * sizeof(StoreRecord))) {
+            Serial.printf("Reading recipe page %d failed\n", page + 1);
+            if (file) file.close();
+            return false;
+        }
+    }
+
+    for (int i = 0; i < RECIPE_PAGE_SIZE; i++) {
+        preset_cocktails[i] = to_cocktail(file, records[i]);
+    }
+    if (file) file.close();
+    current_page = page;
+
+    update_recipe_index();
+    for (int i = 0; i < RECIPE_PAGE_SIZE; i++) {
+        stored_orders[i] = records[i].orders;
+        stats.preset_order_counts[i].count = records[i].orders;
+    }
+    popularity_page_loaded();
+    Serial.printf("Loaded recipe page %d/%d\n", page + 1, recipe_store_page_count());
+    return true;
+}
+
+static int find_position(fs::File& file, recipe_id_t id) {
+    int low = 0;
+    int high = header.id_count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        StoreIdEntry entry;
+        if (!read_at(file, header.ids_offset + mid * sizeof(StoreIdEntry), &entry, sizeof(entry))) break;
+        if (entry.id == id) {
+            return entry.position;
+        }
+        if (entry.id < id) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+int recipe_store_position(recipe_id_t id) {
+    if (id == RECIPE_ID_NONE || header.id_count == 0) return -1;
+    fs::File file = LittleFS.open(RECIPE_STORE_PATH, "r");
+    if (!file) return -1;
+    int position = find_position(file, id);
+    file.close();
+    return position;
+}
+
+recipe_id_t recipe_store_id_at(int position) {
+    if (position < 0 || position >= header.count) return RECIPE_ID_NONE;
+    fs::File file = LittleFS.open(RECIPE_STORE_PATH, "r");
+    if (!file) return RECIPE_ID_NONE;
+    StoreRecord record;
+    bool found = read_at(file, record_offset(position), &record, sizeof(record));
+    file.close();
+    return found ? record.id : RECIPE_ID_NONE;
+}
+
+bool recipe_store_visit_postings(int ingredient, int min_amount, int max_amount, PostingVisitor visit, void* context) {
+    int count = posting_counts[ingredient];
+    if (count == 0 || max_amount <= min_amount) return true;
+    fs::File file = LittleFS.open(RECIPE_STORE_PATH, "r");
+    if (!file) return false;
+
+    // First posting with an amount above min_amount.
+    int low = 0;
+    int high = count;
+    bool ok = true;
+    while (ok && low < high) {
+        int mid = (low + high) / 2;
+        RecipePosting posting;
+        ok = read_at(file, posting_offsets[ingredient] + mid * sizeof(RecipePosting), &posting, sizeof(posting));
+        if (posting.amount > min_amount) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    RecipePosting chunk[POSTING_READ_CHUNK];
+    bool done = false;
+    for (int index = low; ok && !done && index < count; index += POSTING_READ_CHUNK) {
+        int length = min(POSTING_READ_CHUNK, count - index);
+        ok = read_at(file, posting_offsets[ingredient] + index * sizeof(RecipePosting), chunk, length * sizeof(RecipePosting));
+        for (int i = 0; ok && i < length; i++) {
+            if (chunk[i].amount > max_amount) {
+                done = true;
+                break;
+            }
+            visit(chunk[i], context);
+        }
+    }
+    file.close();
+    return ok;
+}
+
+// Record and name (if `name` is given) at `position` while the library is
+// rewritten: slots of the loaded page come from RAM, everything else from the
+// old file.
+static bool source_record(fs::File& old_file, int position, StoreRecord& record, char* name = nullptr) {
+    int slot = position - current_page * RECIPE_PAGE_SIZE;
+    record = {};
+    if (name) name[0] = '\0';
+    if (slot >= 0 && slot < RECIPE_PAGE_SIZE) {
+        const Cocktail& preset = preset_cocktails[slot];
+        if (preset.name[0] == '\0') return true;  // empty slot
+        record.id = preset.id;
+        for (int i = 0; i < INGREDIENT_COUNT; i++) {
+            record.amounts[i] = constrain(preset.amounts[i], 0, 0xFFFF);
+        }
+        if (stats.preset_order_counts[slot].id == preset.id) {
+            record.orders = stats.preset_order_counts[slot].count;
+        }
+        if (name) strcpy(name, preset.name);
+        return true;
+    }
+    if (!read_at(old_file, record_offset(position), &record, sizeof(record))) return false;
+    if (name) read_name(old_file, record, name);
+    return true;
+}
+
+static bool write_postings(fs::File& file, fs::File& old_file, int count, int ingredient, int users) {
+    if (users == 0) return true;
+    // Sorting needs the whole list at once; it is only held while saving.
+    RecipePosting* postings = new (std::nothrow) RecipePosting[users];
+    if (!postings) return false;
+    int listed = 0;
+    bool ok = true;
+    for (int position = 0; ok && position < count; position++) {
+        StoreRecord record;
+        ok = source_record(old_file, position, record);
+        if (ok && record.id != RECIPE_ID_NONE && record.amounts[ingredient] != 0 && listed < users) {
+            postings[listed++] = { record.amounts[ingredient], (uint16_t)position };
+        }
+    }
+    std::sort(postings, postings + listed, [](const RecipePosting& a, const RecipePosting& b) {
+        return a.amount < b.amount;
+    });
+    ok = ok && listed == users && write_all(file, postings, listed * sizeof(RecipePosting));
+    delete[] postings;
+    return ok;
+}
+
+static bool write_page_ids(fs::File& file, const StoreIdEntry entries[], int& next, int count, recipe_id_t below, StoreHeader& out) {
+    while (next < count && entries[next].id < below) {
+        if (!write_all(file, &entries[next], sizeof(StoreIdEntry))) return false;
+        max_id = max(max_id, entries[next].id);
+        out.id_count++;
+        next++;
+    }
+    return true;
+}
+
+bool recipe_store_save_page() {
+    AllocScopeGuard alloc_scope(Alloc_Storage);
+    FlashWriteTimer write_timer;
+    int first = current_page * RECIPE_PAGE_SIZE;
+    int used = 0;  // slots up to the last named one
+    for (int i = 0; i < RECIPE_PAGE_SIZE; i++) {
+        if (preset_cocktails[i].name[0] != '\0') used = i + 1;
+    }
+    // Only the last page may shrink; gaps elsewhere stay as empty slots.
+    int count = header.count > first + RECIPE_PAGE_SIZE ? header.count : first + used;
+    if (count > RECIPE_STORE_MAX_COUNT) {
+        Serial.println("Recipe library is full");
+        return false;
+    }
+
+    // The library is rewritten into a temporary file in streaming passes
+    // (records, ID table, posting lists, names), so apart from sorting one
+    // posting list RAM use does not depend on its size, then swapped in by
+    // rename.
+    fs::File old_file = LittleFS.open(RECIPE_STORE_PATH, "r");
+    fs::File file = LittleFS.open(RECIPE_STORE_TEMP_PATH, "w");
+    if (!file) {
+        if (old_file) old_file.close();
+        return false;
+    }
+
+    StoreHeader out = { RECIPE_STORE_MAGIC, RECIPE_STORE_VERSION, (uint16_t)count, 0, INGREDIENT_COUNT, 0, 0, RECIPE_ID_NONE, 0 };
+    out.ids_offset = record_offset(count);
+    bool ok = write_all(file, &out, sizeof(out));
+
+    uint32_t names_size = 0;
+    uint16_t users[INGREDIENT_COUNT] = {};
+    for (int position = 0; ok && position < count; position++) {
+        StoreRecord record;
+        char name[COCKTAIL_NAME_CAPACITY];
+        ok = source_record(old_file, position, record, name);
+        record.name_offset = NO_NAME;
+        if (record.id != RECIPE_ID_NONE) {
+            ok = ok && names_size / NAME_UNIT < NO_NAME;
+            record.name_offset = names_size / NAME_UNIT;
+            names_size += stored_name_length(name);
+            for (int i = 0; i < INGREDIENT_COUNT; i++) {
+                if (record.amounts[i] != 0) users[i]++;
+            }
+        }
+        ok = ok && write_all(file, &record, sizeof(record));
+    }
+
+    // ID table: the old one without the page's positions, merged with the
+    // page's recipes sorted by ID.
+    StoreIdEntry page_ids[RECIPE_PAGE_SIZE];
+    int page_id_count = 0;
+    for (int slot = 0; slot < RECIPE_PAGE_SIZE && first + slot < count; slot++) {
+        if (preset_cocktails[slot].name[0] == '\0') continue;
+        StoreIdEntry entry = { preset_cocktails[slot].id, (uint16_t)(first + slot) };
+        int j = page_id_count++;
+        for (; j > 0 && page_ids[j - 1].id > entry.id; j--) {
+            page_ids[j] = page_ids[j - 1];
+        }
+        page_ids[j] = entry;
+    }
+    recipe_id_t previous_max_id = max_id;
+    max_id = RECIPE_ID_NONE;
+    int next_page_id = 0;
+    for (int k = 0; ok && old_file && k < header.id_count; k++) {
+        StoreIdEntry entry;
+        ok = read_at(old_file, header.ids_offset + k * sizeof(StoreIdEntry), &entry, sizeof(entry));
+        if (!ok || (entry.position >= first && entry.position < first + RECIPE_PAGE_SIZE)) continue;
+        ok = write_page_ids(file, page_ids, next_page_id, page_id_count, entry.id, out)
+            && write_all(file, &entry, sizeof(entry));
+        max_id = max(max_id, entry.id);
+        out.id_count++;
+    }
+    ok = ok && write_page_ids(file, page_ids, next_page_id, page_id_count, RECIPE_ID_MAX_PRESET + 1, out);
+
+    uint32_t offset = out.ids_offset + out.id_count * sizeof(StoreIdEntry) + sizeof(users);
+    uint32_t new_posting_offsets[INGREDIENT_COUNT];
+    ok = ok && write_all(file, users, sizeof(users));
+    for (int i = 0; ok && i < INGREDIENT_COUNT; i++) {
+        new_posting_offsets[i] = offset;
+        offset += users[i] * sizeof(RecipePosting);
+        ok = write_postings(file, old_file, count, i, users[i]);
+    }
+    out.names_offset = offset;
+    // Recipes imported with their own IDs may lie past the counter.
+    next_id = max(next_id, (recipe_id_t)(max_id + 1));
+    out.next_id = next_id;
+
+    for (int position = 0; ok && position < count; position++) {
+        StoreRecord record;
+        char name[COCKTAIL_NAME_CAPACITY];
+        ok = source_record(old_file, position, record, name);
+        if (ok && record.id != RECIPE_ID_NONE) {
+            size_t length = strlen(name);
+            size_t stored = stored_name_length(name);
+            memset(name + length, 0, stored - length);
+            ok = write_all(file, name, stored);
+        }
+    }
+
+    ok = ok && file.seek(0) && write_all(file, &out, sizeof(out));
+    file.close();
+    if (old_file) old_file.close();
+    if (!ok) {
+        Serial.println("Writing recipe library failed");
+        LittleFS.remove(RECIPE_STORE_TEMP_PATH);
+        max_id = previous_max_id;
+        return false;
+    }
+    // LittleFS renames over an existing file atomically, so a power cut
+    // leaves either the old or the new library.
+    if (!LittleFS.rename(RECIPE_STORE_TEMP_PATH, RECIPE_STORE_PATH)) {
+        LittleFS.remove(RECIPE_STORE_PATH);
+        LittleFS.rename(RECIPE_STORE_TEMP_PATH, RECIPE_STORE_PATH);
+    }
+    header = out;
+    for (int i = 0; i < INGREDIENT_COUNT; i++) {
+        posting_counts[i] = users[i];
+        posting_offsets[i] = new_posting_offsets[i];
+    }
+    for (int i = 0; i < RECIPE_PAGE_SIZE; i++) {
+        stored_orders[i] = stats.preset_order_counts[i].count;
+    }
+    Serial.printf("Saved recipe page %d, library holds %u recipes\n", current_page + 1, out.id_count);
+    makeable_rebuild();
+    return true;
+}
+
+bool recipe_store_begin() {
+    fs::File file = LittleFS.open(RECIPE_STORE_PATH, "r");
+    bool valid = file && read_header(file, header);
+    max_id = RECIPE_ID_NONE;
+    if (valid && header.id_count > 0) {
+        StoreIdEntry last;
+        valid = read_at(file, header.ids_offset + (header.id_count - 1) * sizeof(StoreIdEntry), &last, sizeof(last));
+        max_id = last.id;
+    }
+    next_id = valid ? header.next_id : max_id + 1;
+    next_id = max(next_id, (recipe_id_t)(max_id + 1));
+    if (file) file.close();
+    current_page = 0;
+
+    if (!valid) {
+        // First boot with the library, or one this build cannot read (broken,
+        // or written for another format or pump count): set it aside and
+        // start over from the presets in cocktails.json.
+        if (LittleFS.exists(RECIPE_STORE_PATH)) {
+            Serial.println("Recipe library unreadable, moved to " + String(RECIPE_STORE_SET_ASIDE_PATH));
+            LittleFS.remove(RECIPE_STORE_SET_ASIDE_PATH);
+            LittleFS.rename(RECIPE_STORE_PATH, RECIPE_STORE_SET_ASIDE_PATH);
+        }
+        header = {};
+        size_t count = 0;
+        for (int i = 0; i < PRESET_COCKTAIL_COUNT; i++) {
+            preset_cocktails[i] = make_cocktail("");
+        }
+        if (LittleFS.exists("/cocktails.json") && !load_cocktails(preset_cocktails, count)) {
+            Serial.println("Could not read cocktails.json for import");
+        }
+        assign_missing_recipe_ids();
+        Serial.printf("Importing %u recipes into the recipe library\n", (unsigned)count);
+        if (!recipe_store_save_page()) {
+            return false;
+        }
+    }
+    return recipe_store_load_page(0);
+}
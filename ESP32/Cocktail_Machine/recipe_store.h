@@ -0,0 +1,78 @@
+#ifndef RECIPE_STORE_H
+#define RECIPE_STORE_H
+
+#include "cocktail_data.h"
+
+// The recipe library lives in /recipes.bin and is browsed one page at a time:
+// the loaded page is preset_cocktails, so the 3x3 grid, stats, popularity and
+// availability all work on the page in RAM. Only the header and the loaded
+// page are ever held in memory, whatever the size of the library.
+const int RECIPE_PAGE_SIZE = PRESET_COCKTAIL_COUNT;
+// Recipes the library can address: positions are 16 bit, and name offsets
+// (16 bit, in 2-byte units) reach this many names of the longest length.
+const int RECIPE_STORE_MAX_COUNT = 4096;
+
+/*
+Opens the library, importing /cocktails.json on first boot, and loads the
+first page. Returns false if the library can neither be read nor created.
+*/
+bool recipe_store_begin();
+
+/*
+Positions in the library, including empty slots on pages edited with gaps.
+*/
+int recipe_store_count();
+int recipe_store_page_count();
+int recipe_store_current_page();
+
+/*
+Loads `page` into preset_cocktails. Order counts of the outgoing page are
+written back to the library first, so they survive paging.
+*/
+bool recipe_store_load_page(int page);
+
+/*
+Writes preset_cocktails back into the loaded page's slots. Call after the
+presets were edited, from loop() only: the whole file is rewritten through a
+temporary copy, about 70 bytes per recipe, so saving a page of a full
+12-pump library writes under 300 KB and blocks for up to 4 s of flash time.
+*/
+bool recipe_store_save_page();
+
+/*
+Position of the recipe with this ID in the library, or -1. A binary search
+over the on-flash ID table: a handful of small reads, nothing kept in RAM.
+*/
+int recipe_store_position(recipe_id_t id);
+
+/*
+ID of the recipe at a library position, RECIPE_ID_NONE for an empty slot.
+*/
+recipe_id_t recipe_store_id_at(int position);
+
+/*
+One entry of an ingredient's posting list: a recipe using it and how many
+millilitres (at the medium size). Each list is sorted by amount.
+*/
+struct RecipePosting {
+  uint16_t amount;
+  uint16_t position;
+};
+
+typedef void (*PostingVisitor)(const RecipePosting& posting, void* context);
+
+/*
+Calls `visit` for every recipe needing more than `min_amount` and at most
+`max_amount` ml of `ingredient`, in increasing amount. Only that stretch of
+the posting list is read. Returns false if the library could not be read.
+*/
+bool recipe_store_visit_postings(int ingredient, int min_amount, int max_amount, PostingVisitor visit, void* context);
+
+/*
+Hands out a new recipe ID above `above` and every ID handed out before, or
+RECIPE_ID_NONE once they are used up. The counter is persisted with the next
+recipe_store_save_page().
+*/
+recipe_id_t recipe_store_take_id(recipe_id_t above);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+
+// Binary layout of pour traces. Shared by the firmware and the host decoder
+// in ESP32/trace_decoder, so it must stay free of Arduino dependencies.
+
+const uint32_t TRACE_MAGIC = 0x43525443;  // "CTRC"
+const uint16_t TRACE_VERSION = 2;
+
+enum TraceEvent : uint8_t {
+  Trace_Sample = 0,         // raw = HX711 reading
+  Trace_Order_Start = 1,    // raw = scale offset, value = order sequence number (low 16 bits)
+  Trace_Order_End = 2,      // value = OrderState
+  Trace_Pour_Start = 3,     // raw = target mg, value = ingredient index
+  Trace_Pour_End = 4,       // raw = poured mg, value = OrderState
+  Trace_Motor_On = 5,       // value = motor index
+  Trace_Motor_Off = 6,      // value = motor index
+  Trace_Stop_Decision = 7,  // raw = filtered mg, value = estimated flow in g/s
+  Trace_Abort = 8,          // raw = filtered mg, value = PourFault
+  Trace_Scale_Gain = 9      // raw = counts per kg; follows every Trace_Order_Start
+};
+
+struct __attribute__((packed)) TraceRecord {
+  uint32_t time_ms;
+  int32_t raw;
+  uint8_t motors;  // bit per pump that was running when the record was taken
+                   // (pumps 0-7; builds with more rely on the motor events)
+  uint8_t event;   // TraceEvent
+  int16_t value;
+};
+
+// Written once at the start of every export, followed by record_count records.
+struct __attribute__((packed)) TraceDumpHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t record_count;
+  int32_t offset;         // scale calibration at export time; samples use the
+  int32_t counts_per_kg;  // one recorded with their order, these are a fallback
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include "trace_recorder.h"
+#include <FS.h>
+#include <LittleFS.h>
+#include "weight.h"
+#include "alloc_track.h"
+#include "filesystem.h"
+
+static const char* TRACE_PATH = "/trace.bin";
+
+struct __attribute__((packed)) TraceFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t capacity;
+  uint32_t total_written;                  // records ever written; slot = index % capacity
+  uint32_t order_count;
+  uint32_t order_starts[TRACE_KEEP_ORDERS];  // index of each of the last orders' first record
+};
+
+static TraceFileHeader file_header;
+static bool trace_ready = false;
+
+static TraceRecord buffer[TRACE_BUFFER_RECORDS];
+static int buffered = 0;
+static int dropped_samples = 0;
+static uint8_t motor_mask = 0;
+static bool recording = false;
+// Open from trace_order_start() to trace_order_end(), so flushes between
+// pours do not allocate a file handle while the order runs.
+static fs::File order_file;
+
+// Export cursor
+static bool exporting = false;
+static bool export_header_sent = false;
+static uint32_t export_next = 0;
+static uint32_t export_end = 0;
+
+static void reset_header() {
+  memset(&file_header, 0, sizeof(file_header));
+  file_header.magic = TRACE_MAGIC;
+  file_header.version = TRACE_VERSION;
+  file_header.record_size = sizeof(TraceRecord);
+  file_header.capacity = TRACE_FILE_RECORDS;
+}
+
+static size_t record_position(uint32_t index) {
+  return sizeof(TraceFileHeader) + (size_t)(index % file_header.capacity) * sizeof(TraceRecord);
+}
+
+bool trace_begin() {
+  reset_header();
+  if (LittleFS.exists(TRACE_PATH)) {
+    fs::File file = LittleFS.open(TRACE_PATH, "r");
+    TraceFileHeader stored;
+    bool valid = file && file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored)
+                 && stored.magic == TRACE_MAGIC && stored.version == TRACE_VERSION
+                 && stored.record_size == sizeof(TraceRecord) && stored.capacity == TRACE_FILE_RECORDS;
+    if (file) file.close();
+    if (valid) {
+      file_header = stored;
+      trace_ready = true;
+      Serial.printf("Trace file: %lu records, %lu orders\n", (unsigned long)stored.total_written, (unsigned long)stored.order_count);
+      return true;
+    }
+  }
+
+  fs::File file = LittleFS.open(TRACE_PATH, "w");
+  if (!file) {
+    Serial.println("Trace file could not be created, tracing disabled.");
+    return false;
+  }
+  file.write((const uint8_t*)&file_header, sizeof(file_header));
+  file.close();
+  trace_ready = true;
+  return true;
+}
+
+static void append(TraceEvent event, int32_t raw, int16_t value) {
+  if (!recording) return;
+  int limit = event == Trace_Sample ? TRACE_BUFFER_RECORDS - TRACE_EVENT_RESERVE : TRACE_BUFFER_RECORDS;
+  if (buffered >= limit) {
+    dropped_samples++;
+    return;
+  }
+  TraceRecord& record = buffer[buffered++];
+  record.time_ms = millis();
+  record.raw = raw;
+  record.motors = motor_mask;
+  record.event = event;
+  record.value = value;
+}
+
+static void flush_buffer() {
+  if (!trace_ready || buffered == 0) return;
+  AllocScopeGuard alloc_scope(Alloc_Storage);
+  FlashWriteTimer write_timer;
+  fs::File& file = order_file;
+  if (!file) {
+    Serial.println("Trace flush failed.");
+    return;
+  }
+  unsigned long start = millis();
+  for (int i = 0; i < buffered; i++) {
+    uint32_t index = file_header.total_written + i;
+    // Contiguous records only need a seek when the ring wraps.
+    if (i == 0 || index % file_header.capacity == 0) {
+      file.seek(record_position(index), SeekSet);
+    }
+    file.write((const uint8_t*)&buffer[i], sizeof(TraceRecord));
+  }
+  file_header.total_written += buffered;
+  file.seek(0, SeekSet);
+  file.write((const uint8_t*)&file_header, sizeof(file_header));
+  file.flush();
+  Serial.printf("Trace: wrote %d records (%d samples dropped) in %lu ms\n", buffered, dropped_samples, millis() - start);
+  buffered = 0;
+}
+
+void trace_flush() {
+  flush_buffer();
+}
+
+void trace_order_start() {
+  if (trace_ready && !order_file) {
+    AllocScopeGuard alloc_scope(Alloc_Storage);
+    order_file = LittleFS.open(TRACE_PATH, "r+");
+  }
+  recording = true;
+  buffered = 0;
+  dropped_samples = 0;
+  file_header.order_starts[file_header.order_count % TRACE_KEEP_ORDERS] = file_header.total_written;
+  file_header.order_count++;
+  append(Trace_Order_Start, scale_calibration.offset, (int16_t)file_header.order_count);
+  append(Trace_Scale_Gain, scale_calibration.counts_per_kg, 0);
+}
+
+void trace_order_end(OrderState state) {
+  append(Trace_Order_End, dropped_samples, (int16_t)state);
+  recording = false;
+  flush_buffer();
+  if (order_file) {
+    AllocScopeGuard alloc_scope(Alloc_Storage);
+    order_file.close();
+  }
+}
+
+void trace_sample(int32_t raw) {
+  append(Trace_Sample, raw, 0);
+}
+
+void trace_event(TraceEvent event, int32_t raw, int16_t value) {
+  if (value < 8) {
+    if (event == Trace_Motor_On) motor_mask |= (1 << value);
+    if (event == Trace_Motor_Off) motor_mask &= ~(1 << value);
+  }
+  append(event, raw, value);
+}
+
+static uint32_t oldest_retained() {
+  uint32_t total = file_header.total_written;
+  uint32_t oldest = total > file_header.capacity ? total - file_header.capacity : 0;
+  if (file_header.order_count == 0) return oldest;
+  // Start of the oldest of the last TRACE_KEEP_ORDERS orders, if it is still in the file.
+  uint32_t kept = min(file_header.order_count, (uint32_t)TRACE_KEEP_ORDERS);
+  uint32_t first_kept = file_header.order_starts[(file_header.order_count - kept) % TRACE_KEEP_ORDERS];
+  return max(oldest, first_kept);
+}
+
+static TraceDumpHeader dump_header(uint32_t count) {
+  TraceDumpHeader header;
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.record_size = sizeof(TraceRecord);
+  header.record_count = count;
+  header.offset = scale_calibration.offset;
+  header.counts_per_kg = scale_calibration.counts_per_kg;
+  return header;
+}
+
+void trace_start_export() {
+  if (!trace_ready) return;
+  exporting = true;
+  export_header_sent = false;
+  export_next = oldest_retained();
+  export_end = file_header.total_written;
+}
+
+bool trace_export_active() {
+  return exporting;
+}
+
+size_t trace_next_chunk(uint8_t* out, size_t max_length) {
+  if (!exporting) return 0;
+  size_t length = 0;
+  if (!export_header_sent) {
+    TraceDumpHeader header = dump_header(export_end - export_next);
+    memcpy(out, &header, sizeof(header));
+    length = sizeof(header);
+    export_header_sent = true;
+  }
+
+  fs::File file = LittleFS.open(TRACE_PATH, "r");
+  if (!file) {
+    exporting = false;
+    return length;
+  }
+  while (export_next < export_end && length + sizeof(TraceRecord) <= max_length) {
+    file.seek(record_position(export_next), SeekSet);
+    if (file.read(out + length, sizeof(TraceRecord)) != sizeof(TraceRecord)) {
+      export_next = export_end;
+      break;
+    }
+    length += sizeof(TraceRecord);
+    export_next++;
+  }
+  file.close();
+  if (export_next >= export_end) {
+    exporting = false;
+  }
+  return length;
+}
+
+void trace_export_serial() {
+  uint8_t chunk[32 * sizeof(TraceRecord)];
+  char hex[3];
+  trace_start_export();
+  Serial.printf("TRACE BEGIN %lu\n", (unsigned long)(export_end - export_next));
+  while (trace_export_active()) {
+    size_t length = trace_next_chunk(chunk, sizeof(chunk));
+    Serial.print("T:");
+    for (size_t i = 0; i < length; i++) {
+      snprintf(hex, sizeof(hex), "%02x", chunk[i]);
+      Serial.print(hex);
+    }
+    Serial.println();
+  }
+  Serial.println("TRACE END");
+}
@@ -0,0 +1,55 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <Arduino.h>
+#include "trace_format.h"
+#include "cocktail_data.h"
+
+// Records collected in RAM and written out between ingredients and when the
+// order ends, so flash is only touched while the pumps are off. Sized for one
+// ingredient at 80 SPS up to the stall timeout; the last slots are kept for
+// events.
+const int TRACE_BUFFER_RECORDS = 2048;
+const int TRACE_EVENT_RESERVE = 32;
+// Circular file on LittleFS (12 bytes per record).
+const uint32_t TRACE_FILE_RECORDS = 8192;
+// Exports start at the oldest of the last N orders still in the file.
+const int TRACE_KEEP_ORDERS = 20;
+// Bytes of dump per BLE notification.
+const size_t TRACE_BLE_CHUNK = 180;
+
+/*
+Opens (or creates) the trace file. Call after the filesystem is mounted.
+Returns false if tracing is disabled.
+*/
+bool trace_begin();
+
+/*
+Starts recording an order. Its first records hold the scale calibration in
+effect, so every order decodes with its own offset and gain.
+*/
+void trace_order_start();
+void trace_order_end(OrderState state);
+
+/*
+Writes what the current order buffered so far to flash. The write stalls the
+caller, so only call it while every pump is off.
+*/
+void trace_flush();
+
+void trace_sample(int32_t raw);
+void trace_event(TraceEvent event, int32_t raw, int16_t value);
+
+/*
+Prints the retained traces as "T:<hex>" lines between TRACE BEGIN/END markers.
+*/
+void trace_export_serial();
+
+/*
+Starts a BLE export; trace_next_chunk() then yields the dump piece by piece.
+*/
+void trace_start_export();
+bool trace_export_active();
+size_t trace_next_chunk(uint8_t* buffer, size_t max_length);
+
+#endif
@@ -0,0 +1,170 @@
+#include "weight.h"
+#include "health.h"
+
+LoadCell scale;
+ScaleCalibration scale_calibration = { 0, DEFAULT_COUNTS_PER_KG, 0 };
+
+static int rate_pin = -1;
+static SampleRate sample_rate = Rate_10SPS;
+static unsigned long settled_at_ms = 0;
+static int32_t last_good_raw = 0;
+
+static void apply_sample_rate(SampleRate rate) {
+  sample_rate = rate;
+  if (rate_pin >= 0) {
+    digitalWrite(rate_pin, rate == Rate_80SPS ? HIGH : LOW);
+  }
+  settled_at_ms = millis() + WEIGHT_SETTLE_CONVERSIONS * weight_sample_period_ms();
+  Serial.printf("HX711 sample rate set to %d SPS\n", rate == Rate_80SPS ? 80 : 10);
+}
+
+void weight_begin(int dout_pin, int sck_pin, int rate_select_pin) {
+  rate_pin = rate_select_pin;
+  pinMode(rate_pin, OUTPUT);
+  scale.begin(dout_pin, sck_pin);
+  apply_sample_rate(Rate_10SPS);
+}
+
+void weight_set_sample_rate(SampleRate rate) {
+  if (rate != sample_rate) {
+    apply_sample_rate(rate);
+  }
+}
+
+SampleRate weight_sample_rate() {
+  return sample_rate;
+}
+
+unsigned long weight_sample_period_ms() {
+  return sample_rate == Rate_80SPS ? 13 : 100;  // 12.5 ms rounded up
+}
+
+int weight_samples_for(unsigned long window_ms) {
+  return max(1, (int)(window_ms / weight_sample_period_ms()));
+}
+
+void weight_set_calibration(int32_t offset, int32_t counts_per_kg) {
+  if (counts_per_kg == 0) {
+    counts_per_kg = DEFAULT_COUNTS_PER_KG;
+  }
+  scale_calibration.offset = offset;
+  scale_calibration.counts_per_kg = counts_per_kg;
+  // 1e6 mg per kg, scaled up by the fixed-point shift and rounded.
+  int64_t numerator = (int64_t)1000000 << WEIGHT_FIXED_SHIFT;
+  scale_calibration.mg_per_count_q = (numerator + counts_per_kg / 2) / counts_per_kg;
+
+  // Keep the library's own float state in sync for code still using get_units().
+  scale.set_offset(offset);
+  scale.set_scale(counts_per_kg / 1000.0f);
+}
+
+static bool read_conversion(long& value) {
+  if (!scale.wait_ready_timeout(WEIGHT_READ_TIMEOUT_CONVERSIONS * weight_sample_period_ms())) {
+    Serial.println("HX711 read timed out.");
+    health_set(Subsystem_Load_Cell, Health_Failed, "HX711 stopped responding");
+    return false;
+  }
+  value = scale.read();
+  return true;
+}
+
+bool weight_read_raw_checked(int samples, int32_t& raw) {
+  if (samples < 1) samples = 1;
+  long value;
+  // Drop conversions still settling from a rate switch.
+  while ((long)(millis() - settled_at_ms) < 0) {
+    if (!read_conversion(value)) return false;
+  }
+  int64_t sum = 0;
+  for (int i = 0; i < samples; i++) {
+    if (!read_conversion(value)) return false;
+    sum += value;
+  }
+  raw = last_good_raw = (int32_t)(sum / samples);
+  return true;
+}
+
+int32_t weight_read_raw(int samples) {
+  int32_t raw = last_good_raw;
+  weight_read_raw_checked(samples, raw);
+  return raw;
+}
+
+bool weight_try_read_raw(int32_t& raw) {
+  if ((long)(millis() - settled_at_ms) < 0 || !scale.is_ready()) {
+    return false;
+  }
+  raw = scale.read();
+  return true;
+}
+
+weight_mg_t weight_raw_to_mg(int32_t raw) {
+  int64_t counts = (int64_t)raw - scale_calibration.offset;
+  int64_t scaled = counts * scale_calibration.mg_per_count_q;
+  // Round half away from zero before dropping the fraction bits.
+  int64_t half = (int64_t)1 << (WEIGHT_FIXED_SHIFT - 1);
+  return (weight_mg_t)((scaled >= 0 ? scaled + half : scaled - half) / ((int64_t)1 << WEIGHT_FIXED_SHIFT));
+}
+
+weight_mg_t weight_read_mg(int samples) {
+  return weight_raw_to_mg(weight_read_raw(samples));
+}
+
+bool weight_read_mg_checked(int samples, weight_mg_t& mg) {
+  int32_t raw;
+  if (!weight_read_raw_checked(samples, raw)) return false;
+  mg = weight_raw_to_mg(raw);
+  return true;
+}
+
+void weight_tare(int samples) {
+  weight_set_calibration(weight_read_raw(samples), scale_calibration.counts_per_kg);
+}
+
+int32_t weight_adjust_zero(weight_mg_t mg) {
+  int64_t scaled = (int64_t)mg * scale_calibration.counts_per_kg;
+  int32_t counts = (int32_t)((scaled + (scaled < 0 ? -500000 : 500000)) / 1000000);
+  weight_set_calibration(scale_calibration.offset + counts, scale_calibration.counts_per_kg);
+  return counts;
+}
+
+void weight_self_check() {
+  const int32_t RAW_STEP = 997;
+  const int32_t RAW_RANGE = 600000;  // about +-850 g around the offset
+  const float tolerance_mg = 1.0f;
+  float factor = scale_calibration.counts_per_kg / 1000.0f;
+
+  float max_error_mg = 0;
+  volatile float float_sink = 0;
+  volatile weight_mg_t fixed_sink = 0;
+  uint32_t float_cycles = 0;
+  uint32_t fixed_cycles = 0;
+  int count = 0;
+
+  for (int32_t delta = -RAW_RANGE; delta <= RAW_RANGE; delta += RAW_STEP) {
+    int32_t raw = scale_calibration.offset + delta;
+
+    uint32_t start = ESP.getCycleCount();
+    float grams = (raw - scale_calibration.offset) / factor;
+    float_sink = grams;
+    uint32_t mid = ESP.getCycleCount();
+    weight_mg_t mg = weight_raw_to_mg(raw);
+    fixed_sink = mg;
+    uint32_t end = ESP.getCycleCount();
+
+    float_cycles += mid - start;
+    fixed_cycles += end - mid;
+    max_error_mg = max(max_error_mg, fabsf(grams * MG_PER_GRAM - mg));
+    count++;
+  }
+
+  Serial.printf("Weight self check: %d samples, max |float - fixed| = %.3f mg (%s)\n",
+                count, max_error_mg, max_error_mg <= tolerance_mg ? "OK" : "FAIL");
+  Serial.printf("  float path: %.1f cycles/sample, fixed path: %.1f cycles/sample\n",
+                (float)float_cycles / count, (float)fixed_cycles / count);
+#ifndef HX711_BITBANG
+  Serial.printf("  HX711: %lu conversions, %lu overruns, %lu cycles per fetch\n",
+                (unsigned long)scale.conversions(), (unsigned long)scale.overruns(),
+                (unsigned long)scale.average_fetch_cycles());
+#endif
+}
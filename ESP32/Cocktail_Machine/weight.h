@@ -0,0 +1,137 @@
+#ifndef WEIGHT_H
+#define WEIGHT_H
+
+#include <Arduino.h>
+
+// By default conversions are fetched in the background by HX711Async.
+// Build with HX711_BITBANG to fall back to the blocking HX711 library.
+#ifdef HX711_BITBANG
+#include "HX711.h"
+typedef HX711 LoadCell;
+#else
+#include "hx711_async.h"
+typedef HX711Async LoadCell;
+#endif
+
+// Weights travel as signed integer milligrams from the HX711 through every
+// threshold and filter. Conversion to float grams only happens at the UI and
+// BLE edges via mg_to_grams()/grams_to_mg().
+typedef int32_t weight_mg_t;
+
+const weight_mg_t MG_PER_GRAM = 1000;
+
+// 93000 raw counts measured for a 132 g reference mass. The old float constant
+// was the integer quotient 93000/132, i.e. 704 counts per gram.
+const int32_t DEFAULT_COUNTS_PER_KG = 93000 / 132 * 1000;
+
+// The HX711 RATE pin selects 10 SPS (low) or 80 SPS (high). After a switch
+// the output needs four conversions to settle.
+enum SampleRate {
+  Rate_10SPS,
+  Rate_80SPS
+};
+const int WEIGHT_SETTLE_CONVERSIONS = 4;
+// No conversion for this many sample periods means the HX711 stopped
+// responding (unplugged, broken wire). Kept short: pumps may be running.
+const int WEIGHT_READ_TIMEOUT_CONVERSIONS = 5;
+
+// Fractional bits of the mg-per-count multiplier. Its rounding error grows
+// with the load: with 24 bits it stays under 0.02 mg within +-600k counts
+// for any gain (16 bits reached 4.6 mg there). The product still fits in 64
+// bits for gains down to 1000 counts per kg over the whole 24-bit range.
+const int WEIGHT_FIXED_SHIFT = 24;
+
+struct ScaleCalibration {
+  int32_t offset;          // raw counts with an empty platform
+  int32_t counts_per_kg;   // raw counts per kilogram of load
+  int64_t mg_per_count_q;  // derived: milligrams per count, Q24
+};
+
+extern LoadCell scale;
+extern ScaleCalibration scale_calibration;
+
+/*
+Starts the HX711 on the given pins at 10 SPS.
+*/
+void weight_begin(int dout_pin, int sck_pin, int rate_pin);
+
+/*
+Switches the HX711 sample rate. Readings taken before the new rate has
+settled are discarded by weight_read_raw().
+*/
+void weight_set_sample_rate(SampleRate rate);
+
+SampleRate weight_sample_rate();
+
+/*
+Time between conversions at the active rate.
+*/
+unsigned long weight_sample_period_ms();
+
+/*
+Number of samples that span `window_ms` at the active rate (at least 1).
+*/
+int weight_samples_for(unsigned long window_ms);
+
+/*
+Sets offset and gain of the scale and recomputes the fixed-point multiplier.
+*/
+void weight_set_calibration(int32_t offset, int32_t counts_per_kg);
+
+/*
+Reads and averages `samples` raw HX711 readings (blocking). Returns false if
+a conversion took longer than WEIGHT_READ_TIMEOUT_CONVERSIONS sample periods:
+the load cell is then marked Failed in the health table and `raw` is left
+unchanged.
+*/
+bool weight_read_raw_checked(int samples, int32_t& raw);
+
+/*
+As weight_read_raw_checked(), but returns the last good reading on a
+timeout. Only for callers that cannot act on a failed read.
+*/
+int32_t weight_read_raw(int samples);
+
+/*
+Non-blocking read: returns false if the HX711 has no settled conversion ready.
+*/
+bool weight_try_read_raw(int32_t& raw);
+
+/*
+Converts a raw reading to milligrams using integer math only (ISR safe).
+*/
+weight_mg_t weight_raw_to_mg(int32_t raw);
+
+/*
+Averages `samples` readings and returns the load in milligrams.
+*/
+weight_mg_t weight_read_mg(int samples);
+bool weight_read_mg_checked(int samples, weight_mg_t& mg);
+
+/*
+Zeroes the scale on the current load.
+*/
+void weight_tare(int samples);
+
+/*
+Moves the zero so that a load of `mg` now reads as zero, to the nearest raw
+count. Returns the raw counts it moved by: 0 for less than half a count.
+*/
+int32_t weight_adjust_zero(weight_mg_t mg);
+
+/*
+Prints the deviation between the float and fixed-point paths and their cycle
+counts over a synthetic sweep of raw readings, plus acquisition statistics
+of the background HX711 driver.
+*/
+void weight_self_check();
+
+inline float mg_to_grams(weight_mg_t mg) {
+  return mg / (float)MG_PER_GRAM;
+}
+
+inline weight_mg_t grams_to_mg(float grams) {
+  return (weight_mg_t)lroundf(grams * MG_PER_GRAM);
+}
+
+#endif
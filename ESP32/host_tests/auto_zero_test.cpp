@@ -0,0 +1,156 @@
+// Auto-zero (auto_zero.cpp) over a simulated 12-hour session: the load cell
+// zero drifts linearly while cups are set down and taken away and the
+// platform is shaken now and then. The corrected zero must stay in the
+// capture band, loaded and shaking windows must be left alone, no
+// correction may exceed AUTO_ZERO_MAX_STEP_MG, and cup detection
+// (cup_detector.cpp) must still work at the end.
+#include "host.h"
+#include "weight.h"
+#include "auto_zero.h"
+#include "cup_detector.h"
+#include "health.h"
+#include <random>
+
+static const long ZERO_RAW = 50000;
+static const double COUNTS_PER_GRAM = DEFAULT_COUNTS_PER_KG / 1000.0;
+static const int RATE_PIN = 23;
+static const double SESSION_S = 12 * 3600;
+static const double DRIFT_G = 30;          // over the whole session
+static const double NOISE_G = 0.03;        // at 10 SPS
+static const double CYCLE_S = 1800;        // every half hour:
+static const double CUP_AT_S = 600;        //   a cup stands for four minutes,
+static const double CUP_FOR_S = 240;
+static const double CUP_G = 180;
+static const double SHAKE_AT_S = 1200;     //   the platform is shaken for a minute
+static const double SHAKE_FOR_S = 60;
+static const double SHAKE_G = 0.6;
+static const unsigned long LOOP_MS = 20;
+
+static double extra_load_g = 0;  // set by the test after the session
+static std::mt19937 random_source(30);
+
+static double drift_g(double t) {
+  return DRIFT_G * min(t, SESSION_S) / SESSION_S;
+}
+
+static double session_load_g(double t) {
+  if (t >= SESSION_S) return 0;
+  double in_cycle = fmod(t, CYCLE_S);
+  if (in_cycle >= CUP_AT_S && in_cycle < CUP_AT_S + CUP_FOR_S) return CUP_G;
+  if (in_cycle >= SHAKE_AT_S && in_cycle < SHAKE_AT_S + SHAKE_FOR_S) return SHAKE_G * sin(2 * M_PI * 3.3 * t);
+  return 0;
+}
+
+static bool scale_source(uint64_t now_us, long& raw) {
+  double t = now_us / 1e6;
+  std::normal_distribution<double> noise(0, NOISE_G);
+  raw = ZERO_RAW + lround((drift_g(t) + session_load_g(t) + extra_load_g + noise(random_source)) * COUNTS_PER_GRAM);
+  return true;
+}
+
+// What an empty platform reads now, noise aside.
+static weight_mg_t empty_reading_mg() {
+  return weight_raw_to_mg(ZERO_RAW + lround(drift_g(millis() / 1000.0) * COUNTS_PER_GRAM));
+}
+
+struct Tracking {
+  int corrections = 0;
+  weight_mg_t total_mg = 0;
+  weight_mg_t largest_step_mg = 0;
+  int corrections_loaded = 0;  // while a cup stood or the platform shook
+};
+
+// The idle loop: auto_zero_update() every pass, each correction checked.
+static void idle_for(double seconds, Tracking& tracking) {
+  unsigned long end_ms = millis() + (unsigned long)(seconds * 1000);
+  while (millis() < end_ms) {
+    auto_zero_update();
+    if (drift_stats.corrections != tracking.corrections) {
+      weight_mg_t step = drift_stats.total_drift_mg - tracking.total_mg;
+      tracking.largest_step_mg = max(tracking.largest_step_mg, (weight_mg_t)abs(step));
+      if (session_load_g(millis() / 1000.0) != 0) tracking.corrections_loaded++;
+      tracking.corrections = drift_stats.corrections;
+      tracking.total_mg = drift_stats.total_drift_mg;
+    }
+    host_advance_ms(LOOP_MS);
+  }
+}
+
+static void session(Tracking& tracking) {
+  // Checked once a minute, just before each cup, after each shake and at the end.
+  weight_mg_t max_error_mg = 0;
+  for (double t = 0; t < SESSION_S; t += 60) {
+    idle_for(60, tracking);
+    double in_cycle = fmod(millis() / 1000.0, CYCLE_S);
+    bool settled = in_cycle < CUP_AT_S || (in_cycle >= CUP_AT_S + CUP_FOR_S + 60 && in_cycle < SHAKE_AT_S)
+                   || in_cycle >= SHAKE_AT_S + SHAKE_FOR_S + 60;
+    if (settled && t > 60) max_error_mg = max(max_error_mg, (weight_mg_t)abs(empty_reading_mg()));
+  }
+  printf("  12 h, %.0f g drift: %d corrections, %d windows loaded, %d shaking; empty platform off by at most %.3f g "
+         "(%.1f g uncorrected)\n", DRIFT_G, drift_stats.corrections, drift_stats.windows_loaded,
+         drift_stats.windows_unstable, mg_to_grams(max_error_mg), DRIFT_G);
+  printf("  largest correction %.3f g, %d while loaded or shaking, drift rate %.2f g/h\n",
+         mg_to_grams(tracking.largest_step_mg), tracking.corrections_loaded,
+         mg_to_grams(auto_zero_drift_rate_mg_per_hour()));
+  HOST_CHECK(max_error_mg <= AUTO_ZERO_CAPTURE_MG);
+  HOST_CHECK(abs(empty_reading_mg()) <= AUTO_ZERO_CAPTURE_MG);
+  HOST_CHECK(tracking.corrections_loaded == 0);
+  HOST_CHECK(drift_stats.windows_loaded > 0);
+  HOST_CHECK(drift_stats.windows_unstable > 0);
+  HOST_CHECK(abs(auto_zero_drift_rate_mg_per_hour() - grams_to_mg(DRIFT_G / 12)) < 100);
+}
+
+// A steady load under the capture band (a wet napkin) is taken in one
+// capped step per window, not at once.
+static void sub_gram_load(Tracking& tracking) {
+  const double napkin_g = 0.9;
+  weight_mg_t before = drift_stats.total_drift_mg;
+  extra_load_g = napkin_g;
+  auto_zero_reset_window();
+  idle_for(AUTO_ZERO_WINDOW_SAMPLES * 0.1 + 0.05, tracking);
+  weight_mg_t one_window = drift_stats.total_drift_mg - before;
+  idle_for(4 * AUTO_ZERO_WINDOW_SAMPLES * 0.1, tracking);
+  weight_mg_t five_windows = drift_stats.total_drift_mg - before;
+  printf("  %.1f g napkin: %.3f g taken after one window, %.3f g after five\n", napkin_g, mg_to_grams(one_window),
+         mg_to_grams(five_windows));
+  HOST_CHECK(one_window > 0 && one_window <= AUTO_ZERO_MAX_STEP_MG);
+  HOST_CHECK(five_windows <= 5 * AUTO_ZERO_MAX_STEP_MG);
+  HOST_CHECK(tracking.largest_step_mg <= AUTO_ZERO_MAX_STEP_MG);
+  extra_load_g = 0;
+  idle_for(120, tracking);
+}
+
+// The cup wait of an order after the session: baseline, then a cup.
+static void cup_detection() {
+  weight_mg_t baseline = weight_read_mg(weight_samples_for(500));
+  CupDetector detector;
+  cup_detector_reset(detector, baseline, weight_sample_period_ms());
+  bool confirmed_empty = false;
+  for (int i = 0; i < 30; i++) {
+    confirmed_empty = confirmed_empty || cup_detector_feed(detector, weight_read_mg(1), millis()) == Cup_Confirmed;
+  }
+  extra_load_g = CUP_G;
+  bool confirmed = false;
+  for (int i = 0; i < 50 && !confirmed; i++) {
+    confirmed = cup_detector_feed(detector, weight_read_mg(1), millis()) == Cup_Confirmed;
+  }
+  printf("  after the session: empty platform reads %.3f g, cup %s, %.1f g\n", mg_to_grams(baseline),
+         confirmed ? "confirmed" : "MISSED", mg_to_grams(detector.cup_weight));
+  HOST_CHECK(abs(baseline) <= AUTO_ZERO_CAPTURE_MG);
+  HOST_CHECK(!confirmed_empty);
+  HOST_CHECK(confirmed);
+  HOST_CHECK(fabs(mg_to_grams(detector.cup_weight) - CUP_G) < 1.0);
+}
+
+int main() {
+  host_hx711_attach(scale_source, RATE_PIN);
+  weight_begin(4, 5, RATE_PIN);
+  weight_set_calibration(ZERO_RAW, DEFAULT_COUNTS_PER_KG);
+  health_set(Subsystem_Load_Cell, Health_Ok);
+
+  Tracking tracking;
+  session(tracking);
+  sub_gram_load(tracking);
+  cup_detection();
+  return host_report("auto_zero_test");
+}
@@ -0,0 +1,100 @@
+// Calibration session rules (calibration.cpp) on the simulated scale.
+#include "host.h"
+#include "calibration.h"
+#include "filesystem.h"
+#include "health.h"
+
+static const long ZERO_RAW = 50000;
+static const double COUNTS_PER_GRAM = 812.5;
+static double load_g = 0;
+static bool unplugged = false;
+
+static bool scale_source(uint64_t, long& raw) {
+  raw = ZERO_RAW + lround(load_g * COUNTS_PER_GRAM);
+  return !unplugged;
+}
+
+// Storage is not under test here.
+static int saves = 0;
+bool save_calibration(const ScaleCalibration&) {
+  saves++;
+  return true;
+}
+bool load_calibration(ScaleCalibration&) { return false; }
+
+int main() {
+  host_hx711_attach(scale_source, 23);
+  weight_begin(4, 5, 23);
+  health_set(Subsystem_Load_Cell, Health_Ok);
+
+  HOST_CHECK(calibration_start());
+  HOST_CHECK(calibration_session.zero_raw == ZERO_RAW);
+
+  // Nothing (or next to nothing) on the platform.
+  load_g = 0.5;
+  HOST_CHECK(!calibration_add_point(100000));
+  load_g = 0;
+  HOST_CHECK(!calibration_add_point(100000));
+  HOST_CHECK(calibration_session.point_count == 0);
+
+  // One mass fits any line: not enough to save.
+  load_g = 100;
+  HOST_CHECK(calibration_add_point(100000));
+  HOST_CHECK(!calibration_is_valid());
+  // The same mass again still tells nothing about linearity.
+  HOST_CHECK(calibration_add_point(100000));
+  HOST_CHECK(!calibration_is_valid());
+  HOST_CHECK(!calibration_save());
+  HOST_CHECK(saves == 0);
+
+  load_g = 500;
+  HOST_CHECK(calibration_add_point(500000));
+  HOST_CHECK(calibration_is_valid());
+  HOST_CHECK(abs(calibration_session.counts_per_kg - 812500) <= 1);
+  HOST_CHECK(calibration_save());
+  HOST_CHECK(saves == 1);
+  HOST_CHECK(abs(weight_read_mg(1) - 500000) <= 2);
+
+  // A scale that bends: the second mass reads 5% light.
+  load_g = 0;
+  HOST_CHECK(calibration_start());
+  load_g = 100;
+  HOST_CHECK(calibration_add_point(100000));
+  load_g = 475;
+  HOST_CHECK(calibration_add_point(500000));
+  HOST_CHECK(!calibration_is_valid());
+
+  // The load cell stops answering: no stale reading is taken for a point,
+  // a zero or the boot tare.
+  ScaleCalibration before = scale_calibration;
+  unplugged = true;
+  load_g = 300;
+  HOST_CHECK(!calibration_add_point(300000));
+  printf("  unplugged mid-session: point refused (%s), %d points kept\n", calibration_session.status,
+         calibration_session.point_count);
+  HOST_CHECK(calibration_session.point_count == 2);
+  HOST_CHECK(*calibration_session.status != '\0');
+  HOST_CHECK(subsystem_health[Subsystem_Load_Cell].state == Health_Failed);
+  HOST_CHECK(!calibration_save());
+
+  health_set(Subsystem_Load_Cell, Health_Ok);
+  HOST_CHECK(!calibration_start());
+  printf("  unplugged at the start: refused (%s)\n", calibration_session.status);
+  HOST_CHECK(*calibration_session.status != '\0');
+  calibration_cancel();
+  HOST_CHECK(!calibration_session.active);
+
+  health_set(Subsystem_Load_Cell, Health_Ok);
+  calibration_boot_tare();
+  HOST_CHECK(scale_calibration.offset == before.offset);
+  HOST_CHECK(scale_calibration.counts_per_kg == before.counts_per_kg);
+  HOST_CHECK(saves == 1);
+
+  unplugged = false;
+  load_g = 0;
+  health_set(Subsystem_Load_Cell, Health_Ok);
+  HOST_CHECK(calibration_start());
+  HOST_CHECK(*calibration_session.status == '\0');
+
+  return host_report("calibration_test");
+}
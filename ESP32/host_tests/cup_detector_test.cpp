@@ -0,0 +1,216 @@
+// Cup detector (cup_detector.cpp) against simulated platform traces: cups
+// placed, bumped, pressed by hand, lifted again, vibration and drift, with
+// and without the light sensor (cup_presence.cpp).
+//
+// Recorded traces can be replayed too: cup_detector_test <trace.csv>...
+// Each file holds "time_ms,grams[,optical]" lines (optical: 0 unknown,
+// 1 clear, 2 covered) and a "# expect: cup" or "# expect: none" line.
+#include "host.h"
+#include "cup_detector.h"
+#include "cup_presence.h"
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <vector>
+
+struct TracePoint {
+  unsigned long time_ms;
+  weight_mg_t weight;
+  OpticalState optical;
+};
+
+struct Outcome {
+  bool confirmed;
+  unsigned long decided_at_ms;
+  unsigned long latency_ms;
+  weight_mg_t cup_weight;
+  int rejected_steps;
+};
+
+static Outcome run(const std::vector<TracePoint>& trace, unsigned long period_ms) {
+  CupDetector detector;
+  cup_detector_reset(detector, trace.front().weight, period_ms);
+  for (const TracePoint& point : trace) {
+    if (cup_detector_feed(detector, point.weight, point.time_ms, point.optical) == Cup_Confirmed) {
+      return { true, point.time_ms, detector.decision_latency_ms, detector.cup_weight, detector.rejected_steps };
+    }
+  }
+  return { false, 0, 0, 0, detector.rejected_steps };
+}
+
+// Load on the platform in grams at time t (seconds), plus sensor noise.
+typedef std::function<double(double t)> LoadModel;
+
+static std::vector<TracePoint> sample(const LoadModel& load, unsigned long period_ms, double seconds,
+                                      double noise_g, unsigned seed,
+                                      std::function<OpticalState(double)> optical = nullptr) {
+  std::mt19937 random(seed);
+  std::normal_distribution<double> noise(0, noise_g);
+  std::vector<TracePoint> trace;
+  for (unsigned long t = 0; t <= seconds * 1000; t += period_ms) {
+    double grams = 2.5 + load(t / 1000.0) + noise(random);  // 2.5 g of residue on the tray
+    trace.push_back({ t, grams_to_mg((float)grams), optical ? optical(t / 1000.0) : Optical_Unknown });
+  }
+  return trace;
+}
+
+// A cup set down at `at` seconds: it lands over 80 ms and rings for a moment.
+static LoadModel cup(double at, double grams, double lifted_at = 1e9) {
+  return [=](double t) {
+    if (t < at || t >= lifted_at) return 0.0;
+    double since = t - at;
+    if (since < 0.08) return grams * since / 0.08;
+    return grams + 6.0 * exp(-since / 0.06) * sin(2 * M_PI * 14 * since);
+  };
+}
+
+static void expect_cup(const char* name, const std::vector<TracePoint>& trace, unsigned long period_ms,
+                       double cup_g, double placed_at_s, unsigned long max_latency_ms) {
+  Outcome outcome = run(trace, period_ms);
+  unsigned long since_placed = outcome.decided_at_ms - (unsigned long)(placed_at_s * 1000);
+  printf("  %-34s cup %s after %4lu ms (detector latency %3lu ms), %.1f g\n", name,
+         outcome.confirmed ? "confirmed" : "MISSED", since_placed, outcome.latency_ms, mg_to_grams(outcome.cup_weight));
+  HOST_CHECK(outcome.confirmed);
+  HOST_CHECK(since_placed <= max_latency_ms);
+  HOST_CHECK(fabs(mg_to_grams(outcome.cup_weight) - cup_g) < 1.0);
+}
+
+static void expect_none(const char* name, const std::vector<TracePoint>& trace, unsigned long period_ms) {
+  Outcome outcome = run(trace, period_ms);
+  printf("  %-34s %s (%d steps rejected)\n", name, outcome.confirmed ? "FALSE CUP" : "no cup", outcome.rejected_steps);
+  HOST_CHECK(!outcome.confirmed);
+}
+
+static void simulated_traces(int samples_per_second) {
+  unsigned long period_ms = samples_per_second == 80 ? 13 : 1000 / samples_per_second;
+  printf("%d SPS, weight only:\n", samples_per_second);
+  // About 300 ms of confirmation window plus the landing and ringing.
+  unsigned long max_latency = 300 + 3 * period_ms + 200;
+  expect_cup("glass, 180 g", sample(cup(1.0, 180), period_ms, 4, 0.08, 1), period_ms, 180, 1.0, max_latency);
+  expect_cup("plastic cup, 12 g", sample(cup(1.0, 12), period_ms, 4, 0.08, 2), period_ms, 12, 1.0, max_latency);
+  expect_cup("noisy scale, 180 g", sample(cup(1.0, 180), period_ms, 4, 0.2, 3), period_ms, 180, 1.0, max_latency);
+
+  expect_none("bump (one 40 ms knock)", sample([](double t) {
+    return t >= 1.0 && t < 1.04 ? 25.0 : 0.0;
+  }, period_ms, 4, 0.08, 4), period_ms);
+  expect_none("hand pressing for 1.5 s", sample([](double t) {
+    if (t < 1.0 || t > 2.5) return 0.0;
+    return 400 + 150 * sin(2 * M_PI * 0.7 * t) + 8 * sin(2 * M_PI * 6 * t);
+  }, period_ms, 4, 0.08, 5), period_ms);
+  expect_none("cup lifted again after 150 ms", sample(cup(1.0, 180, 1.15), period_ms, 4, 0.08, 6), period_ms);
+  expect_none("vibration, 4 g at 3 Hz", sample([](double t) {
+    return t > 0.5 && t < 3.5 ? 4 * sin(2 * M_PI * 3 * t) + 1.5 : 0.0;
+  }, period_ms, 4, 0.08, 7), period_ms);
+  expect_none("drift, 3 g over 2 minutes", sample([](double t) {
+    return 3.0 * t / 120;
+  }, period_ms, 120, 0.08, 8), period_ms);
+}
+
+static void fused_traces(int samples_per_second) {
+  unsigned long period_ms = samples_per_second == 80 ? 13 : 1000 / samples_per_second;
+  printf("%d SPS, with the light sensor:\n", samples_per_second);
+  auto shaded_from = [](double at) {
+    return [=](double t) { return t >= at ? Optical_Covered : Optical_Clear; };
+  };
+  auto always_clear = [](double) { return Optical_Clear; };
+  expect_cup("glass shading the sensor", sample(cup(1.0, 180), period_ms, 4, 0.08, 11, shaded_from(1.05)),
+             period_ms, 180, 1.0, 150 + 3 * period_ms);
+  // Too clear to shade the sensor: once the veto times out, a load of cup
+  // weight that stays still long enough is a glass.
+  expect_cup("clear glass, sensor stays clear", sample(cup(1.0, 180), period_ms, 7, 0.08, 12, always_clear),
+             period_ms, 180, 1.0, CUP_SETTLE_TIMEOUT_MS + CUP_STILL_HOLD_MS + 300 + 3 * period_ms + 200);
+  expect_none("hand pressing for 4 s, sensor clear", sample([](double t) {
+    if (t < 1.0 || t > 5.0) return 0.0;
+    return 400 + 150 * sin(2 * M_PI * 0.7 * t) + 8 * sin(2 * M_PI * 6 * t);
+  }, period_ms, 7, 0.08, 13, always_clear), period_ms);
+  // A hand held as still as it can be: tremor of about a gram at 9 Hz and a
+  // slow sway.
+  expect_none("hand held steady 5 s, sensor clear", sample([](double t) {
+    if (t < 1.0 || t > 6.0) return 0.0;
+    return 250 + 0.8 * sin(2 * M_PI * 9 * t) + 0.5 * sin(2 * M_PI * 0.4 * t);
+  }, period_ms, 8, 0.08, 14, always_clear), period_ms);
+}
+
+// Learning the open level, debouncing and recovery after going dark.
+static void presence_sensor() {
+  printf("light sensor:\n");
+  SimulatedCupPresenceSensor sensor;
+  HOST_CHECK(cup_presence_setup(&sensor));
+  HOST_CHECK(cup_presence_state() == Optical_Unknown);
+  unsigned long now = 0;
+  auto feed = [&](uint16_t level, int readings) {
+    for (int i = 0; i < readings; i++) {
+      sensor.set_level(level);
+      cup_presence_update(now += 10);
+    }
+  };
+  feed(2000, OPTICAL_LEARN_READINGS - 1);
+  HOST_CHECK(cup_presence_state() == Optical_Unknown);
+  feed(2000, 1);
+  HOST_CHECK(cup_presence_state() == Optical_Clear);
+  feed(900, 1);  // a shadow passing: shorter than the debounce
+  feed(2000, 1);
+  HOST_CHECK(cup_presence_state() == Optical_Clear);
+  feed(900, OPTICAL_DEBOUNCE_MS / 10 + 1);
+  HOST_CHECK(cup_presence_state() == Optical_Covered);
+  feed(1800, OPTICAL_DEBOUNCE_MS / 10 + 1);
+  HOST_CHECK(cup_presence_state() == Optical_Clear);
+
+  // Too dark to tell: unknown until enough bright readings in a row.
+  HOST_CHECK(cup_presence_setup(&sensor));
+  feed(100, 10);
+  HOST_CHECK(cup_presence_state() == Optical_Unknown);
+  feed(2000, OPTICAL_LEARN_READINGS);
+  HOST_CHECK(cup_presence_state() == Optical_Clear);
+  HOST_CHECK(!cup_presence_setup(nullptr));
+  HOST_CHECK(cup_presence_state() == Optical_Unknown);
+  printf("  learning, debounce and recovery checked\n");
+}
+
+static bool load_recorded(const char* path, std::vector<TracePoint>& trace, bool& expect_cup_present) {
+  std::ifstream in(path);
+  if (!in) return false;
+  std::string line;
+  expect_cup_present = false;
+  while (std::getline(in, line)) {
+    if (line.rfind("# expect:", 0) == 0) {
+      expect_cup_present = line.find("cup") != std::string::npos;
+      continue;
+    }
+    if (line.empty() || line[0] == '#' || !isdigit((unsigned char)line[0])) continue;
+    std::istringstream fields(line);
+    TracePoint point = { 0, 0, Optical_Unknown };
+    double grams = 0;
+    char comma;
+    int optical = 0;
+    fields >> point.time_ms >> comma >> grams;
+    if (fields >> comma >> optical) point.optical = (OpticalState)optical;
+    point.weight = grams_to_mg((float)grams);
+    trace.push_back(point);
+  }
+  return trace.size() > 1;
+}
+
+int main(int argc, char** argv) {
+  simulated_traces(10);
+  simulated_traces(80);
+  fused_traces(10);
+  fused_traces(80);
+  presence_sensor();
+
+  for (int i = 1; i < argc; i++) {
+    std::vector<TracePoint> trace;
+    bool expect_cup_present;
+    if (!load_recorded(argv[i], trace, expect_cup_present)) {
+      printf("cannot read trace %s\n", argv[i]);
+      host_failures++;
+      continue;
+    }
+    unsigned long period_ms = (trace.back().time_ms - trace.front().time_ms) / (trace.size() - 1);
+    Outcome outcome = run(trace, max(1UL, period_ms));
+    printf("  %-34s %s (latency %lu ms)\n", argv[i], outcome.confirmed ? "cup" : "no cup", outcome.latency_ms);
+    HOST_CHECK(outcome.confirmed == expect_cup_present);
+  }
+  return host_report("cup_detector_test");
+}
@@ -0,0 +1,33 @@
+// Ingredient stock and stats as seen by motors_sensors.cpp.
+#include "fakes.h"
+#include "order_history.h"
+#include "availability.h"
+#include "forecast.h"
+
+Ingredient ingredients[INGREDIENT_COUNT];
+
+void fakes_reset(int stock_ml) {
+  fake_log = FakeLog();
+  fake_app_connected = true;
+  for (int i = 0; i < INGREDIENT_COUNT; i++) {
+    ingredients[i] = Ingredient();
+    ingredients[i].amount_left_ul = stock_ml * UL_PER_ML;
+  }
+}
+
+void update_ingredient_amount(int ingredient_index, int32_t poured_mg) {
+  volume_ul_t poured_ul = mg_to_ul(ingredients[ingredient_index], max((int32_t)0, poured_mg));
+  fake_log.poured_ul[ingredient_index] += poured_ul;
+  ingredients[ingredient_index].amount_left_ul -= poured_ul;
+  history_add_poured(ingredient_index, (float)poured_ul / UL_PER_ML);
+  forecast_consumed(ingredient_index, (float)poured_ul / UL_PER_ML);
+}
+
+int ingredient_headroom_ml(int ingredient_index) {
+  return stock_ml(ingredients[ingredient_index]) - MINIMUM_INGREDIENT_AMOUNT_THRESHOLD;
+}
+
+void update_stats_on_drink_order(const Cocktail&, OrderState state) {
+  fake_log.orders++;
+  fake_log.last_order = state;
+}
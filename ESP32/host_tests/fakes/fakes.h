@@ -0,0 +1,45 @@
+// Stand-ins for the screen, BLE and storage modules, so the pour and cup
+// logic can link without them. They record what the firmware asked for.
+#pragma once
+#include <vector>
+#include "cocktail_data.h"
+#include "trace_format.h"
+
+struct FakeTraceEvent {
+  unsigned long time_ms;
+  TraceEvent event;
+  int32_t raw;
+  int16_t value;
+};
+
+struct FakeLog {
+  int alerts = 0;
+  int pushes[INGREDIENT_COUNT] = {};
+  volume_ul_t poured_ul[INGREDIENT_COUNT] = {};
+  int orders = 0;
+  OrderState last_order = Completed;
+  int flash_writes = 0;
+  std::vector<FakeTraceEvent> events;
+};
+
+extern FakeLog fake_log;
+
+/*
+Clears the log and fills every bottle with `stock_ml`.
+*/
+void fakes_reset(int stock_ml = 1000);
+
+/*
+Called from check_and_handle_touch(), e.g. to press cancel mid-pour.
+*/
+extern void (*fake_touch_hook)();
+
+/*
+Whether an app is connected to receive pushes; fakes_reset() connects one.
+*/
+extern bool fake_app_connected;
+
+/*
+Returns the first traced event of this kind, or null.
+*/
+const FakeTraceEvent* fake_find_event(TraceEvent event);
@@ -0,0 +1,7 @@
+// Stock forecast as seen by motors_sensors.cpp: never warns early.
+#include "fakes.h"
+#include "forecast.h"
+
+void forecast_consumed(int, float) {}
+bool forecast_should_warn(int) { return false; }
+void forecast_mark_warned(int) {}
@@ -0,0 +1,20 @@
+// Storage, history and forecast hooks of the real cocktail_data.cpp, for
+// tests of the recipe library.
+#include "fakes.h"
+#include "filesystem.h"
+#include "order_history.h"
+#include "forecast.h"
+
+bool load_cocktails(Cocktail*, size_t& count) {
+  count = 0;
+  return false;
+}
+
+void mark_ingredients_dirty() {}
+void mark_stats_dirty() {}
+
+void history_add_poured(int ingredient_index, float ml) {
+  fake_log.poured_ul[ingredient_index] += ml_to_ul(ml);
+}
+
+void forecast_consumed(int, float) {}
@@ -0,0 +1,12 @@
+// The log every stand-in writes to, and the state tests set for them.
+#include "fakes.h"
+
+FakeLog fake_log;
+bool fake_app_connected = true;
+
+const FakeTraceEvent* fake_find_event(TraceEvent event) {
+  for (const FakeTraceEvent& traced : fake_log.events) {
+    if (traced.event == event) return &traced;
+  }
+  return nullptr;
+}
@@ -0,0 +1,22 @@
+// Traces, journal and history as seen by motors_sensors.cpp, kept in memory.
+#include "fakes.h"
+#include "trace_recorder.h"
+#include "order_journal.h"
+#include "order_history.h"
+
+void trace_order_start() {}
+void trace_order_end(OrderState) {}
+void trace_flush() {}
+void trace_sample(int32_t) {}
+void trace_event(TraceEvent event, int32_t raw, int16_t value) {
+  fake_log.events.push_back({ millis(), event, raw, value });
+}
+
+void journal_order_start(const Cocktail&, CocktailSize) {}
+void journal_cup_detected() {}
+void journal_pour_start(int, int32_t) {}
+void journal_pour_stop(int, int32_t) {}
+void journal_order_end(OrderState) {}
+
+void history_add_poured(int, float) {}
+void history_record_order(OrderState, unsigned long) {}
@@ -0,0 +1,9 @@
+// Flash write accounting of filesystem.cpp, for tests that leave storage out.
+#include "fakes.h"
+#include "filesystem.h"
+
+FlashWriteTimer::FlashWriteTimer() : started_ms(millis()) {}
+
+FlashWriteTimer::~FlashWriteTimer() {
+  fake_log.flash_writes++;
+}
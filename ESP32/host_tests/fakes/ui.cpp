@@ -0,0 +1,37 @@
+// Screen, BLE and calibration entry points used by motors_sensors.cpp.
+#include "fakes.h"
+#include "menu.h"
+#include "bluetooth.h"
+#include "calibration.h"
+
+MenuState current_menu = Menu_1;
+void (*fake_touch_hook)() = nullptr;
+
+void check_and_handle_touch() {
+  if (fake_touch_hook) fake_touch_hook();
+}
+
+void init_cancellable_op(const char*) {
+  current_menu = Cancellable_Op;
+}
+
+void return_to_main_menu() {
+  current_menu = Menu_1;
+}
+
+void alert_error(const char*) {
+  fake_log.alerts++;
+  current_menu = Error_Screen;
+}
+
+bool send_push_notification(int ingredientIndex) {
+  if (!fake_app_connected) return false;
+  fake_log.pushes[ingredientIndex]++;
+  return true;
+}
+
+void calibration_load_at_boot() {}
+
+void calibration_boot_tare() {
+  weight_tare(4);
+}
@@ -0,0 +1,145 @@
+// Stats and stock persistence (filesystem.cpp, with the host ArduinoJson) on
+// the simulated filesystem: stats load at boot, orders only mark them dirty,
+// the checkpoint waits for its interval and for idle, a restart flushes, and
+// stock files from before integer stock still load.
+#include "host.h"
+#include "fakes.h"
+#include "filesystem.h"
+#include "recipe_store.h"
+#include <LittleFS.h>
+#include <esp_system.h>
+
+static const char* PRESETS_JSON =
+    "[{\"id\":1,\"name\":\"Sunrise\",\"amounts\":[40,20,0,0]},"
+    "{\"id\":2,\"name\":\"Sea Breeze\",\"amounts\":[0,30,30,0]},"
+    "{\"name\":\"No ID\",\"amounts\":[10,10,10,10]}]";
+
+static void write_file(const char* path, const char* text) {
+  fs::File file = LittleFS.open(path, "w");
+  file.print(text);
+  file.close();
+}
+
+static std::string read_file(const char* path) {
+  fs::File file = LittleFS.open(path, "r");
+  std::string text;
+  int c;
+  while (file && (c = file.read()) >= 0) text += (char)c;
+  return text;
+}
+
+// A reboot: RAM state gone, setup_data() loads from flash.
+static void reboot() {
+  stats = Stats();
+  for (int i = 0; i < INGREDIENT_COUNT; i++) ingredients[i] = Ingredient();
+  setup_data();
+}
+
+static void order(int slot, int times) {
+  for (int i = 0; i < times; i++) update_stats_on_drink_order(preset_cocktails[slot], Completed);
+}
+
+static void boot_and_import() {
+  host_fs_reset();
+  write_file("/cocktails.json", PRESETS_JSON);
+  reboot();
+  printf("  imported %d presets: '%s' (id %u), '%s' (id %u), '%s' (id %u)\n", recipe_store_count(),
+         preset_cocktails[0].name, preset_cocktails[0].id, preset_cocktails[1].name, preset_cocktails[1].id,
+         preset_cocktails[2].name, preset_cocktails[2].id);
+  HOST_CHECK(recipe_store_count() == 3);
+  HOST_CHECK(strcmp(preset_cocktails[1].name, "Sea Breeze") == 0);
+  HOST_CHECK(preset_cocktails[1].amounts[2] == 30);
+  HOST_CHECK(preset_cocktails[2].id != RECIPE_ID_NONE);
+  HOST_CHECK(stats.orders_completed == 0);
+}
+
+static void checkpoint() {
+  uint32_t writes = flash_write_stats.writes;
+  std::string before = read_file("/stats.json");
+  order(0, 3);
+  order(1, 2);
+  // Orders only mark the stats dirty: nothing written on the pour path.
+  HOST_CHECK(flash_write_stats.writes == writes);
+  persist_poll(true);
+  HOST_CHECK(read_file("/stats.json") == before);
+
+  host_advance_ms(STATS_FLUSH_INTERVAL_MS);
+  persist_poll(false);  // an order is running: still waits
+  HOST_CHECK(read_file("/stats.json") == before);
+  persist_poll(true);
+  printf("  checkpoint after %lu s idle: %u write(s), %s\n", STATS_FLUSH_INTERVAL_MS / 1000,
+         flash_write_stats.writes - writes, read_file("/stats.json").c_str());
+  HOST_CHECK(read_file("/stats.json") != before);
+  HOST_CHECK(flash_write_stats.writes - writes == 1);
+  persist_poll(true);
+  HOST_CHECK(flash_write_stats.writes - writes == 1);
+
+  // Stock is written once the machine has been idle for a moment.
+  ingredients[0].amount_left_ul = 500 * UL_PER_ML;
+  mark_ingredients_dirty();
+  persist_poll(true);
+  HOST_CHECK(flash_write_stats.writes - writes == 1);
+  host_advance_ms(INGREDIENT_FLUSH_IDLE_MS);
+  persist_poll(true);
+  HOST_CHECK(flash_write_stats.writes - writes == 2);
+
+  reboot();
+  printf("  after a reboot: %d completed, '%s' %d, '%s' %d\n", stats.orders_completed, preset_cocktails[0].name,
+         stats.preset_order_counts[0].count, preset_cocktails[1].name, stats.preset_order_counts[1].count);
+  HOST_CHECK(stats.orders_completed == 5);
+  HOST_CHECK(stats.preset_drink_orders == 5);
+  HOST_CHECK(stats.preset_order_counts[0].count == 3);
+  HOST_CHECK(stats.preset_order_counts[1].count == 2);
+  HOST_CHECK(ingredients[0].amount_left_ul == 500 * UL_PER_ML);
+}
+
+static void flush_on_restart() {
+  order(1, 4);
+  stats.orders_aborted++;
+  mark_stats_dirty();
+  esp_restart();  // runs the shutdown handler
+  reboot();
+  printf("  restart before the checkpoint: %d completed, %d aborted, '%s' %d\n", stats.orders_completed,
+         stats.orders_aborted, preset_cocktails[1].name, stats.preset_order_counts[1].count);
+  HOST_CHECK(stats.orders_completed == 9);
+  HOST_CHECK(stats.orders_aborted == 1);
+  HOST_CHECK(stats.preset_order_counts[1].count == 6);
+}
+
+static void older_stock() {
+  // Float millilitres, from before integer stock.
+  write_file("/ingredients.json", "[{\"name\":\"Gin\",\"color\":31,\"amount_left\":702.25},"
+                                  "{\"name\":\"Tonic\",\"color\":2016,\"amount_left\":1500}]");
+  reboot();
+  printf("  older stock file: '%s' %d ul, '%s' %d ul\n", ingredients[0].name, ingredients[0].amount_left_ul,
+         ingredients[1].name, ingredients[1].amount_left_ul);
+  HOST_CHECK(strcmp(ingredients[0].name, "Gin") == 0);
+  HOST_CHECK(ingredients[0].color == 31);
+  HOST_CHECK(ingredients[0].amount_left_ul == 702250);
+  HOST_CHECK(ingredients[1].amount_left_ul == 1500 * UL_PER_ML);
+  HOST_CHECK(ingredients[0].density_mg_per_ml == WATER_MG_PER_ML);
+
+  // Saved again in the current format, exactly.
+  ingredients[0].amount_left_ul -= 40123;
+  ingredients[1].density_mg_per_ml = 1300;
+  HOST_CHECK(save_ingredients(ingredients));
+  reboot();
+  HOST_CHECK(ingredients[0].amount_left_ul == 662127);
+  HOST_CHECK(ingredients[1].density_mg_per_ml == 1300);
+  HOST_CHECK(read_file("/ingredients.json").find("\"amount_ul\":662127") != std::string::npos);
+}
+
+static void truncated_stats() {
+  write_file("/stats.json", "{\"orders_completed\":");
+  Stats loaded;
+  HOST_CHECK(!load_stats(loaded));
+}
+
+int main() {
+  boot_and_import();
+  checkpoint();
+  flush_on_restart();
+  older_stock();
+  truncated_stats();
+  return host_report("filesystem_test");
+}
@@ -0,0 +1,59 @@
+// Forecast warnings (forecast.cpp via notifyOnMissing() after each pour):
+// a warning that no app received is not marked as given, so it goes out on
+// the first pour after the app connects, and only once.
+#include "host.h"
+#include "pour_plant.h"
+#include "fakes.h"
+#include "motors_sensors.h"
+#include "forecast.h"
+
+static const int STOCK_ML = 300;
+static const int POUR_ML = 40;
+
+// One drink of the first ingredient, a minute after the last one.
+static void pour_one() {
+  PlantConfig config;
+  config.flow_g_per_s = 25;
+  plant_reset(config);
+  return_to_main_menu();
+  Cocktail cocktail = {};
+  strcpy(cocktail.name, "Forecast");
+  cocktail.amounts[0] = POUR_ML;
+  pour_drink(cocktail, Medium);
+  host_advance_ms(60000);
+}
+
+static void report(const char* step) {
+  printf("  %-30s %3d ml left, %5.1f min to empty, %d push(es), %s\n", step, stock_ml(ingredients[0]),
+         forecast_minutes_to_empty(0), fake_log.pushes[0], forecast_warned(0) ? "warned" : "not warned");
+}
+
+int main() {
+  setup_motors();
+  fakes_reset(STOCK_ML);
+  forecast_lead_minutes = 60;
+
+  pour_one();
+  report("first drink");
+  HOST_CHECK(forecast_minutes_to_empty(0) > forecast_lead_minutes);
+  HOST_CHECK(!forecast_warned(0));
+
+  // Running out within the lead time, but nobody is listening.
+  fake_app_connected = false;
+  pour_one();
+  report("second drink, app away");
+  HOST_CHECK(forecast_minutes_to_empty(0) < forecast_lead_minutes);
+  HOST_CHECK(fake_log.pushes[0] == 0);
+  HOST_CHECK(!forecast_warned(0));
+
+  fake_app_connected = true;
+  pour_one();
+  report("third drink, app back");
+  HOST_CHECK(fake_log.pushes[0] == 1);
+  HOST_CHECK(forecast_warned(0));
+
+  pour_one();
+  report("fourth drink");
+  HOST_CHECK(fake_log.pushes[0] == 1);
+  return host_report("forecast_warning_test");
+}
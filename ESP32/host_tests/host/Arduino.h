@@ -0,0 +1,165 @@
+// Host stand-in for the Arduino core, enough to build the firmware modules
+// on a PC. Time is simulated: millis() only moves when a test (or delay(),
+// or a simulated peripheral) advances it. See host.h for the controls.
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+typedef uint8_t byte;
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
+#define INPUT 0
+#define INPUT_PULLUP 2
+#define FALLING 2
+#define RISING 1
+#define IRAM_ATTR
+#define A0 36
+
+class String {
+public:
+  std::string s;
+  String() {}
+  String(const char* c) : s(c ? c : "") {}
+  String(const std::string& c) : s(c) {}
+  String(char c) : s(1, c) {}
+  String(int v) : s(std::to_string(v)) {}
+  String(unsigned v) : s(std::to_string(v)) {}
+  String(long v) : s(std::to_string(v)) {}
+  String(unsigned long v) : s(std::to_string(v)) {}
+  String(float v, int decimals = 2) { format(v, decimals); }
+  String(double v, int decimals = 2) { format(v, decimals); }
+  const char* c_str() const { return s.c_str(); }
+  unsigned length() const { return s.size(); }
+  String substring(unsigned from, unsigned to) const { return s.substr(from, to - from); }
+  String substring(unsigned from) const { return s.substr(from); }
+  int indexOf(char c) const { size_t at = s.find(c); return at == std::string::npos ? -1 : (int)at; }
+  bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator!=(const String& o) const { return s != o.s; }
+  bool operator==(const char* o) const { return s == o; }
+  String& operator+=(const String& o) { s += o.s; return *this; }
+  String& operator+=(const char* o) { s += o; return *this; }
+  String& operator+=(char o) { s += o; return *this; }
+  bool reserve(unsigned n) { s.reserve(n); return true; }
+  char operator[](unsigned i) const { return s[i]; }
+  long toInt() const { return atol(s.c_str()); }
+  float toFloat() const { return atof(s.c_str()); }
+  void trim() {
+    size_t first = s.find_first_not_of(" \t\r\n");
+    size_t last = s.find_last_not_of(" \t\r\n");
+    s = first == std::string::npos ? "" : s.substr(first, last - first + 1);
+  }
+private:
+  void format(double v, int decimals) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, v);
+    s = buffer;
+  }
+};
+inline String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+inline String operator+(const String& a, const char* b) { return String(a.s + b); }
+inline String operator+(const char* a, const String& b) { return String(a + b.s); }
+
+// Serial output is dropped unless host_serial_echo is set (HOST_SERIAL=1).
+extern bool host_serial_echo;
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) { return write(&c, 1); }
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    if (host_serial_echo) fwrite(buffer, 1, size, stdout);
+    return size;
+  }
+  size_t print(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+  size_t print(const String& text) { return print(text.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+  template <typename T> size_t println(const T& v) { return print(v) + println(); }
+  size_t println(double v, int decimals) { return print(v, decimals) + println(); }
+  size_t println() { return print("\n"); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return write((const uint8_t*)buffer, std::min(length, (int)sizeof(buffer) - 1));
+  }
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  operator bool() const { return true; }
+  int available() { return 0; }
+  int read() { return -1; }
+  void flush() {}
+  String readStringUntil(char) { return String(); }
+};
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int level);
+int digitalRead(int pin);
+int analogRead(int pin);
+void analogReadResolution(int bits);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+using std::min;
+using std::max;
+template <typename T> T constrain(T x, T a, T b) { return x < a ? a : (x > b ? b : x); }
+
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void detachInterrupt(int) {}
+inline void attachInterruptArg(int, void (*)(void*), void*, int) {}
+inline int digitalPinToInterrupt(int pin) { return pin; }
+
+class EspClass {
+public:
+  uint32_t getCycleCount();
+  uint32_t getFreeHeap() { return 200000; }
+  uint32_t getMaxAllocHeap() { return 100000; }
+  uint32_t getMinFreeHeap() { return 150000; }
+  void restart() {}
+};
+extern EspClass ESP;
+
+typedef struct {
+  uint8_t pin;
+  uint8_t channel;
+  int avg_read_raw;
+  int avg_read_mvolts;
+} adc_continuous_result_t;
+bool analogContinuous(const uint8_t pins[], size_t pins_count, uint32_t conversions_per_pin,
+                      uint32_t sampling_freq_hz, void (*userFunc)(void));
+bool analogContinuousRead(adc_continuous_result_t** buffer, uint32_t timeout_ms);
+bool analogContinuousStart();
+bool analogContinuousStop();
+
+// The Arduino build defines ARDUINO on the command line; so does the Makefile.
+#ifndef ARDUINO
+#define ARDUINO 10800
+#endif
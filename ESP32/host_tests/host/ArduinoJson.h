@@ -0,0 +1,370 @@
+// The parts of ArduinoJson 6 the firmware uses, as a small DOM: documents,
+// objects and arrays, reading with `|` defaults, nested creation, iteration,
+// and serializeJson()/deserializeJson() on files, Print and String. Document
+// capacity is not enforced; the firmware's sizes are checked on the device.
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace host_json {
+
+struct Node;
+typedef std::shared_ptr<Node> NodePtr;
+
+struct Node {
+  enum Kind { Null, Bool, Int, Float, Text, Array, Object } kind = Null;
+  bool boolean = false;
+  int64_t integer = 0;
+  double real = 0;
+  std::string text;
+  std::vector<NodePtr> items;                           // Array
+  std::vector<std::pair<std::string, NodePtr>> members; // Object, in insertion order
+
+  void reset(Kind to) {
+    *this = Node();
+    kind = to;
+  }
+  Node* member(const std::string& key) const {
+    for (const auto& entry : members) {
+      if (entry.first == key) return entry.second.get();
+    }
+    return nullptr;
+  }
+};
+
+void write(const Node& node, std::string& out);
+bool parse(const char*& at, const char* end, Node& node, int depth);
+
+}  // namespace host_json
+
+class JsonArray;
+class JsonObject;
+
+// A value in a document, or where one would be: reading a missing member or
+// element gives null, assigning to it creates it.
+class JsonVariant {
+public:
+  JsonVariant() {}
+  explicit JsonVariant(host_json::NodePtr node) : node_(std::move(node)) {}
+  JsonVariant(host_json::NodePtr parent, std::string key) : parent_(std::move(parent)), key_(std::move(key)) {}
+
+  bool isNull() const {
+    const host_json::Node* node = get();
+    return !node || node->kind == host_json::Node::Null;
+  }
+
+  template <typename T>
+  T as() const;
+
+  template <typename T>
+  operator T() const { return as<T>(); }
+
+  template <typename T>
+  T operator|(T fallback) const {
+    const host_json::Node* node = get();
+    if (!node) return fallback;
+    if (std::is_floating_point<T>::value) {
+      if (node->kind == host_json::Node::Float || node->kind == host_json::Node::Int) return as<T>();
+    } else if (node->kind == host_json::Node::Int || node->kind == host_json::Node::Bool) {
+      return as<T>();
+    }
+    return fallback;
+  }
+  const char* operator|(const char* fallback) const {
+    const host_json::Node* node = get();
+    return node && node->kind == host_json::Node::Text ? node->text.c_str() : fallback;
+  }
+
+  template <typename T>
+  JsonVariant& operator=(const T& value) {
+    set(make(), value);
+    return *this;
+  }
+  JsonVariant& operator=(const JsonVariant& other) {
+    const host_json::Node* source = other.get();
+    host_json::Node& target = make();
+    if (source) {
+      host_json::Node copy = *source;
+      target = copy;
+    } else {
+      target.reset(host_json::Node::Null);
+    }
+    return *this;
+  }
+  JsonVariant(const JsonVariant&) = default;
+
+  JsonVariant operator[](const char* key) const { return member(key); }
+  JsonVariant operator[](const String& key) const { return member(key.c_str()); }
+  JsonVariant operator[](int index) const {
+    const host_json::Node* node = get();
+    if (!node || node->kind != host_json::Node::Array || index < 0 || index >= (int)node->items.size()) {
+      return JsonVariant();
+    }
+    return JsonVariant(node->items[index]);
+  }
+
+  bool containsKey(const char* key) const {
+    const host_json::Node* node = get();
+    return node && node->kind == host_json::Node::Object && node->member(key);
+  }
+  size_t size() const {
+    const host_json::Node* node = get();
+    if (!node) return 0;
+    if (node->kind == host_json::Node::Array) return node->items.size();
+    if (node->kind == host_json::Node::Object) return node->members.size();
+    return 0;
+  }
+
+  JsonArray createNestedArray(const char* key);
+  JsonObject createNestedObject(const char* key);
+
+  // The node this refers to, or null if it does not exist yet.
+  host_json::NodePtr ptr() const {
+    if (node_ || !parent_ || parent_->kind != host_json::Node::Object) return node_;
+    for (const auto& entry : parent_->members) {
+      if (entry.first == key_) return entry.second;
+    }
+    return nullptr;
+  }
+  host_json::Node* get() const { return ptr().get(); }
+
+  // Creates the node (and turns a null parent into an object) on first write.
+  host_json::Node& make() {
+    if (!node_) node_ = ptr();
+    if (node_) return *node_;
+    node_ = std::make_shared<host_json::Node>();
+    if (parent_) {
+      if (parent_->kind != host_json::Node::Object) parent_->reset(host_json::Node::Object);
+      parent_->members.emplace_back(key_, node_);
+    }
+    return *node_;
+  }
+
+protected:
+  // A member of this object; one that does not exist is created on write.
+  JsonVariant member(const char* key) const {
+    host_json::NodePtr node = ptr();
+    return node ? JsonVariant(node, std::string(key)) : JsonVariant();
+  }
+
+  static void set(host_json::Node& node, const char* value) {
+    if (!value) {
+      node.reset(host_json::Node::Null);
+      return;
+    }
+    node.reset(host_json::Node::Text);
+    node.text = value;
+  }
+  static void set(host_json::Node& node, char* value) { set(node, (const char*)value); }
+  static void set(host_json::Node& node, const String& value) { set(node, value.c_str()); }
+  static void set(host_json::Node& node, const std::string& value) { set(node, value.c_str()); }
+  template <typename T>
+  static typename std::enable_if<std::is_arithmetic<T>::value>::type set(host_json::Node& node, T value) {
+    if (std::is_same<T, bool>::value) {
+      node.reset(host_json::Node::Bool);
+      node.boolean = value;
+    } else if (std::is_floating_point<T>::value) {
+      node.reset(host_json::Node::Float);
+      node.real = value;
+    } else {
+      node.reset(host_json::Node::Int);
+      node.integer = (int64_t)value;
+    }
+  }
+  template <typename T>
+  static typename std::enable_if<std::is_enum<T>::value>::type set(host_json::Node& node, T value) {
+    set(node, (int64_t)value);
+  }
+
+  host_json::NodePtr node_;
+  host_json::NodePtr parent_;
+  std::string key_;
+};
+
+class JsonObject : public JsonVariant {
+public:
+  JsonObject() {}
+  explicit JsonObject(host_json::NodePtr node) : JsonVariant(std::move(node)) {}
+  using JsonVariant::operator=;
+};
+
+class JsonArray : public JsonVariant {
+public:
+  JsonArray() {}
+  explicit JsonArray(host_json::NodePtr node) : JsonVariant(std::move(node)) {}
+  using JsonVariant::operator=;
+
+  JsonVariant add() {
+    host_json::Node* node = get();
+    if (!node || node->kind != host_json::Node::Array) return JsonVariant();
+    node->items.push_back(std::make_shared<host_json::Node>());
+    return JsonVariant(node->items.back());
+  }
+  template <typename T>
+  bool add(const T& value) {
+    JsonVariant slot = add();
+    if (!get()) return false;
+    slot = value;
+    return true;
+  }
+  JsonObject createNestedObject() {
+    JsonVariant slot = add();
+    if (!get()) return JsonObject();
+    slot.make().reset(host_json::Node::Object);
+    return slot.as<JsonObject>();
+  }
+  JsonArray createNestedArray() {
+    JsonVariant slot = add();
+    if (!get()) return JsonArray();
+    slot.make().reset(host_json::Node::Array);
+    return slot.as<JsonArray>();
+  }
+
+  class iterator {
+  public:
+    iterator(const host_json::NodePtr* at) : at_(at) {}
+    JsonVariant operator*() const { return JsonVariant(*at_); }
+    iterator& operator++() {
+      ++at_;
+      return *this;
+    }
+    bool operator!=(const iterator& other) const { return at_ != other.at_; }
+  private:
+    const host_json::NodePtr* at_;
+  };
+  iterator begin() const {
+    host_json::Node* node = get();
+    return iterator(node && node->kind == host_json::Node::Array ? node->items.data() : nullptr);
+  }
+  iterator end() const {
+    host_json::Node* node = get();
+    return iterator(node && node->kind == host_json::Node::Array ? node->items.data() + node->items.size() : nullptr);
+  }
+};
+
+template <typename T>
+T JsonVariant::as() const {
+  const host_json::Node* node = get();
+  if constexpr (std::is_same<T, JsonObject>::value || std::is_same<T, JsonArray>::value) {
+    host_json::Node::Kind kind = std::is_same<T, JsonObject>::value ? host_json::Node::Object : host_json::Node::Array;
+    return node && node->kind == kind ? T(ptr()) : T();
+  } else if constexpr (std::is_same<T, JsonVariant>::value) {
+    return *this;
+  } else if constexpr (std::is_same<T, const char*>::value) {
+    return node && node->kind == host_json::Node::Text ? node->text.c_str() : nullptr;
+  } else if constexpr (std::is_same<T, String>::value) {
+    return node && node->kind == host_json::Node::Text ? String(node->text) : String();
+  } else if constexpr (std::is_arithmetic<T>::value || std::is_enum<T>::value) {
+    if (!node) return T();
+    switch (node->kind) {
+      case host_json::Node::Bool: return (T)node->boolean;
+      case host_json::Node::Int: return (T)node->integer;
+      case host_json::Node::Float: return (T)node->real;
+      case host_json::Node::Text: return std::is_floating_point<T>::value ? (T)atof(node->text.c_str()) : (T)atoll(node->text.c_str());
+      default: return T();
+    }
+  } else {
+    static_assert(sizeof(T) == 0, "conversion not supported by the host ArduinoJson");
+  }
+}
+
+inline JsonArray JsonVariant::createNestedArray(const char* key) {
+  host_json::Node& self = make();
+  if (self.kind != host_json::Node::Object) self.reset(host_json::Node::Object);
+  JsonVariant slot(node_, std::string(key));
+  slot.make().reset(host_json::Node::Array);
+  return slot.as<JsonArray>();
+}
+
+inline JsonObject JsonVariant::createNestedObject(const char* key) {
+  host_json::Node& self = make();
+  if (self.kind != host_json::Node::Object) self.reset(host_json::Node::Object);
+  JsonVariant slot(node_, std::string(key));
+  slot.make().reset(host_json::Node::Object);
+  return slot.as<JsonObject>();
+}
+
+class DeserializationError {
+public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory, TooDeep };
+  DeserializationError(Code code = Ok) : code_(code) {}
+  explicit operator bool() const { return code_ != Ok; }
+  bool operator==(Code code) const { return code_ == code; }
+  bool operator!=(Code code) const { return code_ != code; }
+  Code code() const { return code_; }
+  const char* c_str() const {
+    static const char* const names[] = { "Ok", "EmptyInput", "IncompleteInput", "InvalidInput", "NoMemory", "TooDeep" };
+    return names[code_];
+  }
+private:
+  Code code_;
+};
+
+class JsonDocument {
+public:
+  explicit JsonDocument(size_t capacity = 0) : root_(std::make_shared<host_json::Node>()), capacity_(capacity) {}
+  JsonDocument(const JsonDocument& other) : root_(std::make_shared<host_json::Node>(*other.root_)), capacity_(other.capacity_) {}
+  JsonDocument& operator=(const JsonDocument& other) {
+    *root_ = *other.root_;
+    return *this;
+  }
+
+  template <typename T>
+  T to() {
+    static_assert(std::is_same<T, JsonObject>::value || std::is_same<T, JsonArray>::value, "to<JsonObject> or to<JsonArray>");
+    root_->reset(std::is_same<T, JsonObject>::value ? host_json::Node::Object : host_json::Node::Array);
+    return T(root_);
+  }
+  template <typename T>
+  T as() const { return JsonVariant(root_).as<T>(); }
+  template <typename T>
+  bool is() const {
+    if (std::is_same<T, JsonObject>::value) return root_->kind == host_json::Node::Object;
+    if (std::is_same<T, JsonArray>::value) return root_->kind == host_json::Node::Array;
+    return false;
+  }
+
+  JsonVariant operator[](const char* key) const { return JsonVariant(root_)[key]; }
+  JsonVariant operator[](const String& key) const { return JsonVariant(root_)[key.c_str()]; }
+  JsonVariant operator[](int index) const { return JsonVariant(root_)[index]; }
+  bool containsKey(const char* key) const { return JsonVariant(root_).containsKey(key); }
+  size_t size() const { return JsonVariant(root_).size(); }
+  bool isNull() const { return root_->kind == host_json::Node::Null; }
+  void clear() { root_->reset(host_json::Node::Null); }
+  size_t capacity() const { return capacity_; }
+  bool overflowed() const { return false; }
+  JsonArray createNestedArray(const char* key) { return JsonVariant(root_).createNestedArray(key); }
+  JsonObject createNestedObject(const char* key) { return JsonVariant(root_).createNestedObject(key); }
+
+  const host_json::Node& root() const { return *root_; }
+  host_json::Node& root() { return *root_; }
+
+private:
+  host_json::NodePtr root_;
+  size_t capacity_;
+};
+
+template <size_t CAPACITY>
+class StaticJsonDocument : public JsonDocument {
+public:
+  StaticJsonDocument() : JsonDocument(CAPACITY) {}
+};
+
+class DynamicJsonDocument : public JsonDocument {
+public:
+  explicit DynamicJsonDocument(size_t capacity) : JsonDocument(capacity) {}
+};
+
+size_t serializeJson(const JsonDocument& document, Print& out);
+size_t serializeJson(const JsonDocument& document, String& out);
+size_t serializeJson(const JsonDocument& document, char* out, size_t size);
+size_t measureJson(const JsonDocument& document);
+DeserializationError deserializeJson(JsonDocument& document, fs::File& in);
+DeserializationError deserializeJson(JsonDocument& document, const String& in);
+DeserializationError deserializeJson(JsonDocument& document, const char* in);
+DeserializationError deserializeJson(JsonDocument& document, const char* in, size_t length);
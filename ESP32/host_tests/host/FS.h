@@ -0,0 +1,90 @@
+// Host stand-in for the Arduino FS API: files live in a scratch directory
+// (host_fs_root()), so tests can inspect and corrupt them like flash.
+#pragma once
+#include <Arduino.h>
+#include <memory>
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+const char* host_fs_root();
+void host_fs_closed(const char* path, size_t bytes_written);
+
+namespace fs {
+
+class File : public Print {
+public:
+  File() {}
+  File(FILE* handle, const std::string& path) : open_file(std::make_shared<OpenFile>(handle, path)), path(path) {}
+  operator bool() const { return open_file != nullptr; }
+  void close() { open_file.reset(); }
+  size_t read(uint8_t* buffer, size_t size) { return open_file ? fread(buffer, 1, size, handle()) : 0; }
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  using Print::write;
+  size_t write(const uint8_t* buffer, size_t size) override {
+    if (!open_file) return 0;
+    size_t written = fwrite(buffer, 1, size, handle());
+    open_file->written += written;
+    return written;
+  }
+  bool seek(uint32_t position, SeekMode mode = SeekSet) {
+    return open_file && fseek(handle(), position, mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END) == 0;
+  }
+  size_t position() { return open_file ? ftell(handle()) : 0; }
+  size_t size() {
+    if (!open_file) return 0;
+    long here = ftell(handle());
+    fseek(handle(), 0, SEEK_END);
+    long end = ftell(handle());
+    fseek(handle(), here, SEEK_SET);
+    return end;
+  }
+  int available() { return (int)(size() - position()); }
+  void flush() { if (open_file) fflush(handle()); }
+  const char* name() { return path.c_str(); }
+
+private:
+  // Shared by copies, like the firmware's handle; closed with the last one,
+  // which is when the bytes written reach flash (host_fs_closed()).
+  struct OpenFile {
+    FILE* handle;
+    std::string path;
+    size_t written = 0;
+    OpenFile(FILE* handle, const std::string& path) : handle(handle), path(path) {}
+    ~OpenFile() {
+      fclose(handle);
+      host_fs_closed(path.c_str(), written);
+    }
+  };
+  FILE* handle() { return open_file->handle; }
+
+  std::shared_ptr<OpenFile> open_file;
+  std::string path;
+};
+
+class FS {
+public:
+  File open(const char* path, const char* mode = "r", bool create = false) {
+    std::string full = host_path(path);
+    std::string host_mode = std::string(mode) + "b";
+    // LittleFS opens "r+" only on existing files, like fopen.
+    FILE* handle = fopen(full.c_str(), host_mode.c_str());
+    return handle ? File(handle, path) : File();
+  }
+  bool exists(const char* path) {
+    FILE* handle = fopen(host_path(path).c_str(), "rb");
+    if (handle) fclose(handle);
+    return handle != nullptr;
+  }
+  bool remove(const char* path) { return ::remove(host_path(path).c_str()) == 0; }
+  bool rename(const char* from, const char* to) {
+    return ::rename(host_path(from).c_str(), host_path(to).c_str()) == 0;
+  }
+
+private:
+  static std::string host_path(const char* path) { return std::string(host_fs_root()) + path; }
+};
+
+}  // namespace fs
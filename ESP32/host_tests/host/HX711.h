@@ -0,0 +1,30 @@
+// Simulated HX711 with the bogde library's interface, for HX711_BITBANG
+// builds. Conversions come from the source given to host_hx711_attach().
+#pragma once
+#include <Arduino.h>
+
+class HX711 {
+public:
+  void begin(uint8_t dout, uint8_t pd_sck, uint8_t gain = 128) {}
+  bool is_ready();
+  void wait_ready(unsigned long delay_ms = 0);
+  bool wait_ready_timeout(unsigned long timeout = 1000, unsigned long delay_ms = 0);
+  void set_gain(uint8_t gain = 128) {}
+  long read();
+  long read_average(uint8_t times = 10);
+  double get_value(uint8_t times = 1) { return read_average(times) - offset; }
+  float get_units(uint8_t times = 1) { return get_value(times) / scale; }
+  void tare(uint8_t times = 10) { set_offset(read_average(times)); }
+  void set_scale(float new_scale = 1.f) { scale = new_scale; }
+  float get_scale() { return scale; }
+  void set_offset(long new_offset = 0) { offset = new_offset; }
+  long get_offset() { return offset; }
+  void power_down() {}
+  void power_up() {}
+
+private:
+  long offset = 0;
+  float scale = 1.f;
+  long last_value = 0;
+  uint64_t last_read_us = 0;  // a conversion is ready once a period boundary passed since
+};
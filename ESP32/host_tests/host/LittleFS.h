@@ -0,0 +1,12 @@
+#pragma once
+#include <FS.h>
+
+class LittleFSFS : public fs::FS {
+public:
+  // Host storage cannot fail to mount unless a test says so.
+  bool begin(bool format_on_fail = false) { return !host_littlefs_broken; }
+  size_t totalBytes() { return 1024 * 1024; }
+  size_t usedBytes() { return 0; }
+  bool host_littlefs_broken = false;
+};
+extern LittleFSFS LittleFS;
@@ -0,0 +1,5 @@
+#pragma once
+#include <Arduino.h>
+#define VSPI 3
+#define HSPI 2
+class SPIClass { public: SPIClass(int) {} void begin(int,int,int,int); };
@@ -0,0 +1,21 @@
+#pragma once
+// Declarations only: the screen is not simulated, menu.cpp is not built on the host.
+#include <Arduino.h>
+#define TFT_BLACK 0
+#define TFT_WHITE 0xFFFF
+#define TFT_RED 0xF800
+#define TFT_ORANGE 0xFDA0
+#define TFT_BLUE 0x001F
+#define TFT_DARKGREY 0x7BEF
+#define TFT_GREEN 0x07E0
+#define TFT_YELLOW 0xFFE0
+#define MC_DATUM 4
+#define TL_DATUM 0
+class TFT_eSPI : public Print { public:
+  void init(); void setRotation(int); void setTextColor(uint16_t); void setTextColor(uint16_t, uint16_t);
+  void setTextSize(int); void fillScreen(uint16_t); void fillRect(int,int,int,int,uint16_t); void drawRect(int,int,int,int,uint16_t);
+  void drawLine(int,int,int,int,uint16_t); void setCursor(int,int); int16_t textWidth(const String&); int16_t textWidth(const char*);
+  void setTextDatum(int); void drawString(const String&, int, int); void drawString(const char*, int, int);
+  void fillRoundRect(int,int,int,int,int,uint16_t); void fillCircle(int,int,int,uint16_t); };
+#define TFT_LIGHTGREY 0xD69A
+#define ML_DATUM 3
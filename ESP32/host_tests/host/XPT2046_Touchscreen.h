@@ -0,0 +1,4 @@
+#pragma once
+#include <SPI.h>
+struct TS_Point { int16_t x, y, z; };
+class XPT2046_Touchscreen { public: XPT2046_Touchscreen(int, int) {} bool begin(SPIClass&); void setRotation(int); bool touched(); TS_Point getPoint(); };
@@ -0,0 +1,6 @@
+#pragma once
+#include <Arduino.h>
+
+typedef void (*shutdown_handler_t)(void);
+int esp_register_shutdown_handler(shutdown_handler_t handler);
+void esp_restart();
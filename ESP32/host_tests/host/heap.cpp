@@ -0,0 +1,78 @@
+// Counts the host process's heap blocks and bytes by wrapping glibc's
+// allocator, so heap_caps_get_info() sees what the firmware code allocated.
+#include <esp_heap_caps.h>
+#include <malloc.h>
+#include <string.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+static const size_t SIMULATED_HEAP_BYTES = 300 * 1024;
+
+static size_t live_blocks = 0;
+static size_t live_bytes = 0;
+static size_t lowest_free = SIMULATED_HEAP_BYTES;
+
+static void* counted(void* pointer) {
+  if (pointer) {
+    live_blocks++;
+    live_bytes += malloc_usable_size(pointer);
+    if (live_bytes < SIMULATED_HEAP_BYTES && SIMULATED_HEAP_BYTES - live_bytes < lowest_free) {
+      lowest_free = SIMULATED_HEAP_BYTES - live_bytes;
+    }
+  }
+  return pointer;
+}
+
+static void uncount(void* pointer) {
+  if (pointer) {
+    live_blocks--;
+    live_bytes -= malloc_usable_size(pointer);
+  }
+}
+
+extern "C" {
+void* malloc(size_t size) { return counted(__libc_malloc(size)); }
+void* calloc(size_t count, size_t size) { return counted(__libc_calloc(count, size)); }
+void* memalign(size_t alignment, size_t size) { return counted(__libc_memalign(alignment, size)); }
+void* aligned_alloc(size_t alignment, size_t size) { return memalign(alignment, size); }
+int posix_memalign(void** out, size_t alignment, size_t size) {
+  *out = memalign(alignment, size);
+  return *out || size == 0 ? 0 : 12;  // ENOMEM
+}
+void free(void* pointer) {
+  uncount(pointer);
+  __libc_free(pointer);
+}
+void* realloc(void* pointer, size_t size) {
+  uncount(pointer);
+  void* moved = __libc_realloc(pointer, size);
+  if (!moved && size && pointer) {
+    counted(pointer);  // the old block is still there
+    return nullptr;
+  }
+  return counted(moved);
+}
+}
+
+static size_t free_bytes() {
+  return live_bytes < SIMULATED_HEAP_BYTES ? SIMULATED_HEAP_BYTES - live_bytes : 0;
+}
+
+void heap_caps_get_info(multi_heap_info_t* info, uint32_t) {
+  memset(info, 0, sizeof(*info));
+  info->total_free_bytes = free_bytes();
+  info->total_allocated_bytes = live_bytes;
+  info->largest_free_block = free_bytes();
+  info->minimum_free_bytes = lowest_free;
+  info->allocated_blocks = live_blocks;
+  info->total_blocks = live_blocks;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t) { return free_bytes(); }
+size_t heap_caps_get_free_size(uint32_t) { return free_bytes(); }
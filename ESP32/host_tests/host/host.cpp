@@ -0,0 +1,207 @@
+#include "host.h"
+#include <FS.h>
+#include <LittleFS.h>
+#include <HX711.h>
+#include <esp_system.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <x86intrin.h>
+#include "machine_config.h"
+
+bool host_serial_echo = getenv("HOST_SERIAL") != nullptr;
+HardwareSerial Serial;
+EspClass ESP;
+LittleFSFS LittleFS;
+
+uint64_t host_time_us = 0;
+int host_pin_level[HOST_PIN_COUNT] = {};
+int host_analog_value[HOST_PIN_COUNT] = {};
+unsigned host_pin_writes[HOST_PIN_COUNT] = {};
+int host_failures = 0;
+
+static void (*tick_hook)(uint64_t now_us) = nullptr;
+
+void host_set_tick_hook(void (*hook)(uint64_t now_us)) {
+  tick_hook = hook;
+}
+
+void host_advance_us(uint64_t us) {
+  host_time_us += us;
+  if (tick_hook) tick_hook(host_time_us);
+}
+
+void host_advance_ms(unsigned long ms) {
+  host_advance_us((uint64_t)ms * 1000);
+}
+
+unsigned long millis() { return (unsigned long)(host_time_us / 1000); }
+unsigned long micros() { return (unsigned long)host_time_us; }
+void delay(unsigned long ms) { host_advance_ms(ms); }
+void delayMicroseconds(unsigned int us) { host_advance_us(us); }
+void yield() {}
+
+void pinMode(int, int) {}
+void digitalWrite(int pin, int level) {
+  if (pin >= 0 && pin < HOST_PIN_COUNT) {
+    host_pin_level[pin] = level;
+    host_pin_writes[pin]++;
+  }
+}
+int digitalRead(int pin) {
+  return pin >= 0 && pin < HOST_PIN_COUNT ? host_pin_level[pin] : LOW;
+}
+int analogRead(int pin) {
+  return pin >= 0 && pin < HOST_PIN_COUNT ? host_analog_value[pin] : 0;
+}
+void analogReadResolution(int) {}
+
+// The ADC continuous driver is not simulated: the light sensor reports as
+// missing unless a test installs its own CupPresenceSensor.
+bool analogContinuous(const uint8_t[], size_t, uint32_t, uint32_t, void (*)(void)) { return false; }
+bool analogContinuousRead(adc_continuous_result_t**, uint32_t) { return false; }
+bool analogContinuousStart() { return false; }
+bool analogContinuousStop() { return true; }
+
+long random(long max_value) { return max_value > 0 ? rand() % max_value : 0; }
+long random(long min_value, long max_value) {
+  return max_value > min_value ? min_value + rand() % (max_value - min_value) : min_value;
+}
+void randomSeed(unsigned long seed) { srand(seed); }
+
+uint64_t host_cycles() { return __rdtsc(); }
+uint32_t EspClass::getCycleCount() { return (uint32_t)host_cycles(); }
+
+// HX711 ----------------------------------------------------------------------
+
+static bool (*hx711_source)(uint64_t now_us, long& raw) = nullptr;
+static int hx711_rate_pin = -1;
+
+void host_hx711_attach(bool (*source)(uint64_t now_us, long& raw), int rate_pin) {
+  hx711_source = source;
+  hx711_rate_pin = rate_pin;
+}
+
+uint64_t host_hx711_period_us() {
+  return hx711_rate_pin >= 0 && digitalRead(hx711_rate_pin) == HIGH ? 12500 : 100000;
+}
+
+static bool hx711_connected() {
+  long ignored;
+  return hx711_source && hx711_source(host_time_us, ignored);
+}
+
+bool HX711::is_ready() {
+  uint64_t period = host_hx711_period_us();
+  return hx711_connected() && host_time_us / period > last_read_us / period;
+}
+
+bool HX711::wait_ready_timeout(unsigned long timeout, unsigned long) {
+  uint64_t deadline = host_time_us + (uint64_t)timeout * 1000;
+  while (!is_ready()) {
+    if (host_time_us >= deadline) return false;
+    uint64_t period = host_hx711_period_us();
+    uint64_t next = (host_time_us / period + 1) * period;
+    host_advance_us(std::min(next, deadline) - host_time_us);
+  }
+  return true;
+}
+
+void HX711::wait_ready(unsigned long delay_ms) {
+  // The real library spins forever on a missing chip; give up after a minute
+  // of simulated time so a broken test cannot hang.
+  wait_ready_timeout(60000, delay_ms);
+}
+
+long HX711::read() {
+  wait_ready();
+  last_read_us = host_time_us;
+  long raw;
+  if (hx711_source && hx711_source(host_time_us, raw)) {
+    last_value = raw;
+  }
+  return last_value;
+}
+
+long HX711::read_average(uint8_t times) {
+  if (times < 1) times = 1;
+  int64_t sum = 0;
+  for (uint8_t i = 0; i < times; i++) sum += read();
+  return (long)(sum / times);
+}
+
+// Filesystem -----------------------------------------------------------------
+
+static std::string fs_root;
+
+static std::map<std::string, unsigned> fs_write_counts;
+
+const char* host_fs_root() {
+  if (fs_root.empty()) host_fs_reset();
+  return fs_root.c_str();
+}
+
+void host_fs_reset() {
+  if (fs_root.empty()) {
+    char pattern[] = "/tmp/cocktail_host_fs_XXXXXX";
+    fs_root = mkdtemp(pattern);
+  }
+  fs_write_counts.clear();
+  std::string command = "rm -rf '" + fs_root + "'/* 2>/dev/null";
+  if (system(command.c_str()) != 0) {
+    fprintf(stderr, "could not empty %s\n", fs_root.c_str());
+  }
+}
+
+HostFlashCost host_flash_cost;
+
+unsigned host_fs_write_count(const char* path) {
+  auto found = fs_write_counts.find(path);
+  return found == fs_write_counts.end() ? 0 : found->second;
+}
+
+void host_fs_closed(const char* path, size_t bytes_written) {
+  if (bytes_written == 0) return;
+  fs_write_counts[path]++;
+  const size_t SECTOR_SIZE = 4096;
+  const size_t PAGE_SIZE = 256;
+  host_advance_us((uint64_t)host_flash_cost.sector_erase_us * ((bytes_written + SECTOR_SIZE - 1) / SECTOR_SIZE) +
+                  (uint64_t)host_flash_cost.page_program_us * ((bytes_written + PAGE_SIZE - 1) / PAGE_SIZE));
+}
+
+static std::vector<shutdown_handler_t> shutdown_handlers;
+
+int esp_register_shutdown_handler(shutdown_handler_t handler) {
+  shutdown_handlers.push_back(handler);
+  return 0;
+}
+
+void host_run_shutdown_handlers() {
+  for (shutdown_handler_t handler : shutdown_handlers) handler();
+}
+
+void esp_restart() {
+  host_run_shutdown_handlers();
+}
+
+int host_report(const char* test_name) {
+  if (!fs_root.empty()) {
+    std::string command = "rm -rf '" + fs_root + "'";
+    if (system(command.c_str()) != 0) {
+      fprintf(stderr, "could not remove %s\n", fs_root.c_str());
+    }
+  }
+  // Builds for a larger machine say so, e.g. "pour_safety_test (8 pumps, 9 slots)".
+  char name[96];
+  if (Machine::pump_count != 4 || Machine::preset_slots != 9) {
+    snprintf(name, sizeof(name), "%s (%d pumps, %d slots)", test_name, Machine::pump_count, Machine::preset_slots);
+  } else {
+    snprintf(name, sizeof(name), "%s", test_name);
+  }
+  if (host_failures) {
+    printf("%s: %d check(s) FAILED\n", name, host_failures);
+    return 1;
+  }
+  printf("%s: OK\n", name);
+  return 0;
+}
@@ -0,0 +1,82 @@
+// Controls of the simulated board, for tests.
+#pragma once
+#include <Arduino.h>
+
+const int HOST_PIN_COUNT = 64;
+
+// Simulated time in microseconds since boot.
+extern uint64_t host_time_us;
+// Pin levels as last written by digitalWrite(), and values for analogRead().
+extern int host_pin_level[HOST_PIN_COUNT];
+extern int host_analog_value[HOST_PIN_COUNT];
+// digitalWrite() calls per pin, repeated levels included.
+extern unsigned host_pin_writes[HOST_PIN_COUNT];
+
+/*
+Moves simulated time forward. Every delay() and every simulated conversion
+goes through here, so a plant model can follow along via the tick hook.
+*/
+void host_advance_us(uint64_t us);
+void host_advance_ms(unsigned long ms);
+
+/*
+Called with the new time after every advance.
+*/
+void host_set_tick_hook(void (*hook)(uint64_t now_us));
+
+/*
+Simulated HX711 (HX711.h, for builds with HX711_BITBANG): conversions come
+from `source` every 100 ms, or every 12.5 ms while `rate_pin` is high. A
+source returning false models an unplugged load cell: is_ready() stays
+false and reads time out.
+*/
+void host_hx711_attach(bool (*source)(uint64_t now_us, long& raw), int rate_pin);
+uint64_t host_hx711_period_us();
+
+/*
+Scratch directory that backs LittleFS; emptied on every call.
+*/
+void host_fs_reset();
+const char* host_fs_root();
+
+/*
+Flash cost of a file write, charged to simulated time when the file is
+closed: a sector erase per started 4 KB and a page program per started
+256 bytes. Zero unless a test sets it, so writes are free by default.
+*/
+struct HostFlashCost {
+  uint32_t sector_erase_us = 0;
+  uint32_t page_program_us = 0;
+};
+extern HostFlashCost host_flash_cost;
+
+/*
+Times `path` was written and closed since the last host_fs_reset().
+*/
+unsigned host_fs_write_count(const char* path);
+
+/*
+Registered shutdown handlers (esp_register_shutdown_handler), as run by
+esp_restart().
+*/
+void host_run_shutdown_handlers();
+
+/*
+Reads the CPU timestamp counter, for relative cycle counts on the host.
+*/
+uint64_t host_cycles();
+
+// Minimal checks that report the failing line and keep going.
+extern int host_failures;
+#define HOST_CHECK(condition)                                                   \
+  do {                                                                          \
+    if (!(condition)) {                                                         \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      host_failures++;                                                          \
+    }                                                                           \
+  } while (0)
+
+/*
+Prints a summary and returns the process exit code.
+*/
+int host_report(const char* test_name);
@@ -0,0 +1,269 @@
+// Text side of the host ArduinoJson: writing and parsing JSON.
+#include "ArduinoJson.h"
+#include <cmath>
+
+namespace host_json {
+
+static void write_text(const std::string& text, std::string& out) {
+  out += '"';
+  for (char c : text) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if ((unsigned char)c < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out += escaped;
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+void write(const Node& node, std::string& out) {
+  char number[32];
+  switch (node.kind) {
+    case Node::Null: out += "null"; break;
+    case Node::Bool: out += node.boolean ? "true" : "false"; break;
+    case Node::Int:
+      snprintf(number, sizeof(number), "%lld", (long long)node.integer);
+      out += number;
+      break;
+    case Node::Float:
+      if (!std::isfinite(node.real)) {
+        out += "null";
+      } else {
+        snprintf(number, sizeof(number), "%.9g", node.real);
+        out += number;
+      }
+      break;
+    case Node::Text: write_text(node.text, out); break;
+    case Node::Array:
+      out += '[';
+      for (size_t i = 0; i < node.items.size(); i++) {
+        if (i) out += ',';
+        write(*node.items[i], out);
+      }
+      out += ']';
+      break;
+    case Node::Object:
+      out += '{';
+      for (size_t i = 0; i < node.members.size(); i++) {
+        if (i) out += ',';
+        write_text(node.members[i].first, out);
+        out += ':';
+        write(*node.members[i].second, out);
+      }
+      out += '}';
+      break;
+  }
+}
+
+static void skip_space(const char*& at, const char* end) {
+  while (at < end && (*at == ' ' || *at == '\n' || *at == '\r' || *at == '\t')) at++;
+}
+
+static bool parse_text(const char*& at, const char* end, std::string& text) {
+  if (at >= end || *at != '"') return false;
+  at++;
+  while (at < end && *at != '"') {
+    char c = *at++;
+    if (c != '\\') {
+      text += c;
+      continue;
+    }
+    if (at >= end) return false;
+    switch (char escaped = *at++) {
+      case 'n': text += '\n'; break;
+      case 'r': text += '\r'; break;
+      case 't': text += '\t'; break;
+      case 'b': text += '\b'; break;
+      case 'f': text += '\f'; break;
+      case 'u': {
+        if (end - at < 4) return false;
+        unsigned code = (unsigned)strtoul(std::string(at, 4).c_str(), nullptr, 16);
+        at += 4;
+        // UTF-8 for the basic plane; surrogate pairs are not needed here.
+        if (code < 0x80) {
+          text += (char)code;
+        } else if (code < 0x800) {
+          text += (char)(0xC0 | code >> 6);
+          text += (char)(0x80 | (code & 0x3F));
+        } else {
+          text += (char)(0xE0 | code >> 12);
+          text += (char)(0x80 | (code >> 6 & 0x3F));
+          text += (char)(0x80 | (code & 0x3F));
+        }
+        break;
+      }
+      default: text += escaped; break;
+    }
+  }
+  if (at >= end) return false;
+  at++;
+  return true;
+}
+
+static bool parse_word(const char*& at, const char* end, const char* word) {
+  size_t length = strlen(word);
+  if ((size_t)(end - at) < length || strncmp(at, word, length) != 0) return false;
+  at += length;
+  return true;
+}
+
+bool parse(const char*& at, const char* end, Node& node, int depth) {
+  if (depth > 10) return false;  // ArduinoJson's default nesting limit
+  skip_space(at, end);
+  if (at >= end) return false;
+  if (*at == '{') {
+    node.reset(Node::Object);
+    at++;
+    skip_space(at, end);
+    if (at < end && *at == '}') {
+      at++;
+      return true;
+    }
+    while (true) {
+      std::string key;
+      skip_space(at, end);
+      if (!parse_text(at, end, key)) return false;
+      skip_space(at, end);
+      if (at >= end || *at++ != ':') return false;
+      NodePtr value = std::make_shared<Node>();
+      if (!parse(at, end, *value, depth + 1)) return false;
+      node.members.emplace_back(key, value);
+      skip_space(at, end);
+      if (at >= end) return false;
+      if (*at == '}') {
+        at++;
+        return true;
+      }
+      if (*at++ != ',') return false;
+    }
+  }
+  if (*at == '[') {
+    node.reset(Node::Array);
+    at++;
+    skip_space(at, end);
+    if (at < end && *at == ']') {
+      at++;
+      return true;
+    }
+    while (true) {
+      NodePtr value = std::make_shared<Node>();
+      if (!parse(at, end, *value, depth + 1)) return false;
+      node.items.push_back(value);
+      skip_space(at, end);
+      if (at >= end) return false;
+      if (*at == ']') {
+        at++;
+        return true;
+      }
+      if (*at++ != ',') return false;
+    }
+  }
+  if (*at == '"') {
+    node.reset(Node::Text);
+    return parse_text(at, end, node.text);
+  }
+  if (parse_word(at, end, "true")) {
+    node.reset(Node::Bool);
+    node.boolean = true;
+    return true;
+  }
+  if (parse_word(at, end, "false")) {
+    node.reset(Node::Bool);
+    return true;
+  }
+  if (parse_word(at, end, "null")) {
+    node.reset(Node::Null);
+    return true;
+  }
+  const char* start = at;
+  if (at < end && (*at == '-' || *at == '+')) at++;
+  bool real = false;
+  while (at < end && (isdigit((unsigned char)*at) || *at == '.' || *at == 'e' || *at == 'E'
+                      || ((*at == '-' || *at == '+') && (at[-1] == 'e' || at[-1] == 'E')))) {
+    real = real || !isdigit((unsigned char)*at);
+    at++;
+  }
+  if (at == start) return false;
+  std::string number(start, at);
+  if (real) {
+    node.reset(Node::Float);
+    node.real = strtod(number.c_str(), nullptr);
+  } else {
+    node.reset(Node::Int);
+    node.integer = strtoll(number.c_str(), nullptr, 10);
+  }
+  return true;
+}
+
+}  // namespace host_json
+
+size_t serializeJson(const JsonDocument& document, Print& out) {
+  std::string text;
+  host_json::write(document.root(), text);
+  return out.write((const uint8_t*)text.data(), text.size());
+}
+
+size_t serializeJson(const JsonDocument& document, String& out) {
+  std::string text;
+  host_json::write(document.root(), text);
+  out = String(text);
+  return text.size();
+}
+
+size_t serializeJson(const JsonDocument& document, char* out, size_t size) {
+  std::string text;
+  host_json::write(document.root(), text);
+  if (size == 0) return 0;
+  size_t length = min(text.size(), size - 1);
+  memcpy(out, text.data(), length);
+  out[length] = '\0';
+  return length;
+}
+
+size_t measureJson(const JsonDocument& document) {
+  std::string text;
+  host_json::write(document.root(), text);
+  return text.size();
+}
+
+DeserializationError deserializeJson(JsonDocument& document, const char* in, size_t length) {
+  document.clear();
+  const char* at = in;
+  const char* end = in + length;
+  host_json::skip_space(at, end);
+  if (at == end) return DeserializationError::EmptyInput;
+  host_json::Node root;
+  if (!host_json::parse(at, end, root, 0)) {
+    return at >= end ? DeserializationError::IncompleteInput : DeserializationError::InvalidInput;
+  }
+  document.root() = root;
+  return DeserializationError::Ok;
+}
+
+DeserializationError deserializeJson(JsonDocument& document, const char* in) {
+  return deserializeJson(document, in, in ? strlen(in) : 0);
+}
+
+DeserializationError deserializeJson(JsonDocument& document, const String& in) {
+  return deserializeJson(document, in.c_str(), in.length());
+}
+
+DeserializationError deserializeJson(JsonDocument& document, fs::File& in) {
+  std::string text;
+  uint8_t buffer[256];
+  size_t got;
+  while ((got = in.read(buffer, sizeof(buffer))) > 0) {
+    text.append((const char*)buffer, got);
+  }
+  return deserializeJson(document, text.data(), text.size());
+}
@@ -0,0 +1,151 @@
+#include "pour_plant.h"
+#include "motors_sensors.h"
+#include <random>
+#include <vector>
+
+static const long PLANT_ZERO_RAW = 84000;
+// Reads kept for the checks; reserved up front, like the hose below, so the
+// plant does not allocate while a test counts the firmware's allocations.
+static const size_t PLANT_MAX_READS = 1 << 16;
+
+struct PlantRead {
+  unsigned long time_ms;
+  double liquid_g;
+};
+
+static PlantConfig plant;
+static std::mt19937 plant_random;
+static uint64_t plant_start_us = 0;
+static uint64_t plant_time_us = 0;
+static double pump_speed[INGREDIENT_COUNT];  // 0..1 per pump
+static bool pump_stuck[INGREDIENT_COUNT];
+static unsigned stuck_writes[INGREDIENT_COUNT];
+static bool stuck_used = false;
+static bool siphoning = false;
+static double stream_g_per_s = 0;             // leaving the hoses
+static std::vector<double> in_flight;         // grams per ms, a ring as long as the fall
+static size_t in_flight_next = 0;             // oldest, lands next
+static double landed_g = 0;
+static unsigned long stopped_ms = 0;
+static std::vector<PlantRead> reads;
+
+static double since_start_s(uint64_t now_us) {
+  return (now_us - plant_start_us) / 1e6;
+}
+
+static bool pump_driven(int pump) {
+  int pin = MOTOR_MAP[pump];
+  if (pump_stuck[pump]) {
+    pump_stuck[pump] = host_pin_writes[pin] == stuck_writes[pump];
+    return pump_stuck[pump];
+  }
+  bool on = host_pin_level[pin] == HIGH;
+  if (!on && pump_speed[pump] > 0 && plant.pump_sticks && !stuck_used) {
+    stuck_used = pump_stuck[pump] = true;
+    stuck_writes[pump] = host_pin_writes[pin];
+    return true;
+  }
+  return on;
+}
+
+// Integrates the plant in 1 ms steps up to `now_us`.
+static void plant_tick(uint64_t now_us) {
+  while (plant_time_us + 1000 <= now_us) {
+    plant_time_us += 1000;
+    double pumped = 0;
+    int moving_before = plant_moving_pumps();
+    for (int pump = 0; pump < INGREDIENT_COUNT; pump++) {
+      double step = 0.001 / plant.spin_up_s;
+      pump_speed[pump] = pump_driven(pump) ? min(1.0, pump_speed[pump] + step) : 0;
+      pumped += pump_speed[pump] * plant.flow_g_per_s;
+      siphoning = siphoning || pump_speed[pump] > 0;
+    }
+    if (moving_before > 0 && plant_moving_pumps() == 0) {
+      stopped_ms = (unsigned long)(plant_time_us / 1000);
+    }
+    if (siphoning) {
+      pumped += plant.siphon_g_per_s;
+    }
+    // The stream follows the pumps with the drain time constant.
+    stream_g_per_s += (pumped - stream_g_per_s) * min(1.0, 0.001 / plant.drain_tau_s);
+    landed_g += in_flight[in_flight_next];
+    in_flight[in_flight_next] = stream_g_per_s * 0.001;
+    in_flight_next = (in_flight_next + 1) % in_flight.size();
+  }
+}
+
+static bool plant_scale(uint64_t now_us, long& raw) {
+  plant_tick(now_us);
+  std::normal_distribution<double> noise(0, plant.noise_g);
+  double t = since_start_s(now_us);
+  if (plant.unplug_at_s >= 0 && t >= plant.unplug_at_s) {
+    return false;
+  }
+  double grams = plant.tray_g + noise(plant_random);
+  bool lifted = plant.lift_at_s >= 0 && t >= plant.lift_at_s;
+  if (t >= plant.cup_at_s && !lifted) {
+    grams += plant.cup_g + landed_g;
+  }
+  if (plant.press_at_s >= 0 && t >= plant.press_at_s && t < plant.press_at_s + 0.5) {
+    grams += plant.press_g;
+  }
+  if (reads.size() < PLANT_MAX_READS) {
+    reads.push_back({ (unsigned long)(now_us / 1000), grams - plant.tray_g - plant.cup_g });
+  }
+  raw = PLANT_ZERO_RAW + lround(grams * DEFAULT_COUNTS_PER_KG / 1000.0);
+  return true;
+}
+
+void plant_reset(const PlantConfig& config) {
+  plant = config;
+  plant_random.seed(config.seed);
+  plant_start_us = plant_time_us = host_time_us;
+  stream_g_per_s = 0;
+  in_flight.assign(max((size_t)1, (size_t)(config.fall_s * 1000)), 0.0);
+  in_flight_next = 0;
+  landed_g = 0;
+  stuck_used = false;
+  siphoning = false;
+  stopped_ms = 0;
+  reads.clear();
+  reads.reserve(PLANT_MAX_READS);
+  for (int pump = 0; pump < INGREDIENT_COUNT; pump++) {
+    pump_speed[pump] = 0;
+    pump_stuck[pump] = false;
+  }
+  host_set_tick_hook(plant_tick);
+  host_hx711_attach(plant_scale, LOADCELL_RATE_PIN);
+  weight_begin(LOADCELL_DOUT_PIN, LOADCELL_SCK_PIN, LOADCELL_RATE_PIN);
+  weight_set_calibration(PLANT_ZERO_RAW, DEFAULT_COUNTS_PER_KG);
+}
+
+double plant_poured_g() {
+  return landed_g;
+}
+
+int plant_running_pumps() {
+  int running = 0;
+  for (int pump = 0; pump < INGREDIENT_COUNT; pump++) {
+    running += host_pin_level[MOTOR_MAP[pump]] == HIGH;
+  }
+  return running;
+}
+
+int plant_moving_pumps() {
+  int moving = 0;
+  for (int pump = 0; pump < INGREDIENT_COUNT; pump++) {
+    moving += pump_speed[pump] > 0;
+  }
+  return moving;
+}
+
+unsigned long plant_first_read_over_ms(double grams) {
+  for (const PlantRead& read : reads) {
+    if (read.liquid_g > grams) return read.time_ms;
+  }
+  return 0;
+}
+
+unsigned long plant_pumps_stopped_ms() {
+  return stopped_ms;
+}
@@ -0,0 +1,44 @@
+// Simulated pumps, hoses and a cup on the load cell, for pour tests.
+#pragma once
+#include "host.h"
+
+struct PlantConfig {
+  double flow_g_per_s = 20;    // steady pump flow
+  double spin_up_s = 0.06;     // pump reaches full flow after this long
+  double fall_s = 0.15;        // from the pump through the hose into the cup
+  double drain_tau_s = 0.04;   // stream tail once the pump stops
+  double noise_g = 0.08;       // load cell noise (standard deviation)
+  double tray_g = 2.5;         // residue on the drip tray
+  double cup_g = 180;
+  double cup_at_s = 0;         // cup set on the platform
+  unsigned seed = 1;
+
+  // Faults, times in seconds since plant_reset().
+  bool pump_sticks = false;    // a pump ignores its first switch-off and runs
+                               // until its pin is written again
+  double siphon_g_per_s = 0;   // keeps flowing after the pump stops
+  double lift_at_s = -1;       // cup taken off the platform
+  double press_at_s = -1;      // a hand leans on the cup for half a second
+  double press_g = 400;
+  double unplug_at_s = -1;     // load cell cable pulled: no more conversions
+};
+
+/*
+Attaches the plant to the simulated HX711 and motor pins, starts the scale
+at the default calibration and puts an empty cup on the platform.
+*/
+void plant_reset(const PlantConfig& config);
+
+// Liquid that has landed in the cup so far, in grams.
+double plant_poured_g();
+// Pumps currently running (motor pin high).
+int plant_running_pumps();
+// Pumps actually moving liquid, whatever their pins say.
+int plant_moving_pumps();
+
+/*
+First scale reading with more than `grams` of liquid in the cup, and the
+time the last pump stopped moving liquid; 0 if it never happened.
+*/
+unsigned long plant_first_read_over_ms(double grams);
+unsigned long plant_pumps_stopped_ms();
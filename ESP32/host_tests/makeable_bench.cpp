@@ -0,0 +1,115 @@
+// "Makeable now" over synthetic libraries of 1000 to 4096 recipes
+// (makeable.cpp on the posting lists of recipe_store.cpp), against scanning
+// every page as the firmware would without the index. The index must agree
+// with availability.cpp on every page.
+#include "host.h"
+#include "fakes.h"
+#include "recipe_store.h"
+#include "availability.h"
+#include "makeable.h"
+#include <chrono>
+#include <random>
+
+static const int LIBRARY_SIZES[] = { 1000, 2000, RECIPE_STORE_MAX_COUNT };
+static const int STOCK_CHANGES = 200;
+static const int STOCK_ML = 1500;
+
+static double now_us() {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Two to four ingredients of 10 to 60 ml each.
+static void build_library(int recipes, std::mt19937& random) {
+  host_fs_reset();
+  recipe_store_begin();
+  int number = 0;
+  while (recipe_store_count() < recipes) {
+    recipe_store_load_page(recipe_store_count() / RECIPE_PAGE_SIZE);
+    for (int slot = recipe_store_count() % RECIPE_PAGE_SIZE; slot < RECIPE_PAGE_SIZE && number < recipes; slot++) {
+      Cocktail& preset = preset_cocktails[slot];
+      preset = make_cocktail("");
+      snprintf(preset.name, COCKTAIL_NAME_CAPACITY, "Synthetic %d", number++);
+      int used = 2 + random() % 3;
+      for (int i = 0; i < used; i++) {
+        preset.amounts[random() % INGREDIENT_COUNT] = 10 + random() % 51;
+      }
+    }
+    assign_missing_recipe_ids();
+    update_recipe_index();
+    recipe_store_save_page();
+  }
+}
+
+static void set_stock(int ingredient, int ml) {
+  ingredients[ingredient].amount_left_ul = ml_to_ul((float)ml);
+  availability_ingredient_changed(ingredient);
+}
+
+// What the firmware would do without the index: load every page and ask
+// availability.cpp. Returns the makeable count.
+static int scan_pages() {
+  int makeable = 0;
+  for (int page = 0; page < recipe_store_page_count(); page++) {
+    recipe_store_load_page(page);
+    for (int slot = 0; slot < RECIPE_PAGE_SIZE; slot++) {
+      if (preset_cocktails[slot].name[0] != '\0' && preset_available(slot)) {
+        makeable++;
+        HOST_CHECK(makeable_at(page * RECIPE_PAGE_SIZE + slot));
+      } else {
+        HOST_CHECK(!makeable_at(page * RECIPE_PAGE_SIZE + slot));
+      }
+    }
+  }
+  return makeable;
+}
+
+static void run_library(int recipes) {
+  std::mt19937 random(recipes);
+  for (int i = 0; i < INGREDIENT_COUNT; i++) {
+    set_stock(i, STOCK_ML);
+  }
+  build_library(recipes, random);
+
+  double start = now_us();
+  makeable_rebuild();
+  double rebuild_us = now_us() - start;
+
+  // Bottles running down a few pours at a time, refilled when nearly empty.
+  double update_us = 0;
+  for (int change = 0; change < STOCK_CHANGES; change++) {
+    int ingredient = random() % INGREDIENT_COUNT;
+    int left = stock_ml(ingredients[ingredient]) - 5 - random() % 40;
+    start = now_us();
+    set_stock(ingredient, left < 10 ? STOCK_ML : left);
+    update_us += now_us() - start;
+  }
+
+  // Leave one bottle nearly empty, so some recipes are out whatever the run did.
+  set_stock(0, 35);
+  start = now_us();
+  int listed = 0;
+  for (int position = next_makeable(0); position >= 0; position = next_makeable(position + 1)) {
+    listed++;
+  }
+  double walk_us = now_us() - start;
+
+  start = now_us();
+  int scanned = scan_pages();
+  double scan_us = now_us() - start;
+
+  printf("  %4d recipes: %4d makeable, rebuild %7.0f us, stock change %5.1f us, listing %5.1f us;"
+         " page scan %8.0f us (%.0fx a stock change)\n",
+         recipes, makeable_count(), rebuild_us, update_us / STOCK_CHANGES, walk_us, scan_us,
+         scan_us / (update_us / STOCK_CHANGES));
+  HOST_CHECK(makeable_count() == scanned);
+  HOST_CHECK(listed == scanned);
+  HOST_CHECK(scanned > 0 && scanned < recipes);
+}
+
+int main() {
+  printf("makeable index against a page scan (host time):\n");
+  for (int recipes : LIBRARY_SIZES) {
+    run_library(recipes);
+  }
+  return host_report("makeable_bench");
+}
@@ -0,0 +1,89 @@
+// Heap use of whole orders (serve_order() with alloc_track.cpp), with the
+// real trace, journal and history files on the simulated filesystem: the cup
+// wait and the pumps must not allocate, and the heap must hold the same
+// blocks once the order is booked. A flash write nested in the order still
+// counts against it.
+#include "host.h"
+#include "pour_plant.h"
+#include "fakes.h"
+#include "motors_sensors.h"
+#include "alloc_track.h"
+#include "trace_recorder.h"
+#include "order_journal.h"
+#include "order_history.h"
+#include <LittleFS.h>
+
+static void serve(const char* name, int ingredient_count, double cup_at_s) {
+  PlantConfig config;
+  config.flow_g_per_s = 25;
+  config.cup_at_s = cup_at_s;
+  plant_reset(config);
+  fakes_reset();
+  Cocktail cocktail = {};
+  strcpy(cocktail.name, name);
+  cocktail.id = 1;
+  for (int i = 0; i < ingredient_count; i++) {
+    cocktail.amounts[INGREDIENT_COUNT - 1 - i] = 20;
+  }
+  uint32_t storage_before = alloc_counters[Alloc_Storage].allocations;
+  serve_order(cocktail, Medium);
+  const OrderAllocReport& report = last_order_alloc;
+  printf("  %-28s %s, order path %lu allocations, heap %+ld blocks, %lu flash writes (%lu allocations)\n", name,
+         fake_log.last_order == Completed ? "completed" : "FAILED", (unsigned long)report.allocations[Alloc_Order],
+         (long)report.heap_blocks_delta, (unsigned long)fake_log.flash_writes,
+         (unsigned long)(alloc_counters[Alloc_Storage].allocations - storage_before));
+  HOST_CHECK(fake_log.last_order == Completed);
+  HOST_CHECK(report.allocations[Alloc_Order] == 0);
+  HOST_CHECK(report.heap_blocks_delta == 0);
+  // The trace, journal and history were written, outside the order scope.
+  HOST_CHECK(fake_log.flash_writes >= 3);
+  HOST_CHECK(alloc_counters[Alloc_Storage].allocations > storage_before);
+}
+
+static void *volatile kept_block = nullptr;
+
+// Allocations the firmware must not do under an order are reported.
+static void caught() {
+  uint32_t allocating = alloc_orders_allocating;
+  alloc_order_begin();
+  {
+    AllocScopeGuard order_scope(Alloc_Order);
+    AllocScopeGuard storage_scope(Alloc_Storage);
+    ::operator delete(::operator new(16));
+  }
+  alloc_order_end();
+  printf("  %-28s order path %lu allocations\n", "flash write inside an order", (unsigned long)last_order_alloc.allocations[Alloc_Order]);
+  HOST_CHECK(last_order_alloc.allocations[Alloc_Order] == 1);
+  HOST_CHECK(last_order_alloc.allocations[Alloc_Storage] == 0);
+  HOST_CHECK(alloc_orders_allocating == allocating + 1);
+
+  // malloc is not counted by scope, but a block left behind is.
+  alloc_order_begin();
+  kept_block = malloc(32);
+  alloc_order_end();
+  free(kept_block);
+  printf("  %-28s heap %+ld blocks\n", "block left after an order", (long)last_order_alloc.heap_blocks_delta);
+  HOST_CHECK(last_order_alloc.heap_blocks_delta == 1);
+  HOST_CHECK(alloc_orders_allocating == allocating + 2);
+}
+
+int main() {
+  printf("heap use per order:\n");
+  host_fs_reset();
+  LittleFS.begin(true);
+  setup_motors();
+  history_set_clock(1700000000);
+  HOST_CHECK(trace_begin());
+  HOST_CHECK(journal_begin());
+  HOST_CHECK(history_begin());
+
+  serve("one ingredient", 1, 1.0);
+  serve("every ingredient", INGREDIENT_COUNT, 1.0);
+  // An hour later: the history opens new buckets while the order is booked.
+  host_advance_ms(3600000);
+  serve("first order of the hour", 2, 1.0);
+  HOST_CHECK(alloc_orders_allocating == 0);
+
+  caught();
+  return host_report("order_alloc_test");
+}
@@ -0,0 +1,61 @@
+// Order history (order_history.cpp) on the simulated filesystem: a pour
+// that crosses a bucket boundary keeps the ml it booked in the bucket it
+// started in, in both tiers.
+#include "host.h"
+#include "fakes.h"
+#include "order_history.h"
+#include <LittleFS.h>
+
+// The order starts just before the top of an hour, so both tiers change
+// bucket mid-pour.
+static const uint32_t HOUR_START_S = 1700002800;
+static const uint32_t BEFORE_BOUNDARY_S = 10;
+
+struct TierTotals {
+  int buckets;
+  uint32_t orders;
+  uint32_t poured_ml[INGREDIENT_COUNT];
+};
+
+static TierTotals totals(HistoryTier tier) {
+  TierTotals sum = {};
+  OrderBucket buckets[8];
+  uint32_t next;
+  sum.buckets = history_read(tier, HOUR_START_S - 2 * 3600, history_now() + 1, buckets, 8, next);
+  for (int b = 0; b < sum.buckets; b++) {
+    for (int i = 0; i < ORDER_OUTCOME_COUNT; i++) sum.orders += buckets[b].outcomes[i];
+    for (int i = 0; i < INGREDIENT_COUNT; i++) sum.poured_ml[i] += buckets[b].poured_ml[i];
+  }
+  return sum;
+}
+
+static void check_totals(const char* when) {
+  for (HistoryTier tier : { History_Fine, History_Hourly }) {
+    TierTotals sum = totals(tier);
+    printf("  %-22s %s tier: %d buckets, %lu order(s), %lu + %lu ml\n", when, tier == History_Fine ? "5-minute" : "hourly",
+           sum.buckets, (unsigned long)sum.orders, (unsigned long)sum.poured_ml[0], (unsigned long)sum.poured_ml[1]);
+    HOST_CHECK(sum.buckets == 2);
+    HOST_CHECK(sum.orders == 1);
+    HOST_CHECK(sum.poured_ml[0] == 30);
+    HOST_CHECK(sum.poured_ml[1] == 20);
+  }
+}
+
+int main() {
+  host_fs_reset();
+  LittleFS.begin(true);
+  history_set_clock(HOUR_START_S - BEFORE_BOUNDARY_S);
+  HOST_CHECK(history_begin());
+
+  // The first ingredient lands before the boundary, the second and the end
+  // of the order after it.
+  history_add_poured(0, 30);
+  host_advance_ms(2 * BEFORE_BOUNDARY_S * 1000);
+  history_add_poured(1, 20);
+  history_record_order(Completed, 2 * BEFORE_BOUNDARY_S * 1000);
+  check_totals("after the order");
+
+  HOST_CHECK(history_begin());
+  check_totals("files reopened");
+  return host_report("order_history_test");
+}
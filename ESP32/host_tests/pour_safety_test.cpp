@@ -0,0 +1,134 @@
+// Pour safety checks (pour_safety.cpp as used by pour_drink()) against
+// simulated faults: a pump that does not stop, a siphoning bottle, the cup
+// lifted mid-pour, a hand pressing on it and a load cell that stops
+// answering.
+#include "host.h"
+#include "pour_plant.h"
+#include "fakes.h"
+#include "motors_sensors.h"
+#include "pour_safety.h"
+#include "health.h"
+
+static const int TARGET_ML = 40;
+
+static OrderState pour(const PlantConfig& config) {
+  plant_reset(config);
+  fakes_reset();
+  return_to_main_menu();
+  Cocktail cocktail = {};
+  strcpy(cocktail.name, "Safety");
+  cocktail.amounts[INGREDIENT_COUNT - 1] = TARGET_ML;  // the last pump: larger builds test their extra pins
+  pour_drink(cocktail, Medium);
+  delay(2000);
+  return fake_log.last_order;
+}
+
+static PourFault abort_fault() {
+  const FakeTraceEvent* abort = fake_find_event(Trace_Abort);
+  return abort ? (PourFault)abort->value : Pour_Ok;
+}
+
+static void expect_abort(const char* name, const PlantConfig& config, PourFault fault) {
+  OrderState state = pour(config);
+  printf("    %-28s %s, %s, %.1f g in the cup, %d alert(s)\n", name, state == Aborted ? "aborted" : "NOT ABORTED",
+         pour_fault_name(abort_fault()), plant_poured_g(), fake_log.alerts);
+  HOST_CHECK(state == Aborted);
+  HOST_CHECK(abort_fault() == fault);
+  HOST_CHECK(plant_running_pumps() == 0);
+  HOST_CHECK(fake_log.alerts == 1);
+}
+
+// The plant sees a pin change in its next 1 ms step.
+static const unsigned long PLANT_STEP_MS = 1;
+
+// Time from the fault to `stopped_ms`, printed and checked against one
+// sample period.
+static void expect_stopped_within(unsigned long fault_ms, unsigned long stopped_ms, unsigned long period_ms,
+                                  const char* what) {
+  printf("    %-28s fault at %lu ms, %s %lu ms later (max %lu)\n", "", fault_ms, what, stopped_ms - fault_ms, period_ms);
+  HOST_CHECK(fault_ms != 0 && stopped_ms >= fault_ms);
+  HOST_CHECK(stopped_ms - fault_ms <= period_ms + PLANT_STEP_MS);
+  HOST_CHECK(plant_moving_pumps() == 0);
+}
+
+static void expect_pump_stopped_within(unsigned long fault_ms, unsigned long period_ms) {
+  expect_stopped_within(fault_ms, plant_pumps_stopped_ms(), period_ms, "pump stopped");
+}
+
+static void check_rate(SampleRate rate) {
+  pour_sample_rate = rate;
+  unsigned long period_ms = rate == Rate_80SPS ? 13 : 100;
+  printf("  %d SPS:\n", rate == Rate_80SPS ? 80 : 10);
+
+  PlantConfig normal;
+  normal.flow_g_per_s = 25;
+  OrderState state = pour(normal);
+  printf("    %-28s %s, %.1f g in the cup\n", "normal pour", state == Completed ? "completed" : "FAILED", plant_poured_g());
+  HOST_CHECK(state == Completed);
+  HOST_CHECK(fake_find_event(Trace_Abort) == nullptr);
+  HOST_CHECK(fabs(plant_poured_g() - TARGET_ML) < 3);
+
+  // The stop decision comes under the target; only the drain and settle
+  // checks can see the weight run past the limit. The second raw reading
+  // over it, one sample after the first, stops the pump. The limit counts
+  // from the measured baseline, so the fault is the first reading over it
+  // by more than the scale noise.
+  double limit_g = TARGET_ML + max(mg_to_grams(POUR_RUNAWAY_MARGIN_MG), TARGET_ML / 5.0f) + 3 * normal.noise_g;
+  PlantConfig stuck = normal;
+  stuck.pump_sticks = true;
+  expect_abort("pump does not stop", stuck, Pour_Runaway);
+  expect_pump_stopped_within(plant_first_read_over_ms(limit_g), period_ms);
+
+  PlantConfig siphon = normal;
+  siphon.siphon_g_per_s = 25;
+  // The pump is already off; the abort is what the firmware can do.
+  expect_abort("bottle siphoning", siphon, Pour_Runaway);
+  expect_stopped_within(plant_first_read_over_ms(limit_g), fake_find_event(Trace_Abort)->time_ms, period_ms, "aborted");
+
+  PlantConfig lifted = normal;
+  lifted.lift_at_s = 1.5;
+  unsigned long lifted_ms = millis() + (unsigned long)(lifted.lift_at_s * 1000);
+  expect_abort("cup lifted mid-pour", lifted, Pour_Cup_Removed);
+  expect_pump_stopped_within(lifted_ms, period_ms);
+
+  PlantConfig pressed = normal;
+  pressed.press_at_s = 1.5;
+  unsigned long pressed_ms = millis() + (unsigned long)(pressed.press_at_s * 1000);
+  expect_abort("hand on the cup", pressed, Pour_Surge);
+  expect_pump_stopped_within(pressed_ms, period_ms);
+
+  PlantConfig unplugged = normal;
+  unplugged.unplug_at_s = 1.5;
+  unsigned long unplugged_ms = millis() + (unsigned long)(unplugged.unplug_at_s * 1000);
+  expect_abort("load cell unplugged", unplugged, Pour_Sensor_Lost);
+  printf("    %-28s pump stopped %lu ms after the last conversion\n", "", plant_pumps_stopped_ms() - unplugged_ms);
+  HOST_CHECK(plant_pumps_stopped_ms() - unplugged_ms <= (WEIGHT_READ_TIMEOUT_CONVERSIONS + 1) * period_ms);
+  HOST_CHECK(plant_moving_pumps() == 0);
+  HOST_CHECK(subsystem_health[Subsystem_Load_Cell].state == Health_Failed);
+  health_set(Subsystem_Load_Cell, Health_Ok);
+}
+
+// A pump index from outside the machine (POST Clean) starts nothing.
+static void check_clean_index() {
+  for (int pump : { -1, INGREDIENT_COUNT, 99 }) {
+    unsigned long before = millis();
+    return_to_main_menu();
+    pour_until_stopped(pump);
+    HOST_CHECK(millis() == before);
+    HOST_CHECK(current_menu != Cancellable_Op);
+  }
+  unsigned long before = millis();
+  pour_until_stopped(INGREDIENT_COUNT - 1);
+  printf("  cleaning: pumps -1, %d and 99 refused, pump %d ran %lu ms\n", INGREDIENT_COUNT, INGREDIENT_COUNT - 1,
+         millis() - before);
+  HOST_CHECK(millis() - before >= 5000);
+  HOST_CHECK(host_pin_level[MOTOR_MAP[INGREDIENT_COUNT - 1]] == LOW);
+}
+
+int main() {
+  setup_motors();
+  check_rate(Rate_10SPS);
+  check_rate(Rate_80SPS);
+  check_clean_index();
+  return host_report("pour_safety_test");
+}
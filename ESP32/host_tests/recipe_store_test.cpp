@@ -0,0 +1,133 @@
+// Recipe library (recipe_store.cpp) on the simulated filesystem: a full
+// library of longest names, recipe IDs that are never handed out twice, and
+// popularity scores that survive paging.
+#include "host.h"
+#include "fakes.h"
+#include "recipe_store.h"
+#include "popularity.h"
+#include <LittleFS.h>
+
+// Longest name that fits, unique per recipe.
+static void recipe_name(int number, char* name) {
+  snprintf(name, COCKTAIL_NAME_CAPACITY, "Recipe %04d ", number);
+  size_t length = strlen(name);
+  memset(name + length, 'x', COCKTAIL_NAME_CAPACITY - 1 - length);
+  name[COCKTAIL_NAME_CAPACITY - 1] = '\0';
+}
+
+// Appends a page of new recipes after the last one. Returns false if the
+// library refused it.
+static bool add_page(int& number, int recipes) {
+  if (!recipe_store_load_page(recipe_store_count() / RECIPE_PAGE_SIZE)) return false;
+  for (int slot = recipe_store_count() % RECIPE_PAGE_SIZE; slot < RECIPE_PAGE_SIZE && recipes > 0; slot++, recipes--) {
+    Cocktail& preset = preset_cocktails[slot];
+    recipe_name(number++, preset.name);
+    preset.id = RECIPE_ID_NONE;
+    preset.amounts[number % INGREDIENT_COUNT] = 20 + number % 40;
+  }
+  assign_missing_recipe_ids();
+  update_recipe_index();
+  return recipe_store_save_page();
+}
+
+static void full_library() {
+  int number = 0;
+  bool ok = true;
+  while (ok && recipe_store_count() < RECIPE_STORE_MAX_COUNT) {
+    ok = add_page(number, RECIPE_STORE_MAX_COUNT - recipe_store_count());
+  }
+  printf("  %d recipes with %d-byte names saved\n", recipe_store_count(), COCKTAIL_NAME_CAPACITY - 1);
+  HOST_CHECK(ok);
+  HOST_CHECK(recipe_store_count() == RECIPE_STORE_MAX_COUNT);
+  HOST_CHECK(!add_page(number, 1));
+
+  // Every name reads back, the last one too.
+  char expected[COCKTAIL_NAME_CAPACITY];
+  for (int page : { 0, recipe_store_page_count() / 2, recipe_store_page_count() - 1 }) {
+    HOST_CHECK(recipe_store_load_page(page));
+    for (int slot = 0; slot < RECIPE_PAGE_SIZE && page * RECIPE_PAGE_SIZE + slot < recipe_store_count(); slot++) {
+      recipe_name(page * RECIPE_PAGE_SIZE + slot, expected);
+      HOST_CHECK(strcmp(preset_cocktails[slot].name, expected) == 0);
+      HOST_CHECK(recipe_store_position(preset_cocktails[slot].id) == page * RECIPE_PAGE_SIZE + slot);
+    }
+  }
+
+  // Saving a page rewrites the whole file, with typical flash timings
+  // (45 ms per 4 KB sector erase, 0.4 ms per 256-byte page).
+  HOST_CHECK(recipe_store_load_page(0));
+  host_flash_cost.sector_erase_us = 45000;
+  host_flash_cost.page_program_us = 400;
+  unsigned long started = millis();
+  HOST_CHECK(recipe_store_save_page());
+  unsigned long save_ms = millis() - started;
+  host_flash_cost = HostFlashCost();
+  size_t bytes = LittleFS.open("/recipes.bin", "r").size();
+  printf("  saving a page of the full library writes %u KB, %lu ms of flash time\n", (unsigned)(bytes / 1024), save_ms);
+  HOST_CHECK(bytes < 300 * 1024);
+  HOST_CHECK(save_ms < 4000);
+}
+
+static void ids_never_reused() {
+  host_fs_reset();
+  HOST_CHECK(recipe_store_begin());
+  int number = 0;
+  HOST_CHECK(add_page(number, 3));
+  HOST_CHECK(recipe_store_load_page(0));
+  recipe_id_t deleted = preset_cocktails[2].id;
+  preset_cocktails[2] = make_cocktail("");
+  update_recipe_index();
+  HOST_CHECK(recipe_store_save_page());
+
+  HOST_CHECK(add_page(number, 1));
+  HOST_CHECK(recipe_store_load_page(0));
+  recipe_id_t added = preset_cocktails[2].id;
+  // The counter is on flash: after a reboot the next ID is higher still.
+  HOST_CHECK(recipe_store_begin());
+  HOST_CHECK(add_page(number, 1));
+  HOST_CHECK(recipe_store_load_page(0));
+  recipe_id_t after_reboot = preset_cocktails[3].id;
+  printf("  deleted ID %u, next IDs %u and %u after a reboot\n", deleted, added, after_reboot);
+  HOST_CHECK(added > deleted);
+  HOST_CHECK(after_reboot > added);
+}
+
+static void order(int slot, int times) {
+  for (int i = 0; i < times; i++) {
+    update_stats_on_drink_order(preset_cocktails[slot], Completed);
+  }
+}
+
+static void popularity_across_pages() {
+  host_fs_reset();
+  HOST_CHECK(recipe_store_begin());
+  int number = 0;
+  HOST_CHECK(add_page(number, RECIPE_PAGE_SIZE));
+  HOST_CHECK(add_page(number, RECIPE_PAGE_SIZE));
+  HOST_CHECK(recipe_store_load_page(0));
+  popularity_rebuild();
+
+  // Ten orders of slot 0 long ago, six of slot 1 tonight: slot 1 leads.
+  order(0, 10);
+  host_advance_ms(4 * POPULARITY_HALF_LIFE_MS);
+  order(1, 6);
+  HOST_CHECK(top_recipe_slot(0) == 1);
+  HOST_CHECK(top_recipe_slot(1) == 0);
+
+  // Plain counts would put slot 0 first again.
+  HOST_CHECK(recipe_store_load_page(1));
+  HOST_CHECK(recipe_store_load_page(0));
+  printf("  after paging away and back: top slots %d, %d\n", top_recipe_slot(0), top_recipe_slot(1));
+  HOST_CHECK(top_recipe_slot(0) == 1);
+  HOST_CHECK(top_recipe_slot(1) == 0);
+  HOST_CHECK(stats.preset_order_counts[0].count == 10);
+  HOST_CHECK(stats.preset_order_counts[1].count == 6);
+}
+
+int main() {
+  host_fs_reset();
+  HOST_CHECK(recipe_store_begin());
+  full_library();
+  ids_never_reused();
+  popularity_across_pages();
+  return host_report("recipe_store_test");
+}
@@ -0,0 +1,77 @@
+// Overshoot of pour_drink() with the pumps sampled at 10 and at 80 SPS, on
+// simulated pumps over a range of flows and targets. Both the firmware's own
+// estimate (overshoot_stats) and what really landed in the cup are reported.
+#include "host.h"
+#include "pour_plant.h"
+#include "fakes.h"
+#include "motors_sensors.h"
+
+static const double FLOWS_G_PER_S[] = { 8, 15, 25, 40 };
+static const int TARGETS_ML[] = { 15, 30, 60 };
+static const int SEEDS = 5;
+
+struct RateResult {
+  double mean_abs_g;
+  double max_abs_g;
+  double mean_pour_s;
+  int runaway_aborts;  // overshoot past the pour safety margin
+};
+
+static RateResult run_rate(SampleRate rate) {
+  pour_sample_rate = rate;
+  overshoot_stats[rate] = OvershootStats();
+  pour_inflight_ms = POUR_INFLIGHT_DEFAULT_MS;  // each rate learns the hose from scratch
+  double total_abs = 0;
+  double max_abs = 0;
+  double total_s = 0;
+  int pours = 0;
+  int aborts = 0;
+  for (double flow : FLOWS_G_PER_S) {
+    double flow_total = 0;
+    int flow_pours = 0;
+    for (int target : TARGETS_ML) {
+      for (int seed = 1; seed <= SEEDS; seed++) {
+        PlantConfig config;
+        config.flow_g_per_s = flow;
+        config.seed = seed * 97 + target;
+        plant_reset(config);
+        fakes_reset();
+        Cocktail cocktail = {};
+        strcpy(cocktail.name, "Bench");
+        cocktail.amounts[0] = target;
+        unsigned long started = millis();
+        pour_drink(cocktail, Medium);
+        total_s += (millis() - started) / 1000.0;
+        delay(2000);  // let the hose drain completely
+        double overshoot = fabs(plant_poured_g() - target);
+        aborts += fake_log.last_order == Aborted;
+        total_abs += overshoot;
+        flow_total += overshoot;
+        max_abs = max(max_abs, overshoot);
+        pours++;
+        flow_pours++;
+      }
+    }
+    printf("    %2.0f g/s: mean |overshoot| %.2f g\n", flow, flow_total / flow_pours);
+  }
+  const OvershootStats& logged = overshoot_stats[rate];
+  printf("  %d SPS: mean |overshoot| %.2f g, max %.2f g, %.1f s per pour, %d runaway aborts; "
+         "firmware estimate mean %.2f g, max %.2f g\n",
+         rate == Rate_80SPS ? 80 : 10, total_abs / pours, max_abs, total_s / pours, aborts,
+         mg_to_grams(logged.total_abs_overshoot_mg / max(1, logged.pours)), mg_to_grams(logged.max_abs_overshoot_mg));
+  printf("    learnt in-flight time %lu ms\n", pour_inflight_ms);
+  return { total_abs / pours, max_abs, total_s / pours, aborts };
+}
+
+int main() {
+  printf("pour overshoot, %d pours per rate:\n",
+         (int)(sizeof(FLOWS_G_PER_S) / sizeof(FLOWS_G_PER_S[0]) * sizeof(TARGETS_ML) / sizeof(TARGETS_ML[0])) * SEEDS);
+  setup_motors();
+  RateResult slow = run_rate(Rate_10SPS);
+  RateResult fast = run_rate(Rate_80SPS);
+  printf("  80 SPS cuts the mean overshoot by %.0f%%\n", 100 * (1 - fast.mean_abs_g / slow.mean_abs_g));
+  HOST_CHECK(fast.mean_abs_g < slow.mean_abs_g);
+  HOST_CHECK(fast.max_abs_g < slow.max_abs_g);
+  HOST_CHECK(fast.runaway_aborts == 0);
+  return host_report("sample_rate_bench");
+}
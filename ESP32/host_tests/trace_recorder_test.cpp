@@ -0,0 +1,103 @@
+// Pour traces (trace_recorder.cpp) through the simulated LittleFS and back
+// out through the host decoder (../trace_decoder), across ingredients longer
+// than one RAM buffer used to hold and a re-tare between orders.
+#include "host.h"
+#include "fakes.h"
+#include "trace_recorder.h"
+#include "weight.h"
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+static const char* DECODER = "build/trace_decoder";  // make test runs from host_tests
+static const int32_t GAIN = 812500;
+
+struct OrderPlan {
+  int32_t offset;
+  double grams;
+  int ingredients;
+  int samples_per_ingredient;
+};
+
+static void record_order(const OrderPlan& plan) {
+  weight_set_calibration(plan.offset, GAIN);
+  int32_t raw = plan.offset + (int32_t)lround(plan.grams * GAIN / 1000.0);
+  trace_order_start();
+  for (int ingredient = 0; ingredient < plan.ingredients; ingredient++) {
+    trace_event(Trace_Pour_Start, 30000, ingredient);
+    trace_event(Trace_Motor_On, 0, ingredient);
+    int writes_before = fake_log.flash_writes;
+    for (int i = 0; i < plan.samples_per_ingredient; i++) {
+      trace_sample(raw);
+      delay(13);
+    }
+    HOST_CHECK(fake_log.flash_writes == writes_before);  // nothing written while a pump runs
+    trace_event(Trace_Motor_Off, 0, ingredient);
+    trace_event(Trace_Pour_End, 30000, Completed);
+    trace_flush();
+  }
+  trace_order_end(Completed);
+}
+
+static std::string export_dump() {
+  std::string dump;
+  uint8_t chunk[TRACE_BLE_CHUNK];
+  trace_start_export();
+  while (trace_export_active()) {
+    size_t length = trace_next_chunk(chunk, sizeof(chunk));
+    dump.append((const char*)chunk, length);
+  }
+  return dump;
+}
+
+int main() {
+  host_fs_reset();
+  fakes_reset();
+  HOST_CHECK(trace_begin());
+
+  // 1500 samples per ingredient: about 19 s at 80 SPS, past the 992 a whole
+  // order could hold before.
+  const OrderPlan plans[] = {
+    { 81234, 123.456, 3, 1500 },
+    { 90500, 50.0, 1, 40 },  // re-tared in between
+  };
+  for (const OrderPlan& plan : plans) {
+    record_order(plan);
+  }
+  printf("  %d flash writes for %d ingredients\n", fake_log.flash_writes, plans[0].ingredients + plans[1].ingredients);
+
+  std::string dump_path = std::string(host_fs_root()) + "/dump.bin";
+  std::string csv_path = std::string(host_fs_root()) + "/dump.csv";
+  std::ofstream(dump_path, std::ios::binary) << export_dump();
+  std::string command = std::string(DECODER) + " '" + dump_path + "' '" + csv_path + "'";
+  HOST_CHECK(system(command.c_str()) == 0);
+
+  // order -> samples and worst decoding error
+  std::map<int, int> samples;
+  std::map<int, double> max_error;
+  std::ifstream csv(csv_path);
+  std::string line;
+  std::getline(csv, line);  // column names
+  while (std::getline(csv, line)) {
+    std::istringstream fields(line);
+    std::string order, time_ms, order_time_ms, event, raw, grams;
+    std::getline(fields, order, ',');
+    std::getline(fields, time_ms, ',');
+    std::getline(fields, order_time_ms, ',');
+    std::getline(fields, event, ',');
+    std::getline(fields, raw, ',');
+    std::getline(fields, grams, ',');
+    if (event != "sample") continue;
+    int index = atoi(order.c_str()) - 1;
+    samples[index]++;
+    max_error[index] = max(max_error[index], fabs(atof(grams.c_str()) - plans[index].grams));
+  }
+  for (int i = 0; i < 2; i++) {
+    int expected = plans[i].ingredients * plans[i].samples_per_ingredient;
+    printf("  order %d: %d of %d samples, max decoding error %.4f g\n", i + 1, samples[i], expected, max_error[i]);
+    HOST_CHECK(samples[i] == expected);
+    HOST_CHECK(max_error[i] < 0.002);
+  }
+  return host_report("trace_recorder_test");
+}
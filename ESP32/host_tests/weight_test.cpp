@@ -0,0 +1,103 @@
+// Fixed-point weight path (weight.cpp) against exact and float conversion,
+// with the cost of both per sample.
+#include "host.h"
+#include "weight.h"
+
+static const int32_t OFFSET = 81234;
+static const int32_t RAW_RANGE = 600000;  // about +-850 g at the default gain
+static const int32_t RAW_STEP = 997;
+
+static double exact_mg(int32_t raw, int32_t counts_per_kg) {
+  return (double)(raw - OFFSET) * 1e6 / counts_per_kg;
+}
+
+// The conversion the firmware used before: float grams from the library's scale.
+static float float_grams(int32_t raw, float factor) {
+  return (raw - OFFSET) / factor;
+}
+
+static void check_gain(int32_t counts_per_kg) {
+  weight_set_calibration(OFFSET, counts_per_kg);
+  float factor = counts_per_kg / 1000.0f;
+  double max_exact_error = 0;
+  double max_float_error = 0;
+  for (int32_t delta = -RAW_RANGE; delta <= RAW_RANGE; delta += RAW_STEP) {
+    int32_t raw = OFFSET + delta;
+    weight_mg_t mg = weight_raw_to_mg(raw);
+    max_exact_error = std::max(max_exact_error, fabs(mg - exact_mg(raw, counts_per_kg)));
+    max_float_error = std::max(max_float_error, fabs(float_grams(raw, factor) * 1000.0 - mg));
+  }
+  // Across the whole 24-bit range only rounding to whole mg may remain.
+  double max_full_range_error = 0;
+  for (int32_t raw = -(1 << 23); raw < (1 << 23); raw += 65521) {
+    max_full_range_error = std::max(max_full_range_error, fabs(weight_raw_to_mg(raw) - exact_mg(raw, counts_per_kg)));
+  }
+  printf("  %8ld counts/kg: max |fixed - exact| %.4f mg (full range %.4f mg), max |float - fixed| %.4f mg\n",
+         (long)counts_per_kg, max_exact_error, max_full_range_error, max_float_error);
+  HOST_CHECK(max_exact_error <= 0.52);
+  HOST_CHECK(max_full_range_error <= 1.0);
+  HOST_CHECK(max_float_error <= 1.0);
+}
+
+static void report_cost() {
+  weight_set_calibration(OFFSET, 421337);
+  float factor = 421337 / 1000.0f;
+  volatile float float_sink = 0;
+  volatile weight_mg_t fixed_sink = 0;
+  const int rounds = 20;
+  int samples = 0;
+  uint64_t float_cycles = 0;
+  uint64_t fixed_cycles = 0;
+  for (int round = 0; round < rounds; round++) {
+    uint64_t start = host_cycles();
+    for (int32_t delta = -RAW_RANGE; delta <= RAW_RANGE; delta += RAW_STEP) {
+      float_sink = float_grams(OFFSET + delta, factor);
+    }
+    uint64_t mid = host_cycles();
+    for (int32_t delta = -RAW_RANGE; delta <= RAW_RANGE; delta += RAW_STEP) {
+      fixed_sink = weight_raw_to_mg(OFFSET + delta);
+    }
+    uint64_t end = host_cycles();
+    float_cycles += mid - start;
+    fixed_cycles += end - mid;
+    samples += 2 * RAW_RANGE / RAW_STEP + 1;
+  }
+  printf("  host cycles per sample: float %.1f, fixed %.1f (weight_self_check() reports ESP32 cycles)\n",
+         (double)float_cycles / samples, (double)fixed_cycles / samples);
+}
+
+static long sim_raw = OFFSET;
+static bool sim_source(uint64_t, long& raw) {
+  raw = sim_raw;
+  return true;
+}
+
+static void check_reads() {
+  host_hx711_attach(sim_source, 23);
+  weight_begin(4, 5, 23);
+  weight_set_calibration(OFFSET, DEFAULT_COUNTS_PER_KG);
+  sim_raw = OFFSET + DEFAULT_COUNTS_PER_KG / 1000 * 250;  // 250 g
+  HOST_CHECK(abs(weight_read_mg(4) - 250000) <= 1);
+
+  // Conversions taken while the rate pin settles are not used.
+  weight_set_sample_rate(Rate_80SPS);
+  unsigned long switched = millis();
+  weight_read_raw(1);
+  HOST_CHECK(millis() - switched >= WEIGHT_SETTLE_CONVERSIONS * 12);
+
+  weight_tare(4);
+  HOST_CHECK(weight_read_mg(1) == 0);
+  weight_adjust_zero(-2000);
+  HOST_CHECK(abs(weight_read_mg(1) - 2000) <= 1);
+}
+
+int main() {
+  printf("weight_raw_to_mg over +-%ld counts:\n", (long)RAW_RANGE);
+  const int32_t gains[] = { DEFAULT_COUNTS_PER_KG, 421337, 1000000, 2345678, 150001 };
+  for (int32_t gain : gains) {
+    check_gain(gain);
+  }
+  report_cost();
+  check_reads();
+  return host_report("weight_test");
+}
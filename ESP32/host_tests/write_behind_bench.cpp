@@ -0,0 +1,125 @@
+// Flash writes per drink and pour-loop stall for the ingredient stock
+// (filesystem.cpp with the host ArduinoJson), saved on every pour as before
+// and write-behind as now. Write counts are exact; flash time is a model
+// (host_flash_cost) with typical figures for the 4 MB SPI NOR flash of an
+// ESP32 module. The stall is what FlashWriteTimer counts while an order is
+// pending, every file included: write-behind leaves only the order history
+// switching to a new bucket.
+#include "host.h"
+#include "fakes.h"
+#include "filesystem.h"
+#include "recipe_store.h"
+#include <LittleFS.h>
+#include <random>
+
+static const int DRINKS = 60;
+static const double FLOW_ML_PER_S = 25;
+static const unsigned long LOOP_MS = 20;
+static const uint32_t SECTOR_ERASE_US = 45000;  // 4 KB sector erase, typical
+static const uint32_t PAGE_PROGRAM_US = 400;    // 256-byte page program, typical
+
+enum SaveMode { Save_Every_Pour, Save_Write_Behind };
+
+struct Session {
+  const char* name;
+  unsigned long gap_ms;  // idle between drinks
+};
+
+static const Session SESSIONS[] = {
+  { "a drink a minute", 60000 },
+  { "a queue, 1 s apart", 1000 },
+};
+
+struct Result {
+  double writes_per_drink;        // of /ingredients.json
+  double order_writes_per_drink;  // of those, while the order was pending
+  double stall_ms_per_drink;
+  uint32_t longest_stall_ms;
+  bool saved;  // stock on flash equals RAM after the last flush
+};
+
+// One pass of loop(): write-behind runs while the machine is idle.
+static void loop_for(unsigned long ms) {
+  for (unsigned long waited = 0; waited < ms; waited += LOOP_MS) {
+    persist_poll(!order_pending);
+    host_advance_ms(LOOP_MS);
+  }
+}
+
+static unsigned order_stock_writes;  // of /ingredients.json, while orders were pending
+
+// The pour loop of one drink. Before write-behind every poured ingredient
+// rewrote /ingredients.json on the spot, which flushing the dirty stock
+// reproduces exactly.
+static void pour(SaveMode mode, std::mt19937& random) {
+  unsigned stock_writes = host_fs_write_count("/ingredients.json");
+  order_pending = true;
+  persist_poll(false);
+  int used = 2 + random() % 3;
+  for (int n = 0; n < used; n++) {
+    int i = random() % INGREDIENT_COUNT;
+    int ml = 20 + random() % 41;
+    host_advance_ms((unsigned long)(ml / FLOW_ML_PER_S * 1000));
+    update_ingredient_amount(i, ml * UL_PER_ML);
+    if (mode == Save_Every_Pour) persist_flush();
+  }
+  order_pending = false;
+  order_stock_writes += host_fs_write_count("/ingredients.json") - stock_writes;
+}
+
+static Result run(SaveMode mode, const Session& session) {
+  host_fs_reset();
+  host_flash_cost = HostFlashCost();
+  setup_data();
+  for (int i = 0; i < INGREDIENT_COUNT; i++) {
+    snprintf(ingredients[i].name, sizeof(ingredients[i].name), "Bottle %d", i + 1);
+    ingredients[i].amount_left_ul = 100000 * UL_PER_ML;
+  }
+  persist_flush();
+  unsigned stock_writes = host_fs_write_count("/ingredients.json");
+  order_stock_writes = 0;
+  flash_write_stats = FlashWriteStats();
+  host_flash_cost.sector_erase_us = SECTOR_ERASE_US;
+  host_flash_cost.page_program_us = PAGE_PROGRAM_US;
+
+  std::mt19937 random(49);
+  for (int drink = 0; drink < DRINKS; drink++) {
+    pour(mode, random);
+    loop_for(session.gap_ms);
+  }
+  loop_for(INGREDIENT_FLUSH_MAX_DELAY_MS);
+
+  Result result;
+  const FlashWriteStats& written = flash_write_stats;
+  result.writes_per_drink = (double)(host_fs_write_count("/ingredients.json") - stock_writes) / DRINKS;
+  result.order_writes_per_drink = (double)order_stock_writes / DRINKS;
+  result.stall_ms_per_drink = (double)written.order_write_ms / DRINKS;
+  result.longest_stall_ms = written.max_order_write_ms;
+
+  Ingredient on_flash[INGREDIENT_COUNT];
+  result.saved = load_ingredients(on_flash);
+  for (int i = 0; i < INGREDIENT_COUNT; i++) {
+    result.saved = result.saved && on_flash[i].amount_left_ul == ingredients[i].amount_left_ul;
+  }
+  return result;
+}
+
+int main() {
+  printf("ingredient stock writes over %d drinks of 2 to 4 ingredients (flash model: %lu ms erase + %.1f ms per 256 B):\n",
+         DRINKS, (unsigned long)SECTOR_ERASE_US / 1000, PAGE_PROGRAM_US / 1000.0);
+  for (const Session& session : SESSIONS) {
+    Result before = run(Save_Every_Pour, session);
+    Result after = run(Save_Write_Behind, session);
+    printf("  %s:\n", session.name);
+    for (const Result* result : { &before, &after }) {
+      printf("    %-14s %.2f stock writes per drink, %.2f during the order; stall %.1f ms per drink, longest %lu ms\n",
+             result == &before ? "every pour" : "write-behind", result->writes_per_drink, result->order_writes_per_drink,
+             result->stall_ms_per_drink, (unsigned long)result->longest_stall_ms);
+      HOST_CHECK(result->saved);
+    }
+    HOST_CHECK(after.writes_per_drink < before.writes_per_drink);
+    HOST_CHECK(after.order_writes_per_drink < before.order_writes_per_drink);
+    if (session.gap_ms >= INGREDIENT_FLUSH_IDLE_MS) HOST_CHECK(after.order_writes_per_drink == 0);
+  }
+  return host_report("write_behind_bench");
+}
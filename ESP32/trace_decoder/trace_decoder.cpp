@@ -0,0 +1,147 @@
+// Host tool: turns a pour trace dump from the machine into CSV.
+//
+// Build: g++ -std=c++17 -O2 -o trace_decoder trace_decoder.cpp
+// Usage: trace_decoder <dump> [out.csv]
+//
+// <dump> is either the raw bytes received over BLE after "REQUEST Trace",
+// or a serial monitor log captured after typing "trace" (the "T:<hex>"
+// lines are picked out, everything else is ignored).
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../Cocktail_Machine/trace_format.h"
+
+static const char* event_name(uint8_t event) {
+  switch (event) {
+    case Trace_Sample: return "sample";
+    case Trace_Order_Start: return "order_start";
+    case Trace_Order_End: return "order_end";
+    case Trace_Pour_Start: return "pour_start";
+    case Trace_Pour_End: return "pour_end";
+    case Trace_Motor_On: return "motor_on";
+    case Trace_Motor_Off: return "motor_off";
+    case Trace_Stop_Decision: return "stop_decision";
+    case Trace_Abort: return "abort";
+    case Trace_Scale_Gain: return "scale_gain";
+    default: return "unknown";
+  }
+}
+
+static bool read_file(const char* path, std::vector<uint8_t>& bytes) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return true;
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Extracts the payload of "T:<hex>" lines from a serial log.
+static bool decode_serial_log(const std::vector<uint8_t>& text, std::vector<uint8_t>& bytes) {
+  std::istringstream lines(std::string(text.begin(), text.end()));
+  std::string line;
+  bool found = false;
+  while (std::getline(lines, line)) {
+    size_t start = line.find("T:");
+    if (start == std::string::npos) continue;
+    found = true;
+    for (size_t i = start + 2; i + 1 < line.size(); i += 2) {
+      int high = hex_value(line[i]);
+      int low = hex_value(line[i + 1]);
+      if (high < 0 || low < 0) break;
+      bytes.push_back((uint8_t)(high << 4 | low));
+    }
+  }
+  return found;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <dump> [out.csv]\n";
+    return 2;
+  }
+
+  std::vector<uint8_t> input;
+  if (!read_file(argv[1], input)) {
+    std::cerr << "cannot read " << argv[1] << "\n";
+    return 1;
+  }
+
+  std::vector<uint8_t> dump;
+  uint32_t magic = 0;
+  if (input.size() >= sizeof(magic)) memcpy(&magic, input.data(), sizeof(magic));
+  if (magic == TRACE_MAGIC) {
+    dump = input;
+  } else if (!decode_serial_log(input, dump)) {
+    std::cerr << "no trace found in " << argv[1] << "\n";
+    return 1;
+  }
+
+  TraceDumpHeader header;
+  if (dump.size() < sizeof(header)) {
+    std::cerr << "dump too short\n";
+    return 1;
+  }
+  memcpy(&header, dump.data(), sizeof(header));
+  // Version 1 dumps carry no per-order calibration; they decode with the
+  // export-time one, which is only right if the scale was not re-tared since.
+  bool known_version = header.version == TRACE_VERSION || header.version == 1;
+  if (header.magic != TRACE_MAGIC || !known_version || header.record_size != sizeof(TraceRecord)) {
+    std::cerr << "unsupported dump (version " << header.version << ", record size " << header.record_size << ")\n";
+    return 1;
+  }
+
+  size_t available = (dump.size() - sizeof(header)) / sizeof(TraceRecord);
+  if (available < header.record_count) {
+    std::cerr << "warning: dump truncated, " << available << " of " << header.record_count << " records\n";
+  }
+  size_t count = std::min<size_t>(available, header.record_count);
+
+  FILE* out = argc > 2 ? fopen(argv[2], "w") : stdout;
+  if (!out) {
+    std::cerr << "cannot write " << argv[2] << "\n";
+    return 1;
+  }
+
+  int32_t offset = header.offset;
+  double grams_per_count = header.counts_per_kg != 0 ? 1000.0 / header.counts_per_kg : 0;
+  fprintf(out, "order,time_ms,order_time_ms,event,raw,grams,motors,value\n");
+  int order = 0;
+  uint32_t order_start_ms = 0;
+  for (size_t i = 0; i < count; i++) {
+    TraceRecord record;
+    memcpy(&record, dump.data() + sizeof(header) + i * sizeof(TraceRecord), sizeof(record));
+    if (record.event == Trace_Order_Start) {
+      order = record.value;
+      order_start_ms = record.time_ms;
+      if (header.version >= 2) offset = record.raw;
+    }
+    if (record.event == Trace_Scale_Gain && record.raw != 0) {
+      grams_per_count = 1000.0 / record.raw;
+    }
+    // Samples carry raw HX711 counts; the weight events already carry mg.
+    double grams;
+    if (record.event == Trace_Sample) {
+      grams = (record.raw - offset) * grams_per_count;
+    } else if (record.event == Trace_Scale_Gain || (record.event == Trace_Order_Start && header.version >= 2)) {
+      grams = 0;
+    } else {
+      grams = record.raw / 1000.0;
+    }
+    fprintf(out, "%d,%u,%u,%s,%d,%.3f,0x%02x,%d\n", order, record.time_ms, record.time_ms - order_start_ms,
+            event_name(record.event), record.raw, grams, record.motors, record.value);
+  }
+
+  if (out != stdout) fclose(out);
+  return 0;
+}